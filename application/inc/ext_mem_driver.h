@@ -21,17 +21,335 @@ extern "C" {
 
 
 #define MEM_PAGE_SIZE         (0x1000)
+#define MEM_HALF_SECTOR_SIZE  (0x8000)
 #define MEM_SECTOR_SIZE      (0x10000)
 
+/** Typical erase times (ms) of an 8 Mbit serial NOR flash, used by the erase planner */
+#ifndef EXT_MEM_ERASE_4K_TIME_MS
+#define EXT_MEM_ERASE_4K_TIME_MS      45
+#endif
+
+#ifndef EXT_MEM_ERASE_32K_TIME_MS
+#define EXT_MEM_ERASE_32K_TIME_MS     120
+#endif
+
+#ifndef EXT_MEM_ERASE_64K_TIME_MS
+#define EXT_MEM_ERASE_64K_TIME_MS     150
+#endif
+
+#ifndef EXT_MEM_PAGE_PROGRAM_TIME_US
+#define EXT_MEM_PAGE_PROGRAM_TIME_US  700
+#endif
+
+#ifndef EXT_MEM_ERASE_CHIP_TIME_MS
+#define EXT_MEM_ERASE_CHIP_TIME_MS    2000
+#endif
+
+/** Time between two status reads while an erase is in progress */
+#ifndef EXT_MEM_ERASE_POLL_PERIOD_US
+#define EXT_MEM_ERASE_POLL_PERIOD_US  1000
+#endif
+
+/** Status reads during a page program, the period is the program time divided by it */
+#ifndef EXT_MEM_PROGRAM_NBR_POLLS
+#define EXT_MEM_PROGRAM_NBR_POLLS     4
+#endif
+
+/** Longest wait for a program or an erase to complete */
+#ifndef EXT_MEM_BUSY_TIMEOUT_MS
+#define EXT_MEM_BUSY_TIMEOUT_MS       200000
+#endif
+
+/** Memory covered by the erased page maps, pages beyond it are always erased */
+#ifndef EXT_MEM_PAGE_MAP_SIZE
+#define EXT_MEM_PAGE_MAP_SIZE         (0x1000000)
+#endif
+
+/** Number of memory chips on the SPI bus, each with its own chip select pin */
+#ifndef EXT_MEM_NBR_DEVICES
+#define EXT_MEM_NBR_DEVICES           1
+#endif
+
+/** Chip select pins of the memory chips, at least EXT_MEM_NBR_DEVICES of them */
+#ifndef EXT_MEM_CS_PINS
+#define EXT_MEM_CS_PINS               { SPI_nCS_PIN, SPI_nCS1_PIN }
+#endif
+
+/** Deep power down entry time tDP, CS# high after the command to the low power state */
+#ifndef EXT_MEM_TDP_US
+#define EXT_MEM_TDP_US                10
+#endif
+
+/** Deep power down release time tRES1, CS# toggle to the standby state */
+#ifndef EXT_MEM_TRES1_US
+#define EXT_MEM_TRES1_US              35
+#endif
+
+/** Reset recovery time tRST of an idle memory, a reset during a program or an erase
+ *  takes longer and is covered by the busy bit poll */
+#ifndef EXT_MEM_TRST_US
+#define EXT_MEM_TRST_US               40
+#endif
+
+/** Longest reset recovery, a reset during an erase */
+#ifndef EXT_MEM_RESET_TIMEOUT_MS
+#define EXT_MEM_RESET_TIMEOUT_MS      20
+#endif
+
+/** Idle time before a device is put in deep power down, 0 keeps the devices awake */
+#ifndef EXT_MEM_IDLE_TIMEOUT_MS
+#define EXT_MEM_IDLE_TIMEOUT_MS       100
+#endif
+
+/** Read back each program and compare it with the data */
+#ifndef EXT_MEM_WRITE_VERIFY
+#define EXT_MEM_WRITE_VERIFY          0
+#endif
+
+/** The data read back after a program differs, or a bit would have to be set back to 1 */
+#define EXT_MEM_ERROR_PROGRAM_FAILED  (NRF_ERROR_PERIPH_DRIVERS_ERR_BASE + 0x0080)
+
+/** Largest memory size with 3 byte addressing, larger memories use 4 byte addresses */
+#define EXT_MEM_MAX_3_BYTE_SIZE       (0x1000000)
+
 /** Take the last sector () for Garbage collection **/
 #define GC_ADDRESS (MEMORY_SIZE - MEM_SECTOR_SIZE)
 
+/** Memory parameters detected from the JEDEC ID and the SFDP tables */
+typedef struct
+{
+    /** Manufacturer ID, memory type and capacity */
+    uint8_t jedec_id[3];
+    /** True when the parameters were read from the SFDP tables */
+    bool sfdp_valid;
+    /** Memory size in bytes */
+    uint32_t size;
+    /** Program page size in bytes */
+    uint32_t page_size;
+    /** Erase commands, zero when the memory does not have the erase size */
+    uint8_t erase_4k_cmd;
+    uint8_t erase_32k_cmd;
+    uint8_t erase_64k_cmd;
+    /** Commands used for reads and page programs */
+    uint8_t read_cmd;
+    uint8_t program_cmd;
+    /** Number of address bytes in the commands (3 or 4) */
+    uint8_t address_len;
+    /** Typical page program time in us */
+    uint32_t program_time_us;
+    /** Fast read modes of the memory (SFDP_FAST_READ_xxx), the SPI bus uses single line reads */
+    uint8_t fast_read_modes;
+} ext_mem_info_t;
+
+/** Erase time estimates of each erase command */
+typedef struct
+{
+    uint32_t erase_4k_ms;
+    uint32_t erase_32k_ms;
+    uint32_t erase_64k_ms;
+    uint32_t erase_chip_ms;
+} ext_mem_erase_timing_t;
+
+/** Erase commands planned for a range and the predicted erase time */
+typedef struct
+{
+    uint32_t nbr_4k;
+    uint32_t nbr_32k;
+    uint32_t nbr_64k;
+    uint32_t nbr_chip;
+    uint32_t time_ms;
+} ext_mem_erase_plan_t;
+
+/** Counters of the erase requests, the erases done and the erases avoided */
+typedef struct
+{
+    /** Pages (4K) requested to be erased */
+    uint32_t pages_requested;
+    /** Pages erased, the difference to pages_requested is the erases avoided */
+    uint32_t pages_erased;
+    /** Pages blank checked to find their state */
+    uint32_t blank_checks;
+    /** Predicted erase time without skipping erased pages */
+    uint32_t planned_time_ms;
+    /** Predicted erase time of the erases done */
+    uint32_t time_ms;
+    /** Time spent waiting for programs and erases to complete, the CPU sleeps meanwhile */
+    uint32_t busy_wait_ms;
+    /** Status register reads done while waiting */
+    uint32_t status_polls;
+} ext_mem_erase_stats_t;
+
+/** Latency of an operation, from its command to its completion seen by the status poll */
+typedef struct
+{
+    uint32_t count;
+    uint32_t total_us;
+    uint32_t max_us;
+} ext_mem_latency_t;
+
+/** Program and erase latencies */
+typedef struct
+{
+    ext_mem_latency_t program;
+    ext_mem_latency_t erase;
+} ext_mem_latency_stats_t;
+
+/** Counters of the programmed bytes, the 0xFF bytes are not programmed */
+typedef struct
+{
+    /** Bytes given to the write functions */
+    uint32_t bytes_requested;
+    /** Bytes sent with a program command */
+    uint32_t bytes_programmed;
+    /** Programs not sent, the data was 0xFF or already in the memory */
+    uint32_t programs_skipped;
+    /** Programs whose data read back differs */
+    uint32_t verify_failures;
+} ext_mem_write_stats_t;
+
+/** Boot timing of the memories from the start of ext_mem_init, in us */
+typedef struct
+{
+    /** Deep power down release, reset and JEDEC ID check of the devices */
+    uint32_t wake_us;
+    /** SFDP detection of the devices */
+    uint32_t detect_us;
+    /** First read of the memory */
+    uint32_t first_read_us;
+} ext_mem_boot_time_t;
+
+/** Deep power down counters of the idle manager, summed over the devices */
+typedef struct
+{
+    /** Deep power down entries and wakes */
+    uint32_t sleeps;
+    uint32_t wakes;
+    /** Time from the wake to the memory ready for the access */
+    uint32_t wake_total_us;
+    uint32_t wake_max_us;
+    /** Time spent in deep power down and awake */
+    uint32_t sleep_ms;
+    uint32_t awake_ms;
+} ext_mem_power_stats_t;
+
 /**@brief Initialize External Memory
  *
  */
 void ext_mem_init(void);
 
+/**@brief Get the boot timing of the last ext_mem_init
+ *
+ * @return Time of each boot step
+ */
+const ext_mem_boot_time_t *ext_mem_get_boot_time(void);
+
+/**@brief Put the selected device in deep power down
+ *
+ * A program or erase in progress is waited for before the command.
+ *
+ * @return ret_code_t
+ */
+ret_code_t ext_mem_sleep(void);
+
+/**@brief Release the selected device from deep power down
+ *
+ * The fast wake waits tRES1 and checks the JEDEC ID, the memory keeps its state in
+ * deep power down. The full wake, or a fast wake with a wrong JEDEC ID, also resets
+ * the memory and switches it back to the 4 byte address mode it was in. The
+ * parameters and erase times detected at init are kept.
+ *
+ * @param[in]  fast True for the fast wake used by duty cycled operation
+ *
+ * @return NRF_ERROR_NOT_FOUND when the JEDEC ID is still wrong after the reset
+ */
+ret_code_t ext_mem_wake(bool fast);
+
+/**@brief Put the devices idle for the idle timeout in deep power down
+ *
+ * Called from the main loop. A device in deep power down is woken up by its next
+ * access with the fast wake.
+ */
+void ext_mem_idle_process(void);
+
+/**@brief Set the idle time before the deep power down
+ *
+ * @param[in]  timeout_ms Idle time in ms, 0 keeps the devices awake
+ */
+void ext_mem_set_idle_timeout(uint32_t timeout_ms);
+
+/**@brief Get the idle time before the deep power down
+ *
+ * @return Idle time in ms
+ */
+uint32_t ext_mem_get_idle_timeout(void);
+
+/**@brief Read the deep power down counters
+ *
+ * @param[out] stats Counters since the last clear, including the current state
+ */
+void ext_mem_get_power_stats(ext_mem_power_stats_t *stats);
+
+/**@brief Clear the deep power down counters
+ */
+void ext_mem_clear_power_stats(void);
+
+/**@brief Select the memory chip used by the memory functions
+ *
+ * The first device is selected by default.
+ *
+ * @param[in]  device Index of the device (less than EXT_MEM_NBR_DEVICES)
+ *
+ * @return ret_code_t
+ */
+ret_code_t ext_mem_select_device(uint8_t device);
+
+/**@brief Get the index of the selected memory chip
+ */
+uint8_t ext_mem_selected_device(void);
+
+/**@brief Wait for the program or erase in progress on the selected device
+ *
+ * Writes and erases return after the last command is sent. The completion is
+ * waited for before the next command to the same device, or with this function.
+ *
+ * @return ret_code_t
+ */
+ret_code_t ext_mem_wait_ready(void);
+
+/**@brief Get the memory parameters of the selected device detected at init
+ *
+ * @return Memory parameters, the 1 Mbyte defaults when detection failed
+ */
+const ext_mem_info_t *ext_mem_get_info(void);
+
+/**@brief Set the erase time estimates used by the erase planner
+ *
+ * @param[in]  timing Erase time of each erase command in ms
+ */
+void memory_set_erase_timing(const ext_mem_erase_timing_t *timing);
+
+/**@brief Get the erase time estimates of the selected device
+ *
+ * @param[out] timing Erase time of each erase command in ms
+ */
+void memory_get_erase_timing(ext_mem_erase_timing_t *timing);
+
+/**@brief Plan the erase of a range without erasing it (dry run)
+ *
+ * Picks the mix of 4K, 32K, 64K and chip erases with the minimal predicted time.
+ *
+ * @param[in]  address Start address, aligned with 4096 (or 4K)
+ * @param[in]  size Number of bytes to erase. It should be multiple of 4096 (or 4K).
+ * @param[out] plan Number of erase commands of each type and the predicted time
+ *
+ * @return ret_code_t
+ */
+ret_code_t memory_erase_plan(uint32_t address, uint32_t size, ext_mem_erase_plan_t *plan);
+
 /**@brief Erase
+ *
+ * Pages known to be erased (tracked in RAM by the write and erase calls, or
+ * found blank) are skipped when that makes the erase faster.
  *
  * @param[in]  uint32_t Address belongs to the page to be deleted
  * @param[in]  size Number of bytes to delete. It should be multiple of 4096 (or 4K).
@@ -39,6 +357,48 @@ void ext_mem_init(void);
 
 ret_code_t memory_erase (uint32_t address, uint32_t size);
 
+/**@brief Read the erase counters
+ *
+ * @param[out] stats Erase counters since the last clear
+ */
+void memory_get_erase_stats(ext_mem_erase_stats_t *stats);
+
+/**@brief Clear the erase counters
+ */
+void memory_clear_erase_stats(void);
+
+/**@brief Read the program and erase latencies
+ *
+ * @param[out] stats Latencies since the last clear
+ */
+void memory_get_latency_stats(ext_mem_latency_stats_t *stats);
+
+/**@brief Clear the program and erase latencies
+ */
+void memory_clear_latency_stats(void);
+
+/**@brief Read the write counters
+ *
+ * @param[out] stats Write counters since the last clear
+ */
+void memory_get_write_stats(ext_mem_write_stats_t *stats);
+
+/**@brief Clear the write counters
+ */
+void memory_clear_write_stats(void);
+
+/**@brief Enable the read back of the programmed data
+ *
+ * @param[in]  enable True to compare each program with the data read back
+ */
+void memory_set_write_verify(bool enable);
+
+/**@brief Check if the programmed data is read back
+ *
+ * @return true when the programs are verified
+ */
+bool memory_get_write_verify(void);
+
 /**@brief Erase page
  *
  * @param[in]  uint32_t Address belongs to the page to be deleted
@@ -65,6 +425,19 @@ void memory_erase_chip(void);
  */
 ret_code_t memory_write(uint32_t address, uint8_t *data, uint32_t len);
 
+/**@brief Write data that may already be in the memory
+ *
+ * The memory is read first and only the bytes that differ are programmed, nothing
+ * is programmed when the data is already there.
+ *
+ * @param[in]  address Address of the data
+ * @param[in]  data Data to write
+ * @param[in]  len Length of the data
+ *
+ * @return EXT_MEM_ERROR_PROGRAM_FAILED when a bit is 0 in the memory and 1 in the data
+ */
+ret_code_t memory_write_if_changed(uint32_t address, uint8_t *data, uint32_t len);
+
 /**@brief Read data from the external memory
  *
  * @param[in]  uint8_t* Data buffer to read
@@ -75,6 +448,18 @@ ret_code_t memory_write(uint32_t address, uint8_t *data, uint32_t len);
  */
 ret_code_t memory_read(uint32_t address, uint8_t *data, uint32_t len);
 
+/**@brief Check if a region is erased (all bytes 0xFF)
+ *
+ * The region is streamed with one read command into a ring of DMA buffers and
+ * checked a word at a time. It returns on the first programmed word.
+ *
+ * @param[in]  uint32_t Address of the region
+ * @param[in]  uint32_t Length of the region
+ *
+ * @return true when the whole region is erased, false otherwise or on error
+ */
+bool memory_is_blank(uint32_t address, uint32_t len);
+
 /**@brief Perform external memory test for read and write
  */
 void ext_mem_test(void);
@@ -0,0 +1,77 @@
+#ifndef FLASH_BACKEND_H
+#define FLASH_BACKEND_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "simple_fs.h"
+
+/** Capabilities of a flash backend */
+typedef struct
+{
+    /** Memory size in bytes */
+    uint32_t size;
+    /** Program page size, a write is split at the page boundaries */
+    uint32_t page_size;
+    /** Smallest erase size, erases are aligned with it */
+    uint32_t erase_size;
+    /** Supported erase sizes ORed together, the sizes are powers of two */
+    uint32_t erase_sizes;
+    /** Typical time of the smallest erase in ms */
+    uint32_t erase_time_ms;
+    /** Typical time to program a page in us */
+    uint32_t program_time_us;
+    /** Writes of a 32 bit word allowed between two erases, 0 when they are not limited.
+     *  simple_fs then writes a word per status, large_file_storage needs an unlimited backend.
+     */
+    uint32_t word_writes;
+} flash_backend_caps_t;
+
+/** Operations of a flash backend. Programming can only clear bits (1 to 0),
+ *  an erase sets the bits of the erased range.
+ */
+typedef struct
+{
+    const char *name;
+    /** Initialize the backend */
+    uint32_t (*init)(void);
+    /** Get the capabilities, valid after init */
+    void (*get_caps)(flash_backend_caps_t *caps);
+    mem_write_t write;
+    /** Write of data that may already be in the memory, NULL when the backend has none */
+    mem_write_t update;
+    mem_read_t read;
+    mem_erase_t erase;
+    /** Get a pointer to the memory mapped data, NULL when the memory is not mapped.
+     *  The data is valid till the next write or erase of the backend.
+     */
+    mem_map_t map;
+} flash_backend_t;
+
+/** SPI NOR chips through the memory array */
+extern const flash_backend_t flash_backend_nor;
+/** RAM simulator of a NOR flash, built by the host tests only */
+extern const flash_backend_t flash_backend_ram;
+/** nRF internal flash through the NVMC, its words can be written twice between erases */
+extern const flash_backend_t flash_backend_nvmc;
+/** QSPI NOR memory read through the XIP region */
+extern const flash_backend_t flash_backend_qspi;
+#if defined(__unix) || defined(__linux__)
+/** Flash image in a file of the host */
+extern const flash_backend_t flash_backend_file;
+#endif
+
+/**@brief Invalidate the cache of the memory mapped regions, called by the
+ *        backends after a program or an erase of a mapped memory
+ */
+void flash_backend_invalidate_cache(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLASH_BACKEND_H
@@ -2,16 +2,20 @@
 #ifndef LARGE_FILE_STORAGE_H_
 #define LARGE_FILE_STORAGE_H_
 
+#include "flash_backend.h"
+
 /** Start address of the meta data. Do not start at 0x0 location */
 #define META_DATA_START_ADDRESS         0x7F000
 
 #define META_DATA_END_ADDRESS           0x80000
 /** Start address of the storage. Do not start at 0x0 location */
 #define DATA_START_ADDRESS                   0x80000
-/** End address of the storage */
-#define DATA_END_ADDRESS                     0x100000
+/** The storage ends at the end of the memory of the backend */
 /** Allocated size for one file in multiples of 4K */
 #define FILE_ALLOC_SIZE                 (73728) // 4096 * 18
+/** Smallest memory holding the layout. The allocation ending at the end of the memory is
+ *  not used and the one after the written file is erased ahead, two files must remain. */
+#define LARGE_FILE_STORAGE_MIN_SIZE     (DATA_START_ADDRESS + 3 * FILE_ALLOC_SIZE)
 
 /** A space to store a new file */
 #define SPACE_FOR_NEW_FILE      (0xFF)
@@ -40,6 +44,11 @@ typedef struct __attribute__((packed))
     uint32_t file_len;
 } file_header_t;
 
+/**@brief Set the memory the files are stored in, call after the backend init
+ *
+ * @return MEAS_STORE_STATUS_INTERNAL_ERROR when the memory is smaller than LARGE_FILE_STORAGE_MIN_SIZE
+ */
+meas_store_status_t large_file_storage_init(const flash_backend_t *backend);
 meas_store_status_t write_measurement_in_parts(uint32_t rem_len, uint8_t *data, uint32_t data_len);
 meas_store_status_t read_measurement_in_parts(uint32_t file_address, uint32_t rem_len, uint8_t *data, uint32_t data_len);
 uint32_t first_written_file_address(void);
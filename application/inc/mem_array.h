@@ -0,0 +1,91 @@
+#ifndef MEM_ARRAY_H
+#define MEM_ARRAY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "app_error.h"
+#include "ext_mem_driver.h"
+
+/** Layout of the memory chips in the array address space */
+typedef enum
+{
+    /** The chips follow each other */
+    MEM_ARRAY_CONCAT = 0,
+    /** Consecutive stripes are in consecutive chips */
+    MEM_ARRAY_STRIPE
+} mem_array_mode_t;
+
+/** Layout used by the storage manager */
+#ifndef MEM_ARRAY_MODE
+#define MEM_ARRAY_MODE              MEM_ARRAY_CONCAT
+#endif
+
+/** Stripe length, a multiple of 4096 (MEM_PAGE_SIZE or MEM_SECTOR_SIZE) */
+#ifndef MEM_ARRAY_STRIPE_LEN
+#define MEM_ARRAY_STRIPE_LEN        MEM_SECTOR_SIZE
+#endif
+
+/**@brief Initialize the array of the memory chips detected by ext_mem_init
+ *
+ * @param[in]  mode Concatenate or stripe the chips
+ * @param[in]  stripe_len Stripe length, a multiple of 4096 (or 4K). Not used when concatenated.
+ *
+ * @return ret_code_t
+ */
+ret_code_t mem_array_init(mem_array_mode_t mode, uint32_t stripe_len);
+
+/**@brief Size of the array address space
+ */
+uint32_t mem_array_size(void);
+
+/**@brief Write data to the array
+ *
+ * A write that spans chips programs a page in each chip in turn, so a chip
+ * is sent data while the others are programming.
+ *
+ * @param[in]  uint32_t Address of the data
+ * @param[in]  uint8_t* Data buffer to write
+ * @param[in]  uint32_t Length of the data to write
+ *
+ * @return ret_code_t
+ */
+uint32_t mem_array_write(uint32_t address, uint8_t *data, uint32_t len);
+
+/**@brief Write data that may already be in the array, see memory_write_if_changed
+ *
+ * @param[in]  uint32_t Address of the data
+ * @param[in]  uint8_t* Data buffer to write
+ * @param[in]  uint32_t Length of the data to write
+ *
+ * @return ret_code_t
+ */
+uint32_t mem_array_write_if_changed(uint32_t address, uint8_t *data, uint32_t len);
+
+/**@brief Read data from the array
+ *
+ * @param[in]  uint32_t Address of the data
+ * @param[in]  uint8_t* Data buffer to read
+ * @param[in]  uint32_t Length of the data to read
+ *
+ * @return ret_code_t
+ */
+uint32_t mem_array_read(uint32_t address, uint8_t *data, uint32_t len);
+
+/**@brief Erase a range of the array
+ *
+ * @param[in]  uint32_t Start address, aligned with 4096 (or 4K)
+ * @param[in]  size Number of bytes to erase. It should be multiple of 4096 (or 4K).
+ *
+ * @return ret_code_t
+ */
+uint32_t mem_array_erase(uint32_t address, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MEM_ARRAY_H
@@ -0,0 +1,94 @@
+#ifndef SFDP_H
+#define SFDP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** Number of erase types in the basic flash parameter table */
+#define SFDP_NBR_ERASE_TYPES    4
+
+/** Fast read modes (command-address-data lines) */
+#define SFDP_FAST_READ_112      (1 << 0)
+#define SFDP_FAST_READ_122      (1 << 1)
+#define SFDP_FAST_READ_114      (1 << 2)
+#define SFDP_FAST_READ_144      (1 << 3)
+
+/** Methods to enter the 4 byte address mode (basic table DWORD 16) */
+#define SFDP_ENTER_4B_B7            (1 << 0)
+#define SFDP_ENTER_4B_WREN_B7       (1 << 1)
+
+/*** SFDP parser Status ***/
+typedef enum
+{
+    SFDP_STATUS_SUCCESS = 0,
+    SFDP_STATUS_READ_ERROR,
+    SFDP_STATUS_NO_SIGNATURE,
+    SFDP_STATUS_NO_BASIC_TABLE,
+    SFDP_STATUS_INVALID_TABLE
+} sfdp_status_t;
+
+/** Address modes supported by the memory */
+typedef enum
+{
+    SFDP_ADDRESS_3_BYTE = 0,
+    SFDP_ADDRESS_3_OR_4_BYTE = 1,
+    SFDP_ADDRESS_4_BYTE = 2
+} sfdp_address_mode_t;
+
+typedef struct
+{
+    /** Erase size in bytes, zero when the erase type does not exist */
+    uint32_t size;
+    uint8_t opcode;
+    /** Erase opcode with a 4 byte address, zero when it does not exist */
+    uint8_t opcode_4b;
+    /** Typical erase time in ms, zero when it is not given */
+    uint32_t typ_time_ms;
+} sfdp_erase_type_t;
+
+typedef struct
+{
+    uint8_t major_rev;
+    uint8_t minor_rev;
+    /** Memory size in bytes */
+    uint32_t density;
+    /** Program page size in bytes */
+    uint32_t page_size;
+    sfdp_address_mode_t address_mode;
+    /** Supported fast read modes (SFDP_FAST_READ_xxx) */
+    uint8_t fast_read_modes;
+    sfdp_erase_type_t erase_type[SFDP_NBR_ERASE_TYPES];
+    /** Typical page program time in us, zero when it is not given */
+    uint32_t page_program_typ_us;
+    /** Typical chip erase time in ms, zero when it is not given */
+    uint32_t chip_erase_typ_ms;
+    /** Methods to enter the 4 byte address mode (SFDP_ENTER_4B_xxx) */
+    uint8_t enter_4b_methods;
+    /** Read (0x13) and page program (0x12) with a 4 byte address are supported */
+    bool read_4b;
+    bool program_4b;
+} sfdp_info_t;
+
+/** Function to read the SFDP space, returns zero on success */
+typedef uint32_t (*sfdp_read_t)(uint32_t, uint8_t*, uint32_t);
+
+/**@brief Parse the SFDP header and the basic flash parameter table
+ *
+ * Does not depend on the memory driver so it can be run on captured SFDP dumps.
+ *
+ * @param[in]  sfdp_read Function to read the SFDP space
+ * @param[out] info Memory parameters found in the tables
+ *
+ * @return sfdp_status_t
+ */
+sfdp_status_t sfdp_parse(sfdp_read_t sfdp_read, sfdp_info_t *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SFDP_H
@@ -28,6 +28,16 @@
 /** Set the length for data buffer for internal transfer */
 #define DATA_TRANSFER_SIZE 4096
 
+/** Return code of mem_write when the data read back differs from the data written */
+#ifndef SFS_MEM_PROGRAM_FAILED
+#define SFS_MEM_PROGRAM_FAILED (0x8280)
+#endif
+
+/** Number of times a file is written again further in the folder after a failed program */
+#ifndef SFS_WRITE_RETRIES
+#define SFS_WRITE_RETRIES 2
+#endif
+
 /*** Simple File System Status ***/
 typedef enum
 {
@@ -44,7 +54,9 @@ typedef enum
     SFS_STATUS_GARBAGE_ERROR,
     SFS_STATUS_ADDRESS_ALIGNMENT_ERROR,
     SFS_STATUS_INTERNAL_ERROR,
-    SFS_STATUS_MEM_CPY_ERROR
+    SFS_STATUS_MEM_CPY_ERROR,
+    SFS_STATUS_NOT_MAPPED,
+    SFS_STATUS_PROGRAM_ERROR
 } sfs_status_t;
 
 typedef struct __attribute__((packed))
@@ -61,6 +73,30 @@ typedef struct
     uint32_t address;
 } sfs_file_info_t;
 
+typedef uint32_t (*mem_write_t)(uint32_t, uint8_t*, uint32_t);
+typedef uint32_t (*mem_read_t)(uint32_t, uint8_t*, uint32_t);
+typedef uint32_t (*mem_erase_t)(uint32_t, uint32_t);
+/** Get a pointer to the memory mapped data of an address */
+typedef uint32_t (*mem_map_t)(uint32_t, const uint8_t**);
+
+/** A memory holding folders */
+typedef struct
+{
+    mem_write_t mem_write;
+    /** Write of the page states and file status that skips the bytes already set, NULL to use mem_write */
+    mem_write_t mem_update;
+    mem_read_t mem_read;
+    mem_erase_t mem_erase;
+    /** NULL when the memory is not memory mapped */
+    mem_map_t mem_map;
+    uint32_t mem_len;
+    /** Writes of a 32 bit word allowed between two erases, 0 when they are not limited.
+     *  The folders of a limited memory write each page state and file status transition
+     *  in its own word, and align their files on words.
+     */
+    uint32_t word_writes;
+} sfs_mem_t;
+
 typedef struct
 {
     /** The start address must be 4096 aligned */
@@ -74,22 +110,31 @@ typedef struct
      *          Less than or equal to folder_len
      */
     uint32_t page_len;
+    /** Memory of the folder, NULL for the memory of sfs_parameters_t.
+     *  The garbage collection is always in the memory of sfs_parameters_t.
+     */
+    const sfs_mem_t *mem;
 } sfs_folder_info_t;
 
-typedef uint32_t (*mem_write_t)(uint32_t, uint8_t*, uint32_t);
-typedef uint32_t (*mem_read_t)(uint32_t, uint8_t*, uint32_t);
-typedef uint32_t (*mem_erase_t)(uint32_t, uint32_t);
-
 typedef struct
 {
     mem_write_t mem_write;
+    /** Write of the page states and file status that skips the bytes already set, NULL to use mem_write */
+    mem_write_t mem_update;
     mem_read_t mem_read;
     mem_erase_t mem_erase;
+    /** NULL when the memory is not memory mapped */
+    mem_map_t mem_map;
     uint32_t mem_len;
+    /** Writes of a 32 bit word allowed between two erases, as in sfs_mem_t */
+    uint32_t word_writes;
     uint32_t gc_len;
     uint32_t gc_address;
     uint8_t nbr_folders;
     sfs_folder_info_t *sfs_folder_info;
+    /** Buffer used by sfs_map_file when the folder is not memory mapped, can be NULL */
+    uint8_t *map_buffer;
+    uint32_t map_buffer_len;
 } sfs_parameters_t;
 
 sfs_status_t sfs_write_file(uint32_t file_id, uint8_t *data, uint32_t data_len);
@@ -97,11 +142,29 @@ sfs_status_t sfs_read_file(uint32_t file_id, uint8_t *data, uint32_t data_len);
 sfs_status_t sfs_write_file_in_parts(uint32_t file_id, uint32_t rem_len, uint8_t *data, uint32_t data_len);
 sfs_status_t sfs_read_file_in_parts(uint32_t file_id, uint32_t rem_len, uint8_t *data, uint32_t data_len);
 sfs_status_t sfs_read_file_info(sfs_file_info_t *file_info);
+/**@brief Get a pointer to the data of a file, without copying it when the memory
+ *        of the folder is memory mapped. Otherwise the file is copied to the map
+ *        buffer of sfs_parameters_t, valid till the next call.
+ *
+ * @return SFS_STATUS_NOT_MAPPED when the memory is not mapped and the file does
+ *         not fit in the map buffer
+ */
+sfs_status_t sfs_map_file(uint32_t file_id, const uint8_t **data, uint32_t *data_len);
 sfs_status_t sfs_read_file_data(sfs_file_info_t *file_info, uint8_t *data, uint32_t data_len);
+/**@brief Read a part of a file found by sfs_read_file_info, without searching it again
+ *
+ * @param[in]  file_info File found by sfs_read_file_info, it is not changed
+ * @param[in]  offset Offset in the file data
+ * @param[out] data Read data
+ * @param[in]  data_len Number of bytes
+ *
+ * @return SFS_STATUS_FILE_LEN_MISMATCH when the part is beyond the end of the file
+ */
+sfs_status_t sfs_read_file_range(const sfs_file_info_t *file_info, uint32_t offset, uint8_t *data, uint32_t data_len);
 sfs_status_t sfs_init(sfs_parameters_t *sfs_parameters);
 sfs_status_t sfs_uninit(void);
 
-/** Only for debugging */
-sfs_status_t sfs_last_written_info(uint32_t file_id, uint32_t *address, sfs_file_header_t *header);
+/** Only for debugging, end_address is the address after the file */
+sfs_status_t sfs_last_written_info(uint32_t file_id, uint32_t *address, uint32_t *end_address, sfs_file_header_t *header);
 
 #endif // SIMPLE_FS_H
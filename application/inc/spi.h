@@ -18,6 +18,126 @@
  */
 ret_code_t spi_txrx(const uint8_t *tx_buff, size_t tx_len, uint8_t *rx_buff, size_t rx_len);
 
+/**
+ * @brief Start a SPI data transfer without waiting for its completion
+ *
+ * The transmitted bytes are copied, at most SPI_TX_MAX_LEN. The receive buffer must
+ * stay valid until spi_txrx_wait returns.
+ *
+ * @param tx_buff[in] Buffer containing data to be transmitted
+ * @param tx_len[in] Number of bytes in tx_buff
+ * @param rx_buff[in] Buffer to receive data
+ * @param rx_len[in] Number of bytes to be received
+ *
+ * @return :: ret_code_t
+ */
+ret_code_t spi_txrx_start(const uint8_t *tx_buff, size_t tx_len, uint8_t *rx_buff, size_t rx_len);
+
+/**
+ * @brief Wait for the completion of a transfer started with spi_txrx_start
+ *
+ * @return :: ret_code_t
+ */
+ret_code_t spi_txrx_wait(void);
+
+/** Transfer phases, each with its own SPI frequency */
+typedef enum
+{
+    /** Commands, addresses and status reads */
+    SPI_PHASE_COMMAND = 0,
+    /** Bulk data of the reads and page programs */
+    SPI_PHASE_DATA,
+    SPI_NBR_PHASES
+} spi_phase_t;
+
+/** Counters of the SPI driver */
+typedef struct
+{
+    /** Transfers done, including the status reads started by the CPU */
+    uint32_t transfers;
+    /** Bytes transferred */
+    uint32_t bytes;
+    /** Transfers and polls given up */
+    uint32_t timeouts;
+    /** Status reads started by the timer while polling */
+    uint32_t polls;
+    /** Time spent polling a status */
+    uint32_t busy_wait_us;
+} spi_stats_t;
+
+/** Longest transmit of a transfer: command, address and a program page */
+#define SPI_TX_MAX_LEN          512
+
+/** Longest command of spi_poll_status, including the status bytes */
+#define SPI_POLL_MAX_CMD_LEN    4
+
+/**
+ * @brief Poll a status register until the bits of a mask are cleared
+ *
+ * A timer starts the status read through PPI a period after the end of the previous
+ * one and the chip select is driven by the SPIM, the CPU sleeps between the reads.
+ *
+ * @param cmd[in] Status read command, the status is the last byte received
+ * @param cmd_len[in] Number of bytes in cmd
+ * @param mask[in] Bits of the status to wait for
+ * @param period_us[in] Time from the end of a status read to the next one
+ * @param timeout_ms[in] Time to give up
+ * @param nbr_polls[out] Number of status reads done, can be NULL
+ *
+ * @return :: ret_code_t
+ */
+ret_code_t spi_poll_status(const uint8_t *cmd, size_t cmd_len, uint8_t mask, uint32_t period_us, uint32_t timeout_ms,
+                           uint32_t *nbr_polls);
+
+/**
+ * @brief Select the chip select pin driven by the SPIM for the next transfers
+ *
+ * @param cs_pin[in] Chip select pin of the slave
+ */
+void spi_select(uint32_t cs_pin);
+
+/**
+ * @brief Keep the chip select asserted over several transfers
+ *
+ * @param hold[in] True to assert the chip select, false to release it
+ */
+void spi_cs_hold(bool hold);
+
+/**
+ * @brief Set the SPI frequency of a transfer phase
+ *
+ * @param phase[in] Transfer phase
+ * @param freq_mhz[in] 1, 2, 4, 8, 16 or 32 MHz, above 8 MHz the outputs use high drive
+ *
+ * @return NRF_ERROR_INVALID_PARAM when the frequency is not supported
+ */
+ret_code_t spi_set_frequency(spi_phase_t phase, uint32_t freq_mhz);
+
+/**
+ * @brief Get the SPI frequency of a transfer phase in MHz
+ */
+uint32_t spi_get_frequency(spi_phase_t phase);
+
+/**
+ * @brief Select the phase, and so the frequency, of the next transfers
+ */
+void spi_set_phase(spi_phase_t phase);
+
+/**
+ * @brief Time of the free running SPI timer in us, it wraps after 71 minutes
+ */
+uint32_t spi_time_us(void);
+
+/**
+ * @brief Read the counters of the SPI driver
+ */
+void spi_get_stats(spi_stats_t *stats);
+
+/**
+ * @brief Clear the counters of the SPI driver
+ */
+void spi_clear_stats(void);
+
 /**
  * @brief Initialize SPI driver.
  *
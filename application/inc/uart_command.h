@@ -59,7 +59,13 @@ typedef enum
   /** UART DATA not as per protocol */
   UART_RESP_CMD_DATA_ERROR = 6,
   /** COMMAND NOT SUPPORTED */
-  UART_RESP_CMD_NOT_SUPPORTED = 7
+  UART_RESP_CMD_NOT_SUPPORTED = 7,
+  /** Command queue full, the request is sent again */
+  UART_RESP_BUSY = 8,
+  /** Data frame of a stream */
+  UART_RESP_STREAM_DATA = 9,
+  /** End frame of a stream, with the CRC of the data */
+  UART_RESP_STREAM_END = 10
 } uart_response_codes_t;
 
 
@@ -72,11 +78,22 @@ typedef struct
   uint16_t nbr_arg;
   uint32_t arg[MAX_NBR_ARGU];
   uint32_t paylen;
-  uint8_t payload[MAX_PAYLOAD_LEN];
+  /** View of the payload in the received frame, the response payload is written in place */
+  uint8_t *payload;
+  /** Space for the response payload */
+  uint32_t payload_size;
 } uart_cmd_t;
 
 /** Command to test UART protocol */
 #define COMMAND_UART_TEST               0x0001
+/** Command to switch the baud rate and the flow control, confirmed by a valid packet */
+#define COMMAND_UART_CONFIG             0x0003
+/** Command to read the number of requests and bytes the host may send ahead */
+#define COMMAND_UART_WINDOW             0x0004
+/** Command to switch between DLE escaping and COBS framing, confirmed by a valid packet */
+#define COMMAND_UART_FRAMING            0x0005
+/** Command to execute a list of reads, writes and erases and answer in one frame */
+#define COMMAND_BATCH                   0x0006
 /** Command to write raw data into ext mem */
 #define COMMAND_EXT_MEM_WRITE           0x0010
 /** Command to read raw data into ext mem */
@@ -85,6 +102,22 @@ typedef struct
 #define COMMAND_EXT_MEM_PAGE_ERASE      0x0012
 /** Command to perform chip erase */
 #define COMMAND_EXT_MEM_CHIP_ERASE      0x0013
+/** Command to predict the erase commands and time of a range (dry run) */
+#define COMMAND_EXT_MEM_ERASE_PLAN      0x0014
+/** Command to read (and clear) the erase counters */
+#define COMMAND_EXT_MEM_ERASE_STATS     0x0015
+/** Command to blank check a region and measure the check time */
+#define COMMAND_EXT_MEM_BLANK_CHECK     0x0016
+/** Command to set the SPI frequency of the commands and of the data */
+#define COMMAND_EXT_MEM_SPI_FREQUENCY   0x0017
+/** Command to read (and clear) the SPI counters and the program and erase latencies */
+#define COMMAND_EXT_MEM_STATS           0x0018
+/** Command to measure the deep power down wake to first read time and the boot time */
+#define COMMAND_EXT_MEM_WAKE_BENCHMARK  0x0019
+/** Command to set the idle time before the deep power down and read (and clear) its counters */
+#define COMMAND_EXT_MEM_POWER           0x001A
+/** Command to enable the read back of the programmed data */
+#define COMMAND_EXT_MEM_WRITE_VERIFY    0x001B
 
 /** Simple File system commands */
 #define COMMAND_SFS_READ                0x0100
@@ -95,6 +128,15 @@ typedef struct
 #define COMMAND_SFS_WRITE_IN_PARTS      0x0103
 /** Command to read last written file */
 #define COMMAND_SFS_LAST_WRITTEN        0x0104
+/** Command to measure the read latency of a file, copied and memory mapped */
+#define COMMAND_SFS_READ_LATENCY        0x0105
+/** Command to push a file range in data frames followed by an end frame with its CRC */
+#define COMMAND_SFS_STREAM              0x0106
+/** Command to push frames of the last stream again */
+#define COMMAND_SFS_STREAM_RESEND       0x0107
+/** Command to start a file upload, the data frames are acknowledged cumulatively */
+#define COMMAND_SFS_UPLOAD              0x0108
+#define COMMAND_SFS_UPLOAD_DATA         0x0109
 
 /** Measurement File Command  */
 #define COMMAND_MEAS_WRITE              0x0201
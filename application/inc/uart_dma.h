@@ -0,0 +1,147 @@
+#ifndef UART_DMA_H
+#define UART_DMA_H
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "stddef.h"
+#include "sdk_errors.h"
+#include "nrf_uarte.h"
+
+/** Number and length of the EasyDMA receive buffers. The UARTE fills one buffer while
+ *  the next one is queued, the others hold data not parsed yet */
+#ifndef UART_DMA_RX_NBR_BUFFERS
+#define UART_DMA_RX_NBR_BUFFERS   4
+#endif
+#ifndef UART_DMA_RX_BUFFER_LEN
+#define UART_DMA_RX_BUFFER_LEN    1024
+#endif
+
+/** Idle time of the line, in characters, after which a partly filled buffer is handed over */
+#ifndef UART_DMA_RX_TIMEOUT_CHARS
+#define UART_DMA_RX_TIMEOUT_CHARS 4
+#endif
+
+/** Length of each of the two transmit buffers, one is filled while the other is sent */
+#ifndef UART_DMA_TX_BUFFER_LEN
+#define UART_DMA_TX_BUFFER_LEN    1024
+#endif
+
+/** Counters of the UARTE driver */
+typedef struct
+{
+    /** Bytes received */
+    uint32_t rx_bytes;
+    /** Buffers filled (ENDRX) and handed over by the RX timeout */
+    uint32_t rx_buffers;
+    uint32_t rx_timeouts;
+    /** No free buffer could be queued, the bytes that followed were lost */
+    uint32_t rx_overruns;
+    /** Framing, parity, break and overrun errors of the UARTE */
+    uint32_t rx_errors;
+    /** Bytes sent */
+    uint32_t tx_bytes;
+    /** Transmit buffers the UARTE refused, their bytes were dropped */
+    uint32_t tx_errors;
+    /** Transmit buffers aborted because they were not sent in time, CTS held by the host */
+    uint32_t tx_timeouts;
+} uart_dma_stats_t;
+
+/**@brief Initialize the UARTE and start the reception
+ *
+ * @param[in]  baudrate UARTE baud rate setting (NRF_UARTE_BAUDRATE_xxx)
+ * @param[in]  hwfc True to enable the RTS/CTS flow control
+ *
+ * @return ret_code_t
+ */
+ret_code_t uart_dma_init(uint32_t baudrate, bool hwfc);
+
+/**@brief Restart the UARTE with another baud rate and flow control
+ *
+ * The pending transmission is sent at the old baud rate, unless it was dropped with
+ * uart_dma_tx_abort, the received data not parsed yet is dropped.
+ *
+ * @param[in]  baudrate UARTE baud rate setting (NRF_UARTE_BAUDRATE_xxx)
+ * @param[in]  hwfc True to enable the RTS/CTS flow control
+ *
+ * @return ret_code_t
+ */
+ret_code_t uart_dma_reconfigure(uint32_t baudrate, bool hwfc);
+
+/**@brief Get the UARTE baud rate setting of a baud rate
+ *
+ * @param[in]  bits_per_s Baud rate, up to 1000000
+ *
+ * @return NRF_UARTE_BAUDRATE_xxx, 0 when the baud rate is not supported
+ */
+uint32_t uart_dma_baudrate_get(uint32_t bits_per_s);
+
+/**@brief Get the received data not parsed yet
+ *
+ * The data is contiguous up to the end of its receive buffer, the next call gives
+ * the data of the next buffer.
+ *
+ * @param[out] data Received data, it stays valid until it is released
+ * @param[out] len Number of bytes
+ *
+ * @return true when there is data
+ */
+bool uart_dma_rx_get(const uint8_t **data, size_t *len);
+
+/**@brief Release the data given by uart_dma_rx_get
+ *
+ * A receive buffer is queued again once all its data is released.
+ *
+ * @param[in]  len Number of bytes parsed
+ */
+void uart_dma_rx_release(size_t len);
+
+/**@brief Write a byte, it is sent when a transmit buffer is full or flushed
+ */
+void uart_dma_put(uint8_t byte);
+
+/**@brief Write bytes, they are copied in blocks into the transmit buffers
+ */
+void uart_dma_write(const uint8_t *data, size_t len);
+
+/**@brief Get the free space of the transmit buffer being filled
+ *
+ * The buffer is sent first when less than 2 bytes are free, so that an escaped
+ * byte always fits.
+ *
+ * @param[out] buffer Start of the free space
+ *
+ * @return Number of free bytes
+ */
+size_t uart_dma_tx_reserve(uint8_t **buffer);
+
+/**@brief Add bytes written in the space given by uart_dma_tx_reserve
+ *
+ * @param[in]  len Number of bytes written
+ */
+void uart_dma_tx_commit(size_t len);
+
+/**@brief Send the bytes written with uart_dma_put
+ *
+ * A buffer the UARTE refuses is dropped and counted in tx_errors. The previous buffer
+ * is waited for at most its time on the line and UART_DMA_TX_TIMEOUT_MS, then aborted.
+ * The error of a buffer sent while writing is returned by the next flush.
+ *
+ * @return ret_code_t of the buffers sent since the last flush
+ */
+ret_code_t uart_dma_flush(void);
+
+/**@brief Drop the pending transmission, the buffer being sent is aborted
+ */
+void uart_dma_tx_abort(void);
+
+/**@brief Read the UARTE counters
+ *
+ * @param[out] stats Counters since the last clear
+ */
+void uart_dma_get_stats(uart_dma_stats_t *stats);
+
+/**@brief Clear the UARTE counters
+ */
+void uart_dma_clear_stats(void);
+
+#endif // UART_DMA_H
@@ -0,0 +1,106 @@
+#ifndef UART_FRAME_H
+#define UART_FRAME_H
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "stddef.h"
+
+/** UART Special characters used in packet framing */
+#define UART_FRAME_STX 0x02
+#define UART_FRAME_ETX 0x03
+#define UART_FRAME_DLE 0x04
+
+/** A frame starts with the CRC16 of the bytes that follow */
+#define UART_FRAME_CRC_LEN 2
+
+/** COBS frames end with a zero, a block of at most 254 bytes is led by its length */
+#define UART_FRAME_COBS_DELIMITER 0x00
+#define UART_FRAME_COBS_BLOCK_LEN 254
+
+/** Framing of the packets */
+typedef enum
+{
+    /** STX, data with STX, ETX and DLE escaped by DLE, ETX */
+    UART_FRAME_MODE_DLE = 0,
+    /** Consistent Overhead Byte Stuffing, 1 byte per 254 and a zero delimiter */
+    UART_FRAME_MODE_COBS = 1
+} uart_frame_mode_t;
+
+/** De-framer state, kept between the received chunks */
+typedef struct
+{
+    /** Unescaped frame content */
+    uint8_t *buffer;
+    size_t size;
+    size_t len;
+    /** A STX was received and the frame is not complete */
+    bool in_frame;
+    /** The previous byte was a DLE, the next one is inverted */
+    bool escape;
+    /** The frame did not fit in the buffer, it is dropped at its ETX */
+    bool overflow;
+    /** CRC16 of the frame after its CRC field, updated as the bytes are appended */
+    uint16_t crc16;
+    uart_frame_mode_t mode;
+    /** COBS bytes left in the current block, and a zero is added before the next block */
+    uint8_t cobs_remaining;
+    bool cobs_zero;
+} uart_frame_t;
+
+/**@brief Initialize a de-framer
+ *
+ * @param[in]  frame De-framer state
+ * @param[in]  buffer Buffer of the unescaped frame
+ * @param[in]  size Size of the buffer
+ */
+void uart_frame_init(uart_frame_t *frame, uint8_t *buffer, size_t size);
+
+/**@brief Change the framing, the frame being received is dropped
+ */
+void uart_frame_set_mode(uart_frame_t *frame, uart_frame_mode_t mode);
+
+/**@brief Change the buffer of the next frame, called after a complete frame
+ */
+void uart_frame_set_buffer(uart_frame_t *frame, uint8_t *buffer, size_t size);
+
+/**@brief Move the buffer of the frame being received, its bytes were copied there
+ */
+void uart_frame_move_buffer(uart_frame_t *frame, uint8_t *buffer, size_t size);
+
+/**@brief Unescape or COBS decode received bytes into the frame buffer
+ *
+ * The bytes between the special characters, or the COBS blocks, are copied in blocks
+ * and added to the CRC of the frame, it is known when the frame ends. The special
+ * characters are found a word at a time. The parsing stops after the end of a frame.
+ *
+ * @param[in]  frame De-framer state
+ * @param[in]  data Received bytes
+ * @param[in]  len Number of received bytes
+ * @param[out] used Number of bytes parsed
+ *
+ * @return true when a frame is complete, its length is frame->len
+ */
+bool uart_frame_deframe(uart_frame_t *frame, const uint8_t *data, size_t len, size_t *used);
+
+/**@brief Find the first special character (STX, ETX or DLE)
+ *
+ * @return Index of the special character, len when there is none
+ */
+size_t uart_frame_find_special(const uint8_t *data, size_t len);
+
+/**@brief Escape bytes into an output buffer
+ *
+ * The runs between the special characters are copied in blocks, an escaped byte is
+ * never split between two output buffers.
+ *
+ * @param[out] out Output buffer
+ * @param[in]  size Size of the output buffer, at least 2 bytes
+ * @param[in]  data Bytes to escape
+ * @param[in]  len Number of bytes to escape
+ * @param[out] used Number of bytes escaped
+ *
+ * @return Number of bytes written in the output buffer
+ */
+size_t uart_frame_escape(uint8_t *out, size_t size, const uint8_t *data, size_t len, size_t *used);
+
+#endif // UART_FRAME_H
@@ -291,6 +291,26 @@
 #define SPI_nHOLD_PIN 3
 #endif
 
+// <o> SPI_nCS1_PIN - Chip select of the second memory chip
+#ifndef SPI_nCS1_PIN
+#define SPI_nCS1_PIN 2
+#endif
+
+// <o> SPI_COMMAND_FREQUENCY_MHZ - SPI frequency of commands and status reads (1, 2, 4, 8, 16 or 32)
+#ifndef SPI_COMMAND_FREQUENCY_MHZ
+#define SPI_COMMAND_FREQUENCY_MHZ 8
+#endif
+
+// <o> SPI_DATA_FREQUENCY_MHZ - SPI frequency of the bulk data (1, 2, 4, 8, 16 or 32)
+#ifndef SPI_DATA_FREQUENCY_MHZ
+#define SPI_DATA_FREQUENCY_MHZ 32
+#endif
+
+// <o> EXT_MEM_NBR_DEVICES - Number of memory chips on the SPI bus
+#ifndef EXT_MEM_NBR_DEVICES
+#define EXT_MEM_NBR_DEVICES 1
+#endif
+
 
 // <o> SPI_IRQ_PRIORITY  - Interrupt priority
 
@@ -314,11 +334,11 @@
 #endif
 
 #ifndef APP_FIFO_ENABLED
-#define APP_FIFO_ENABLED 1
+#define APP_FIFO_ENABLED 0
 #endif
 
 #ifndef APP_UART_ENABLED
-#define APP_UART_ENABLED 1
+#define APP_UART_ENABLED 0
 #endif
 
 #ifndef APP_UART_DRIVER_INSTANCE
@@ -567,6 +587,112 @@
 
 // </e>
 
+// <q> NRFX_NVMC_ENABLED  - nrfx_nvmc - NVMC peripheral driver
+
+#ifndef NRFX_NVMC_ENABLED
+#define NRFX_NVMC_ENABLED 1
+#endif
+
+// <e> NRFX_QSPI_ENABLED - nrfx_qspi - QSPI peripheral driver, used by the XIP flash backend
+//==========================================================
+#ifndef NRFX_QSPI_ENABLED
+#define NRFX_QSPI_ENABLED 1
+#endif
+// <o> NRFX_QSPI_CONFIG_SCK_DELAY - tSHSL, tWHSL and tSHWL in number of 16 MHz periods (62.5 ns).  <0-255>
+
+#ifndef NRFX_QSPI_CONFIG_SCK_DELAY
+#define NRFX_QSPI_CONFIG_SCK_DELAY 1
+#endif
+
+// <o> NRFX_QSPI_CONFIG_XIP_OFFSET - Address offset in the external memory for Execute in Place operation.
+#ifndef NRFX_QSPI_CONFIG_XIP_OFFSET
+#define NRFX_QSPI_CONFIG_XIP_OFFSET 0
+#endif
+
+// <o> NRFX_QSPI_CONFIG_READOC  - Number of data lines and opcode used for reading.
+
+// <0=> FastRead
+// <1=> Read2O
+// <2=> Read2IO
+// <3=> Read4O
+// <4=> Read4IO
+
+#ifndef NRFX_QSPI_CONFIG_READOC
+#define NRFX_QSPI_CONFIG_READOC 0
+#endif
+
+// <o> NRFX_QSPI_CONFIG_WRITEOC  - Number of data lines and opcode used for writing.
+
+// <0=> PP
+// <1=> PP2O
+// <2=> PP4O
+// <3=> PP4IO
+
+#ifndef NRFX_QSPI_CONFIG_WRITEOC
+#define NRFX_QSPI_CONFIG_WRITEOC 0
+#endif
+
+// <o> NRFX_QSPI_CONFIG_ADDRMODE  - Addressing mode.
+
+// <0=> 24bit
+// <1=> 32bit
+
+#ifndef NRFX_QSPI_CONFIG_ADDRMODE
+#define NRFX_QSPI_CONFIG_ADDRMODE 0
+#endif
+
+// <o> NRFX_QSPI_CONFIG_MODE  - SPI mode.
+
+// <0=> Mode 0
+// <1=> Mode 1
+
+#ifndef NRFX_QSPI_CONFIG_MODE
+#define NRFX_QSPI_CONFIG_MODE 0
+#endif
+
+// <o> NRFX_QSPI_CONFIG_FREQUENCY  - Frequency divider.
+
+// <0=> 32MHz/1
+// <1=> 32MHz/2
+// <2=> 32MHz/3
+// <3=> 32MHz/4
+
+#ifndef NRFX_QSPI_CONFIG_FREQUENCY
+#define NRFX_QSPI_CONFIG_FREQUENCY 1
+#endif
+
+#ifndef NRFX_QSPI_PIN_SCK
+#define NRFX_QSPI_PIN_SCK BSP_QSPI_SCK_PIN
+#endif
+
+#ifndef NRFX_QSPI_PIN_CSN
+#define NRFX_QSPI_PIN_CSN BSP_QSPI_CSN_PIN
+#endif
+
+#ifndef NRFX_QSPI_PIN_IO0
+#define NRFX_QSPI_PIN_IO0 BSP_QSPI_IO0_PIN
+#endif
+
+#ifndef NRFX_QSPI_PIN_IO1
+#define NRFX_QSPI_PIN_IO1 BSP_QSPI_IO1_PIN
+#endif
+
+#ifndef NRFX_QSPI_PIN_IO2
+#define NRFX_QSPI_PIN_IO2 BSP_QSPI_IO2_PIN
+#endif
+
+#ifndef NRFX_QSPI_PIN_IO3
+#define NRFX_QSPI_PIN_IO3 BSP_QSPI_IO3_PIN
+#endif
+
+// <o> NRFX_QSPI_CONFIG_IRQ_PRIORITY  - Interrupt priority
+
+#ifndef NRFX_QSPI_CONFIG_IRQ_PRIORITY
+#define NRFX_QSPI_CONFIG_IRQ_PRIORITY 6
+#endif
+
+// </e>
+
 // <e> NRFX_PRS_ENABLED - nrfx_prs - Peripheral Resource Sharing module
 //==========================================================
 #ifndef NRFX_PRS_ENABLED
@@ -690,14 +816,14 @@
 
 
 #ifndef NRFX_SPIM3_ENABLED
-#define NRFX_SPIM3_ENABLED 0
+#define NRFX_SPIM3_ENABLED 1
 #endif
 
 // <q> NRFX_SPIM_EXTENDED_ENABLED  - Enable extended SPIM features
 
 
 #ifndef NRFX_SPIM_EXTENDED_ENABLED
-#define NRFX_SPIM_EXTENDED_ENABLED 0
+#define NRFX_SPIM_EXTENDED_ENABLED 1
 #endif
 
 // <o> NRFX_SPIM_MISO_PULL_CFG  - MISO pin pull configuration.
@@ -776,6 +902,16 @@
 
 // </e>
 
+// <q> NRFX_SPIM3_NRF52840_ANOMALY_198_WORKAROUND_ENABLED  - Enables nRF52840 anomaly 198 workaround for SPIM3.
+
+
+// <i> See more in the Errata document located at
+// <i> https://infocenter.nordicsemi.com/
+
+#ifndef NRFX_SPIM3_NRF52840_ANOMALY_198_WORKAROUND_ENABLED
+#define NRFX_SPIM3_NRF52840_ANOMALY_198_WORKAROUND_ENABLED 1
+#endif
+
 // </e>
 
 // <e> NRFX_SPI_ENABLED - nrfx_spi - SPI peripheral driver
@@ -11,6 +11,8 @@
 #include "app_util_platform.h"
 #include "app_error.h"
 #include "spi.h"
+#include "systick.h"
+#include "sfdp.h"
 #include "ext_mem_driver.h"
 
 #define MEM_ACCESS_READ  1
@@ -30,167 +32,1228 @@
 #define READ_STATUS_CMD         0x05
 #define WRITE_ENABLE_CMD        0x06
 #define ERASE_4K_CMD            0x20
+#define ERASE_32K_CMD           0x52
 #define REST_ENABLE_CMD         0x66
 #define REST_CMD                0x99
+#define READ_SFDP_CMD           0x5A
 #define READ_RDIR_CMD           0x9F
 #define ERASE_64K_CMD           0xD8
 #define ERASE_FULL_CMD          0xC7
 #define DEEP_POWER_DOWN         0xB9
+#define ENTER_4B_MODE_CMD       0xB7
+
+/* Commands with a 4 byte address */
+#define PAGE_PROGRAM_4B_CMD     0x12
+#define READ_DATA_4B_CMD        0x13
+#define ERASE_4K_4B_CMD         0x21
+#define ERASE_32K_4B_CMD        0x5C
+#define ERASE_64K_4B_CMD        0xDC
+
+/* Command and a 4 byte address */
+#define CMD_HEADER_MAX_LEN      5
 
 #define MAX_MEMORY_ADDRESS      MEM_END_ADDRESS
+/* Largest program length, a larger page is programmed in parts */
 #define MAX_PROGRAM_LEN         256
-#define MAX_PROG_LEN_MASK       0xFF
 
-#define NUMBER_SIXTY_FOUR_K (64 * 1024)
+#define NUMBER_SIXTY_FOUR_K (64 * 1024)
+
+/* Longest SFDP read used by the parser */
+#define SFDP_READ_MAX_LEN       64
+
+/* Erase time of an erase command the memory does not have */
+#define ERASE_NOT_SUPPORTED     (0xFFFFFFFF)
+
+/* Length and number of DMA buffers used by the blank check */
+#define BLANK_CHECK_BUFFER_LEN  1024
+#define BLANK_CHECK_NBR_BUFFERS 2
+
+/* Starting address of the external memory */
+#define EXT_MEM_START_ADDRESS 0x0
+
+/** One erase command selected by the erase planner */
+typedef struct
+{
+    uint8_t cmd;
+    uint32_t len;
+    uint32_t time_ms;
+} erase_step_t;
+
+static const ext_mem_erase_timing_t m_default_erase_timing = {
+    .erase_4k_ms = EXT_MEM_ERASE_4K_TIME_MS,
+    .erase_32k_ms = EXT_MEM_ERASE_32K_TIME_MS,
+    .erase_64k_ms = EXT_MEM_ERASE_64K_TIME_MS,
+    .erase_chip_ms = EXT_MEM_ERASE_CHIP_TIME_MS
+};
+
+/** Memory parameters used until they are read from the chip at init */
+static const ext_mem_info_t m_default_mem_info = {
+    .size = MEMORY_SIZE,
+    .page_size = MAX_PROGRAM_LEN,
+    .erase_4k_cmd = ERASE_4K_CMD,
+    .erase_32k_cmd = ERASE_32K_CMD,
+    .erase_64k_cmd = ERASE_64K_CMD,
+    .read_cmd = READ_DATA_CMD,
+    .program_cmd = PAGE_PROGRAM_CMD,
+    .address_len = 3,
+    .program_time_us = EXT_MEM_PAGE_PROGRAM_TIME_US
+};
+
+/** Number of pages tracked in the erased page maps, pages beyond are always erased */
+#define PAGE_MAP_NBR_PAGES  (EXT_MEM_PAGE_MAP_SIZE / MEM_PAGE_SIZE)
+/** Number of words in a map with one bit per 4K page */
+#define PAGE_MAP_WORDS      ((PAGE_MAP_NBR_PAGES + 31) / 32)
+
+/** State of a memory chip on the SPI bus */
+typedef struct
+{
+    uint32_t cs_pin;
+    ext_mem_info_t info;
+    ext_mem_erase_timing_t erase_timing;
+    /** Methods (SFDP_ENTER_4B_xxx) of the 4 byte address mode the memory is in, it is left at a reset */
+    uint8_t enter_4b_methods;
+    /** A program or erase is in progress, it is waited for before the next command */
+    bool busy;
+    /** Time between two status reads while busy */
+    uint32_t poll_period_us;
+    /** The operation in progress is an erase, otherwise a page program */
+    bool busy_erase;
+    /** Start time of the operation in progress */
+    uint32_t busy_start_us;
+    /** The device is in deep power down */
+    bool asleep;
+    /** Time of the last access */
+    uint32_t last_access_ms;
+    /** Time of the last deep power down entry or wake */
+    uint32_t state_ms;
+    /** Pages known to be erased, a page in neither map has an unknown state */
+    uint32_t erased_pages[PAGE_MAP_WORDS];
+    /** Pages known to be programmed since their last erase */
+    uint32_t programmed_pages[PAGE_MAP_WORDS];
+} ext_mem_device_t;
+
+static const uint32_t m_cs_pins[] = EXT_MEM_CS_PINS;
+STATIC_ASSERT(ARRAY_SIZE(m_cs_pins) >= EXT_MEM_NBR_DEVICES);
+static ext_mem_device_t m_devices[EXT_MEM_NBR_DEVICES];
+/** Device used by the memory functions, selected with ext_mem_select_device */
+static ext_mem_device_t *m_dev = &m_devices[0];
+static ext_mem_erase_stats_t m_erase_stats;
+static ext_mem_latency_stats_t m_latency_stats;
+static ext_mem_boot_time_t m_boot_time;
+static ext_mem_power_stats_t m_power_stats;
+static ext_mem_write_stats_t m_write_stats;
+static bool m_write_verify = EXT_MEM_WRITE_VERIFY;
+static uint32_t m_idle_timeout_ms = EXT_MEM_IDLE_TIMEOUT_MS;
+static bool m_init_done = false;
+
+/** Ring of buffers used to stream a region while it is blank checked */
+static uint32_t m_blank_check_buffer[BLANK_CHECK_NBR_BUFFERS][BLANK_CHECK_BUFFER_LEN / sizeof(uint32_t)];
+
+static ret_code_t wait_write_complete(void);
+
+/**@brief Wait for the program or erase in progress on the selected device
+ *
+ * Program and erase commands do not wait for their completion, so the other
+ * devices on the bus can be accessed meanwhile.
+ */
+static ret_code_t wait_device_ready(void)
+{
+    if (!m_dev->busy)
+    {
+        return NRF_SUCCESS;
+    }
+
+    m_dev->busy = false;
+    return wait_write_complete();
+}
+
+/**@brief Prepare the selected device for an access
+ *
+ * The device is woken up when it is in deep power down and the program or
+ * erase in progress is waited for.
+ */
+static ret_code_t device_access(void)
+{
+    ret_code_t err_code;
+
+    m_dev->last_access_ms = get_systick_timer();
+    if (m_dev->asleep)
+    {
+        err_code = ext_mem_wake(true);
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+    }
+
+    return wait_device_ready();
+}
+
+/**@brief Transfer at the frequency of a phase, once the device is ready */
+static ret_code_t spi_transfer_phase(spi_phase_t phase, uint8_t *tx_buff, size_t tx_len, uint8_t *rx_buff, size_t rx_len)
+{
+    ret_code_t err_code;
+
+    err_code = device_access();
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    /* The chip select is driven by the SPIM */
+    spi_select(m_dev->cs_pin);
+    spi_set_phase(phase);
+    err_code = spi_txrx(tx_buff, tx_len, rx_buff, rx_len);
+
+    return err_code;
+}
+
+static ret_code_t spi_transfer(uint8_t *tx_buff, size_t tx_len, uint8_t *rx_buff, size_t rx_len)
+{
+    return spi_transfer_phase(SPI_PHASE_COMMAND, tx_buff, tx_len, rx_buff, rx_len);
+}
+
+/**@brief Fill a command and its address (3 or 4 bytes) in a buffer
+ *
+ * @return Number of bytes filled
+ */
+static size_t set_cmd_address(uint8_t *buff, uint8_t cmd, uint32_t address)
+{
+    size_t len = 0;
+
+    buff[len++] = cmd;
+    if (m_dev->info.address_len == 4)
+    {
+        buff[len++] = (address >> 24) & 0xFF;
+    }
+    buff[len++] = (address >> 16) & 0xFF;
+    buff[len++] = (address >> 8) & 0xFF;
+    buff[len++] = (address & 0xFF);
+
+    return len;
+}
+
+//static ret_code_t write_status_reg(uint8_t value)
+//{
+//    ret_code_t err_code;
+//    uint8_t cmd[2] = { WRITE_STATUS_CMD, value };
+//    uint8_t temp[2];
+//
+//    err_code = spi_transfer(cmd, 2, temp, 2);
+//
+//    return err_code;
+//}
+
+static void latency_update(ext_mem_latency_t *latency, uint32_t time_us)
+{
+    latency->count++;
+    latency->total_us += time_us;
+    if (time_us > latency->max_us)
+    {
+        latency->max_us = time_us;
+    }
+}
+
+/**@brief Wait for the WIP bit of the status register to be cleared
+ *
+ * The status is read by the SPIM, started by a timer through PPI, the CPU
+ * sleeps between the reads.
+ */
+static ret_code_t wait_write_complete(void)
+{
+    ret_code_t err_code;
+    uint8_t cmd[2] = { READ_STATUS_CMD, 0 };
+    uint32_t time_ms = get_systick_timer();
+    uint32_t nbr_polls = 0;
+
+    spi_select(m_dev->cs_pin);
+    err_code = spi_poll_status(cmd, sizeof(cmd), 0x1, m_dev->poll_period_us, EXT_MEM_BUSY_TIMEOUT_MS, &nbr_polls);
+
+    m_erase_stats.busy_wait_ms += get_systick_timer() - time_ms;
+    m_erase_stats.status_polls += nbr_polls;
+    if (err_code == NRF_SUCCESS)
+    {
+        latency_update(m_dev->busy_erase ? &m_latency_stats.erase : &m_latency_stats.program, spi_time_us() - m_dev->busy_start_us);
+    }
+
+    return err_code;
+}
+
+static ret_code_t write_enable(void)
+{
+    ret_code_t err_code;
+    uint8_t cmd = WRITE_ENABLE_CMD;
+    uint8_t temp;
+
+    err_code = spi_transfer(&cmd, 1, &temp, 1);
+
+    return err_code;
+}
+
+/**@brief Reset the memory and wait for the end of the reset
+ *
+ * tRST covers an idle memory, a reset that aborts a program or an erase keeps
+ * the busy bit set until the memory is ready.
+ */
+static ret_code_t ext_mem_soft_reset(void)
+{
+    ret_code_t err_code;
+    uint8_t cmd = REST_ENABLE_CMD;
+    uint8_t status_cmd[2] = { READ_STATUS_CMD, 0 };
+    uint8_t temp;
+    uint32_t nbr_polls;
+
+    err_code = spi_transfer(&cmd, 1, &temp, 1);
+    if (err_code == NRF_SUCCESS)
+    {
+        cmd = REST_CMD;
+        err_code = spi_transfer(&cmd, 1, &temp, 1);
+    }
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    /* The operation in progress is aborted */
+    m_dev->busy = false;
+    nrf_delay_us(EXT_MEM_TRST_US);
+
+    spi_select(m_dev->cs_pin);
+    return spi_poll_status(status_cmd, sizeof(status_cmd), 0x1, EXT_MEM_TRST_US, EXT_MEM_RESET_TIMEOUT_MS, &nbr_polls);
+}
+
+static ret_code_t read_jedec_id(uint8_t *jedec_id)
+{
+    ret_code_t err_code;
+    uint8_t cmd[4] = { READ_RDIR_CMD, 0, 0, 0 };
+    uint8_t temp[4] = { 0 };
+
+    err_code = spi_transfer(cmd, sizeof(cmd), temp, sizeof(temp));
+    memcpy(jedec_id, &temp[1], 3);
+
+    return err_code;
+}
+
+/**@brief Check that the memory answers with its JEDEC ID
+ *
+ * A memory in deep power down or in reset leaves MISO floating or low. The ID
+ * read at init is compared when it is known.
+ */
+static bool jedec_id_check(void)
+{
+    uint8_t jedec_id[3];
+    static const uint8_t unknown_id[3] = { 0 };
+
+    if (read_jedec_id(jedec_id) != NRF_SUCCESS)
+    {
+        return false;
+    }
+
+    if (memcmp(m_dev->info.jedec_id, unknown_id, sizeof(jedec_id)) != 0)
+    {
+        return (memcmp(m_dev->info.jedec_id, jedec_id, sizeof(jedec_id)) == 0);
+    }
+
+    return ((jedec_id[0] != 0x00) && (jedec_id[0] != 0xFF));
+}
+
+/**@brief Read the SFDP space, used as the read function of the SFDP parser
+ *
+ * @return Zero on success
+ */
+static uint32_t read_sfdp(uint32_t address, uint8_t *data, uint32_t len)
+{
+    /* Command, 3 address bytes and a dummy byte */
+    uint8_t cmd[SFDP_READ_MAX_LEN + 5] = { 0 };
+    uint8_t temp[SFDP_READ_MAX_LEN + 5] = { 0 };
+    ret_code_t err_code;
+
+    if (len > SFDP_READ_MAX_LEN)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    cmd[0] = READ_SFDP_CMD;
+    cmd[1] = (address >> 16) & 0xFF;
+    cmd[2] = (address >> 8) & 0xFF;
+    cmd[3] = (address & 0xFF);
+
+    err_code = spi_transfer(cmd, len + 5, temp, len + 5);
+    if (err_code == NRF_SUCCESS)
+    {
+        memcpy(data, &temp[5], len);
+    }
+
+    return err_code;
+}
+
+/**@brief Use the erase type of an erase size found in the SFDP table
+ *
+ * @param[in]  use_4b_cmd Use the erase command with a 4 byte address
+ *
+ * @param[out] cmd Erase command, zero when the erase size is not found
+ * @param[out] time_ms Typical erase time, unchanged when the table does not have it
+ */
+static void sfdp_erase_type(const sfdp_info_t *sfdp, uint32_t size, bool use_4b_cmd, uint8_t *cmd, uint32_t *time_ms)
+{
+    uint32_t i;
+
+    *cmd = 0;
+    for (i = 0; i < SFDP_NBR_ERASE_TYPES; i++)
+    {
+        if (sfdp->erase_type[i].size == size)
+        {
+            *cmd = use_4b_cmd ? sfdp->erase_type[i].opcode_4b : sfdp->erase_type[i].opcode;
+            if (sfdp->erase_type[i].typ_time_ms != 0)
+            {
+                *time_ms = sfdp->erase_type[i].typ_time_ms;
+            }
+        }
+    }
+}
+
+/**@brief Switch the memory to the 4 byte address mode */
+static ret_code_t enter_4b_address_mode(uint8_t methods)
+{
+    ret_code_t err_code = NRF_SUCCESS;
+    uint8_t cmd = ENTER_4B_MODE_CMD;
+    uint8_t temp;
+
+    if ((methods & SFDP_ENTER_4B_WREN_B7) && !(methods & SFDP_ENTER_4B_B7))
+    {
+        err_code = write_enable();
+    }
+
+    if (err_code == NRF_SUCCESS)
+    {
+        err_code = spi_transfer(&cmd, 1, &temp, 1);
+    }
+
+    return err_code;
+}
+
+/**@brief Use the commands with a 4 byte address */
+static void use_4b_commands(void)
+{
+    m_dev->info.address_len = 4;
+    m_dev->info.read_cmd = READ_DATA_4B_CMD;
+    m_dev->info.program_cmd = PAGE_PROGRAM_4B_CMD;
+    m_dev->info.erase_4k_cmd = ERASE_4K_4B_CMD;
+    m_dev->info.erase_32k_cmd = ERASE_32K_4B_CMD;
+    m_dev->info.erase_64k_cmd = ERASE_64K_4B_CMD;
+}
+
+/**@brief Detect the memory size, page size, erase commands and erase times
+ *
+ * The SFDP tables are used when the memory has them, otherwise the size is taken
+ * from the capacity byte of the JEDEC ID and the defaults are kept.
+ *
+ * Memories larger than 16 Mbyte use the commands with a 4 byte address when the
+ * memory has them, otherwise the memory is switched to the 4 byte address mode.
+ */
+static void ext_mem_detect(void)
+{
+    sfdp_info_t sfdp;
+    sfdp_status_t status;
+    uint8_t capacity;
+    bool use_4b_cmd = false;
+
+    if (read_jedec_id(m_dev->info.jedec_id) != NRF_SUCCESS)
+    {
+        NRF_LOG_WARNING("JEDEC ID read failed, using default memory parameters");
+        return;
+    }
+
+    NRF_LOG_INFO("JEDEC ID %02X %02X %02X", m_dev->info.jedec_id[0], m_dev->info.jedec_id[1], m_dev->info.jedec_id[2]);
+
+    status = sfdp_parse(read_sfdp, &sfdp);
+    if (status == SFDP_STATUS_SUCCESS)
+    {
+        m_dev->info.sfdp_valid = true;
+        m_dev->info.size = sfdp.density;
+        m_dev->info.fast_read_modes = sfdp.fast_read_modes;
+
+        /* A power of two page size up to the program buffer size */
+        if ((sfdp.page_size >= 16) && (sfdp.page_size <= MAX_PROGRAM_LEN))
+        {
+            m_dev->info.page_size = sfdp.page_size;
+        }
+
+        if (m_dev->info.size > EXT_MEM_MAX_3_BYTE_SIZE)
+        {
+            if (sfdp.read_4b && sfdp.program_4b)
+            {
+                use_4b_commands();
+                use_4b_cmd = true;
+            }
+            else if ((sfdp.address_mode != SFDP_ADDRESS_3_BYTE) && (enter_4b_address_mode(sfdp.enter_4b_methods) == NRF_SUCCESS))
+            {
+                m_dev->info.address_len = 4;
+                m_dev->enter_4b_methods = sfdp.enter_4b_methods;
+            }
+        }
+
+        sfdp_erase_type(&sfdp, MEM_PAGE_SIZE, use_4b_cmd, &m_dev->info.erase_4k_cmd, &m_dev->erase_timing.erase_4k_ms);
+        sfdp_erase_type(&sfdp, MEM_HALF_SECTOR_SIZE, use_4b_cmd, &m_dev->info.erase_32k_cmd, &m_dev->erase_timing.erase_32k_ms);
+        sfdp_erase_type(&sfdp, MEM_SECTOR_SIZE, use_4b_cmd, &m_dev->info.erase_64k_cmd, &m_dev->erase_timing.erase_64k_ms);
+        if (sfdp.chip_erase_typ_ms != 0)
+        {
+            m_dev->erase_timing.erase_chip_ms = sfdp.chip_erase_typ_ms;
+        }
+        if (sfdp.page_program_typ_us != 0)
+        {
+            m_dev->info.program_time_us = sfdp.page_program_typ_us;
+        }
+    }
+    else
+    {
+        NRF_LOG_INFO("No SFDP table (%d)", status);
+
+        /* Capacity byte is the log2 of the size for most serial flash memories */
+        capacity = m_dev->info.jedec_id[2];
+        if ((capacity >= 16) && (capacity <= 31))
+        {
+            m_dev->info.size = 1UL << capacity;
+        }
+
+        if (m_dev->info.size > EXT_MEM_MAX_3_BYTE_SIZE)
+        {
+            /* 4 byte address commands of the large memories, 32K erase is not common */
+            use_4b_commands();
+            m_dev->info.erase_32k_cmd = 0;
+        }
+    }
+
+    if ((m_dev->info.size > EXT_MEM_MAX_3_BYTE_SIZE) && (m_dev->info.address_len != 4))
+    {
+        /* Only the 3 byte address range can be used */
+        m_dev->info.size = EXT_MEM_MAX_3_BYTE_SIZE;
+    }
+
+    NRF_LOG_INFO("Memory size %d bytes, page size %d bytes, %d byte address", m_dev->info.size, m_dev->info.page_size, m_dev->info.address_len);
+}
+
+ret_code_t ext_mem_select_device(uint8_t device)
+{
+    if (device >= EXT_MEM_NBR_DEVICES)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_dev = &m_devices[device];
+    return NRF_SUCCESS;
+}
+
+uint8_t ext_mem_selected_device(void)
+{
+    return (uint8_t) (m_dev - m_devices);
+}
+
+ret_code_t ext_mem_wait_ready(void)
+{
+    return wait_device_ready();
+}
+
+const ext_mem_info_t *ext_mem_get_info(void)
+{
+    return &m_dev->info;
+}
+
+ret_code_t enable_ext_mem_deep_power_down(void)
+{
+    ret_code_t err_code;
+    uint8_t cmd = DEEP_POWER_DOWN;
+    uint8_t temp;
+
+    /* The transfer waits for a program or erase in progress */
+    err_code = spi_transfer(&cmd, 1, &temp, 1);
+
+    nrf_delay_us(EXT_MEM_TDP_US);
+    return err_code;
+}
+
+ret_code_t release_ext_mem_deep_power_down(void)
+{
+    /* A CS pulse releases the memory from the deep power down, the memory
+     * accepts commands after tRES1 */
+    spi_select(m_dev->cs_pin);
+    spi_cs_hold(true);
+    spi_cs_hold(false);
+    nrf_delay_us(EXT_MEM_TRES1_US);
+    return NRF_SUCCESS;
+}
+
+/**@brief Release the memory from deep power down and check it answers
+ *
+ * @param[in]  fast Skip the reset when the JEDEC ID is right
+ * @param[out] reset_done True when the memory was reset
+ */
+static ret_code_t wake_device(bool fast, bool *reset_done)
+{
+    ret_code_t err_code;
+
+    *reset_done = false;
+    release_ext_mem_deep_power_down();
+    if (fast && jedec_id_check())
+    {
+        return NRF_SUCCESS;
+    }
+
+    *reset_done = true;
+    err_code = ext_mem_soft_reset();
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    return jedec_id_check() ? NRF_SUCCESS : NRF_ERROR_NOT_FOUND;
+}
+
+ret_code_t ext_mem_sleep(void)
+{
+    ret_code_t err_code;
+    uint32_t time_ms;
+
+    if (m_dev->asleep)
+    {
+        return NRF_SUCCESS;
+    }
+
+    err_code = enable_ext_mem_deep_power_down();
+    if (err_code == NRF_SUCCESS)
+    {
+        time_ms = get_systick_timer();
+        m_power_stats.sleeps++;
+        m_power_stats.awake_ms += time_ms - m_dev->state_ms;
+        m_dev->state_ms = time_ms;
+        m_dev->asleep = true;
+    }
+
+    return err_code;
+}
+
+ret_code_t ext_mem_wake(bool fast)
+{
+    ret_code_t err_code;
+    uint32_t time_us = spi_time_us();
+    uint32_t time_ms;
+    bool reset_done;
+
+    /* Cleared first, the wake reads the JEDEC ID through the access functions */
+    if (m_dev->asleep)
+    {
+        time_ms = get_systick_timer();
+        m_power_stats.sleep_ms += time_ms - m_dev->state_ms;
+        m_dev->state_ms = time_ms;
+        m_dev->asleep = false;
+    }
+
+    err_code = wake_device(fast, &reset_done);
+    if ((err_code == NRF_SUCCESS) && reset_done && (m_dev->info.address_len == 4)
+            && (m_dev->info.read_cmd != READ_DATA_4B_CMD))
+    {
+        /* The reset leaves the 4 byte address mode, the detected parameters are kept */
+        err_code = enter_4b_address_mode(m_dev->enter_4b_methods);
+    }
+
+    time_us = spi_time_us() - time_us;
+    m_power_stats.wakes++;
+    m_power_stats.wake_total_us += time_us;
+    if (time_us > m_power_stats.wake_max_us)
+    {
+        m_power_stats.wake_max_us = time_us;
+    }
+
+    return err_code;
+}
+
+/**@brief Check the busy bit of the program or erase in progress without waiting
+ *
+ * @return True while the operation is in progress
+ */
+static bool device_busy_check(void)
+{
+    uint8_t cmd[2] = { READ_STATUS_CMD, 0 };
+    uint8_t status[2] = { 0 };
+
+    if (!m_dev->busy)
+    {
+        return false;
+    }
+
+    spi_select(m_dev->cs_pin);
+    spi_set_phase(SPI_PHASE_COMMAND);
+    if ((spi_txrx(cmd, sizeof(cmd), status, sizeof(status)) != NRF_SUCCESS) || ((status[1] & 0x1) != 0))
+    {
+        return true;
+    }
+
+    /* Completed, one status read records its latency */
+    wait_device_ready();
+    return false;
+}
+
+void ext_mem_idle_process(void)
+{
+    ext_mem_device_t *selected = m_dev;
+    uint8_t i;
+
+    if (!m_init_done || (m_idle_timeout_ms == 0))
+    {
+        return;
+    }
+
+    for (i = 0; i < EXT_MEM_NBR_DEVICES; i++)
+    {
+        m_dev = &m_devices[i];
+        if (!m_dev->asleep && ((get_systick_timer() - m_dev->last_access_ms) >= m_idle_timeout_ms) && !device_busy_check())
+        {
+            ext_mem_sleep();
+        }
+    }
+    m_dev = selected;
+}
+
+void ext_mem_set_idle_timeout(uint32_t timeout_ms)
+{
+    m_idle_timeout_ms = timeout_ms;
+}
+
+uint32_t ext_mem_get_idle_timeout(void)
+{
+    return m_idle_timeout_ms;
+}
+
+void ext_mem_get_power_stats(ext_mem_power_stats_t *stats)
+{
+    uint32_t time_ms = get_systick_timer();
+    uint8_t i;
+
+    *stats = m_power_stats;
+    /* Add the time in the current state */
+    for (i = 0; i < EXT_MEM_NBR_DEVICES; i++)
+    {
+        if (m_devices[i].asleep)
+        {
+            stats->sleep_ms += time_ms - m_devices[i].state_ms;
+        }
+        else
+        {
+            stats->awake_ms += time_ms - m_devices[i].state_ms;
+        }
+    }
+}
+
+void ext_mem_clear_power_stats(void)
+{
+    uint32_t time_ms = get_systick_timer();
+    uint8_t i;
+
+    memset(&m_power_stats, 0, sizeof(m_power_stats));
+    for (i = 0; i < EXT_MEM_NBR_DEVICES; i++)
+    {
+        m_devices[i].state_ms = time_ms;
+    }
+}
+
+const ext_mem_boot_time_t *ext_mem_get_boot_time(void)
+{
+    return &m_boot_time;
+}
+
+/**@brief Update the erased page map of a range
+ *
+ * @param[in]  erased True when the range is erased, false when it is programmed
+ */
+static void erased_map_update(uint32_t address, uint32_t len, bool erased)
+{
+    uint32_t page = address / MEM_PAGE_SIZE;
+    uint32_t end_page = (address + len + MEM_PAGE_SIZE - 1) / MEM_PAGE_SIZE;
+
+    if (end_page > PAGE_MAP_NBR_PAGES)
+    {
+        end_page = PAGE_MAP_NBR_PAGES;
+    }
+
+    for (; page < end_page; page++)
+    {
+        if (erased)
+        {
+            m_dev->erased_pages[page / 32] |= (1UL << (page % 32));
+            m_dev->programmed_pages[page / 32] &= ~(1UL << (page % 32));
+        }
+        else
+        {
+            m_dev->erased_pages[page / 32] &= ~(1UL << (page % 32));
+            m_dev->programmed_pages[page / 32] |= (1UL << (page % 32));
+        }
+    }
+}
+
+/**@brief Check if a page is erased
+ *
+ * A page that is neither known to be erased nor known to be programmed is
+ * blank checked once and the result is kept in the page maps.
+ *
+ * @param[in]  blank_check False to take the unknown pages as not erased, without reading them
+ */
+static bool page_known_erased(uint32_t address, bool blank_check)
+{
+    uint32_t page = address / MEM_PAGE_SIZE;
+
+    if (page >= PAGE_MAP_NBR_PAGES)
+    {
+        return false;
+    }
+
+    if (m_dev->erased_pages[page / 32] & (1UL << (page % 32)))
+    {
+        return true;
+    }
+
+    if ((m_dev->programmed_pages[page / 32] & (1UL << (page % 32))) || !blank_check)
+    {
+        return false;
+    }
+
+    m_erase_stats.blank_checks++;
+    erased_map_update(address, MEM_PAGE_SIZE, memory_is_blank(address, MEM_PAGE_SIZE));
+
+    return (m_dev->erased_pages[page / 32] & (1UL << (page % 32))) != 0;
+}
+
+/** Multiply an erase time, saturating at ERASE_NOT_SUPPORTED */
+static uint32_t erase_time_mul(uint32_t time_ms, uint32_t count)
+{
+    return (time_ms >= (ERASE_NOT_SUPPORTED / count)) ? ERASE_NOT_SUPPORTED : (time_ms * count);
+}
+
+/**@brief Select the erase command for the beginning of an aligned range
+ *
+ * The erase blocks are nested (a 64K sector holds two 32K blocks, a 32K block
+ * holds eight 4K pages), so picking the largest aligned block that is not slower
+ * than erasing its content with smaller blocks gives the minimal total time.
+ *
+ * @return false when no supported erase command fits the range
+ */
+static bool erase_next_step(uint32_t address, uint32_t size, erase_step_t *step)
+{
+    uint32_t cost_page = (m_dev->info.erase_4k_cmd != 0) ? m_dev->erase_timing.erase_4k_ms : ERASE_NOT_SUPPORTED;
+    uint32_t cost_half_sector = (m_dev->info.erase_32k_cmd != 0) ? m_dev->erase_timing.erase_32k_ms : ERASE_NOT_SUPPORTED;
+
+    if (cost_half_sector > erase_time_mul(cost_page, MEM_HALF_SECTOR_SIZE / MEM_PAGE_SIZE))
+    {
+        cost_half_sector = erase_time_mul(cost_page, MEM_HALF_SECTOR_SIZE / MEM_PAGE_SIZE);
+    }
+
+    if ((m_dev->info.erase_64k_cmd != 0) && (size >= MEM_SECTOR_SIZE) && ((address % MEM_SECTOR_SIZE) == 0)
+            && (m_dev->erase_timing.erase_64k_ms <= erase_time_mul(cost_half_sector, MEM_SECTOR_SIZE / MEM_HALF_SECTOR_SIZE)))
+    {
+        step->cmd = m_dev->info.erase_64k_cmd;
+        step->len = MEM_SECTOR_SIZE;
+        step->time_ms = m_dev->erase_timing.erase_64k_ms;
+    }
+    else if ((m_dev->info.erase_32k_cmd != 0) && (size >= MEM_HALF_SECTOR_SIZE) && ((address % MEM_HALF_SECTOR_SIZE) == 0)
+            && (m_dev->erase_timing.erase_32k_ms <= erase_time_mul(cost_page, MEM_HALF_SECTOR_SIZE / MEM_PAGE_SIZE)))
+    {
+        step->cmd = m_dev->info.erase_32k_cmd;
+        step->len = MEM_HALF_SECTOR_SIZE;
+        step->time_ms = m_dev->erase_timing.erase_32k_ms;
+    }
+    else if (m_dev->info.erase_4k_cmd != 0)
+    {
+        step->cmd = m_dev->info.erase_4k_cmd;
+        step->len = MEM_PAGE_SIZE;
+        step->time_ms = m_dev->erase_timing.erase_4k_ms;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+static ret_code_t erase_check_range(uint32_t address, uint32_t size)
+{
+    /** Check address alignment and erase size with page size */
+    if (((address % MEM_PAGE_SIZE) != 0) || ((size % MEM_PAGE_SIZE) != 0))
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    if ((address + size) > m_dev->info.size)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t memory_erase_plan(uint32_t address, uint32_t size, ext_mem_erase_plan_t *plan)
+{
+    ret_code_t err_code;
+    erase_step_t step;
+    /** Chip erase is only possible when the range covers the whole device */
+    bool whole_chip = (address == EXT_MEM_START_ADDRESS) && (size == m_dev->info.size);
+
+    if (!plan)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    memset(plan, 0, sizeof(ext_mem_erase_plan_t));
+
+    err_code = erase_check_range(address, size);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    while (size > 0)
+    {
+        if (!erase_next_step(address, size, &step))
+        {
+            return NRF_ERROR_NOT_SUPPORTED;
+        }
+
+        if (step.len == MEM_SECTOR_SIZE)
+        {
+            plan->nbr_64k++;
+        }
+        else if (step.len == MEM_HALF_SECTOR_SIZE)
+        {
+            plan->nbr_32k++;
+        }
+        else
+        {
+            plan->nbr_4k++;
+        }
+        plan->time_ms += step.time_ms;
+        address += step.len;
+        size -= step.len;
+    }
+
+    /** Use chip erase when the whole device is erased and it is faster */
+    if (whole_chip && (plan->time_ms > m_dev->erase_timing.erase_chip_ms))
+    {
+        memset(plan, 0, sizeof(ext_mem_erase_plan_t));
+        plan->nbr_chip = 1;
+        plan->time_ms = m_dev->erase_timing.erase_chip_ms;
+    }
+
+    return NRF_SUCCESS;
+}
+
+void memory_set_erase_timing(const ext_mem_erase_timing_t *timing)
+{
+    if (timing)
+    {
+        m_dev->erase_timing = *timing;
+    }
+}
+
+void memory_get_erase_timing(ext_mem_erase_timing_t *timing)
+{
+    if (timing)
+    {
+        *timing = m_dev->erase_timing;
+    }
+}
+
+static ret_code_t erase_command(uint8_t *cmd, size_t cmd_len)
+{
+    ret_code_t err_code;
+    uint8_t temp[4];
+
+    err_code = write_enable();
+    if (err_code == NRF_SUCCESS)
+    {
+        err_code = spi_transfer(cmd, cmd_len, temp, cmd_len);
+    }
+
+    /* Erase completion is waited for before the next command */
+    m_dev->busy = (err_code == NRF_SUCCESS);
+    m_dev->poll_period_us = EXT_MEM_ERASE_POLL_PERIOD_US;
+    m_dev->busy_erase = true;
+    m_dev->busy_start_us = spi_time_us();
 
-/* Starting address of the external memory */
-#define EXT_MEM_START_ADDRESS 0x0
+    return err_code;
+}
 
-static ret_code_t spi_transfer(uint8_t *tx_buff, size_t tx_len, uint8_t *rx_buff, size_t rx_len)
+/**@brief Erase an aligned range with the planned erase commands */
+static ret_code_t erase_range(uint32_t address, uint32_t size)
 {
-    ret_code_t err_code;
+    ret_code_t err_code = NRF_SUCCESS;
+    erase_step_t step;
+    uint8_t cmd[CMD_HEADER_MAX_LEN];
+    size_t cmd_len;
 
-    nrf_gpio_pin_clear(SPI_nCS_PIN);
+    while ((size > 0) && (err_code == NRF_SUCCESS))
+    {
+        if (!erase_next_step(address, size, &step))
+        {
+            return NRF_ERROR_NOT_SUPPORTED;
+        }
 
-    err_code = spi_txrx(tx_buff, tx_len, rx_buff, rx_len);
+        cmd_len = set_cmd_address(cmd, step.cmd, address);
+        err_code = erase_command(cmd, cmd_len);
+        if (err_code == NRF_SUCCESS)
+        {
+            erased_map_update(address, step.len, true);
+            m_erase_stats.pages_erased += step.len / MEM_PAGE_SIZE;
+            m_erase_stats.time_ms += step.time_ms;
+        }
 
-    /* Enable write protect and disable chip select pin */
-    nrf_gpio_pin_set(SPI_nCS_PIN);
+        address += step.len;
+        size -= step.len;
+    }
 
     return err_code;
 }
 
-//static ret_code_t write_status_reg(uint8_t value)
-//{
-//    ret_code_t err_code;
-//    uint8_t cmd[2] = { WRITE_STATUS_CMD, value };
-//    uint8_t temp[2];
-//
-//    err_code = spi_transfer(cmd, 2, temp, 2);
-//
-//    return err_code;
-//}
-
-static ret_code_t wait_write_complete(void)
+/**@brief Erase (or only plan, when execute is false) the runs of pages that are not erased */
+static ret_code_t erase_runs(uint32_t address, uint32_t size, bool execute, bool blank_check, uint32_t *time_ms)
 {
-    ret_code_t err_code;
-    uint8_t cmd[3] = { READ_STATUS_CMD, 0, 0 };
-    uint8_t temp[3] = { 0 };
+    ret_code_t err_code = NRF_SUCCESS;
+    ext_mem_erase_plan_t plan;
+    uint32_t end_address = address + size;
+    uint32_t run_address;
 
-    do
+    while ((address < end_address) && (err_code == NRF_SUCCESS))
     {
-        err_code = spi_transfer(cmd, 3, temp, 3);
+        /** Skip the erased pages */
+        while ((address < end_address) && page_known_erased(address, blank_check))
+        {
+            address += MEM_PAGE_SIZE;
+        }
+
+        run_address = address;
+        while ((address < end_address) && !page_known_erased(address, blank_check))
+        {
+            address += MEM_PAGE_SIZE;
+        }
+
+        if (address > run_address)
+        {
+            /** A run no erase command fits, such as single pages without a 4K erase */
+            err_code = memory_erase_plan(run_address, address - run_address, &plan);
+            if (err_code != NRF_SUCCESS)
+            {
+                *time_ms = ERASE_NOT_SUPPORTED;
+            }
+            else
+            {
+                *time_ms = ((ERASE_NOT_SUPPORTED - *time_ms) > plan.time_ms) ? (*time_ms + plan.time_ms) : ERASE_NOT_SUPPORTED;
+                if (execute)
+                {
+                    err_code = erase_range(run_address, address - run_address);
+                }
+            }
+        }
     }
-    while (((temp[1] & 0x1) != 0) && (err_code == NRF_SUCCESS));
 
     return err_code;
 }
 
-static ret_code_t write_enable(void)
+/**@brief Erase a range, skipping the pages known to be erased
+ *
+ * Each 64K sector of the range is either erased as a whole or only in runs of
+ * non-erased pages, whichever is predicted to be faster.
+ */
+static ret_code_t erase_skip_erased(uint32_t address, uint32_t size, bool execute, bool blank_check, uint32_t *time_ms)
 {
-    ret_code_t err_code;
-    uint8_t cmd = WRITE_ENABLE_CMD;
-    uint8_t temp;
+    ret_code_t err_code = NRF_SUCCESS;
+    ext_mem_erase_plan_t plan;
+    uint32_t chunk_len;
+    uint32_t runs_time_ms;
 
-    err_code = spi_transfer(&cmd, 1, &temp, 1);
+    while ((size > 0) && (err_code == NRF_SUCCESS))
+    {
+        chunk_len = MEM_SECTOR_SIZE - (address % MEM_SECTOR_SIZE);
+        if (chunk_len > size)
+        {
+            chunk_len = size;
+        }
+
+        /** A range that cannot be planned costs ERASE_NOT_SUPPORTED, the other one is taken */
+        if (memory_erase_plan(address, chunk_len, &plan) != NRF_SUCCESS)
+        {
+            plan.time_ms = ERASE_NOT_SUPPORTED;
+        }
+        runs_time_ms = 0;
+        erase_runs(address, chunk_len, false, blank_check, &runs_time_ms);
+
+        if ((runs_time_ms == ERASE_NOT_SUPPORTED) && (plan.time_ms == ERASE_NOT_SUPPORTED))
+        {
+            return NRF_ERROR_NOT_SUPPORTED;
+        }
+        else if (runs_time_ms < plan.time_ms)
+        {
+            *time_ms += runs_time_ms;
+            if (execute)
+            {
+                err_code = erase_runs(address, chunk_len, true, blank_check, &runs_time_ms);
+            }
+        }
+        else
+        {
+            *time_ms += plan.time_ms;
+            if (execute)
+            {
+                err_code = erase_range(address, chunk_len);
+            }
+        }
+
+        address += chunk_len;
+        size -= chunk_len;
+    }
 
     return err_code;
 }
 
-static ret_code_t ext_mem_soft_reset(void)
+ret_code_t memory_erase(uint32_t address, uint32_t size)
 {
     ret_code_t err_code;
-    uint8_t cmd = REST_ENABLE_CMD;
-    uint8_t temp;
+    ext_mem_erase_plan_t plan;
+    uint32_t time_ms = 0;
+    uint8_t cmd;
 
-    err_code = spi_transfer(&cmd, 1, &temp, 1);
-    nrf_delay_ms(10);
-    if (err_code == NRF_SUCCESS)
+    err_code = memory_erase_plan(address, size, &plan);
+    if (err_code != NRF_SUCCESS)
     {
-        cmd = REST_CMD;
-        err_code = spi_transfer(&cmd, 1, &temp, 1);
-        nrf_delay_ms(10);
+        return err_code;
     }
 
-    return err_code;
+    m_erase_stats.pages_requested += size / MEM_PAGE_SIZE;
+    m_erase_stats.planned_time_ms += plan.time_ms;
+
+    if (plan.nbr_chip != 0)
+    {
+        /** Decided from the page maps only, a blank check of the whole chip would take longer */
+        if ((erase_skip_erased(address, size, false, false, &time_ms) != NRF_SUCCESS) || (time_ms > plan.time_ms))
+        {
+            cmd = ERASE_FULL_CMD;
+            err_code = erase_command(&cmd, 1);
+            if (err_code == NRF_SUCCESS)
+            {
+                erased_map_update(address, size, true);
+                m_erase_stats.pages_erased += size / MEM_PAGE_SIZE;
+                m_erase_stats.time_ms += plan.time_ms;
+            }
+            return err_code;
+        }
+    }
+
+    return erase_skip_erased(address, size, true, true, &time_ms);
 }
 
-ret_code_t enable_ext_mem_deep_power_down(void)
+void memory_get_erase_stats(ext_mem_erase_stats_t *stats)
 {
-    ret_code_t err_code;
-    uint8_t cmd = DEEP_POWER_DOWN;
-    uint8_t temp;
+    *stats = m_erase_stats;
+}
 
-    /* Recommended to have a delay before the command */
-    nrf_delay_ms(10);
+void memory_clear_erase_stats(void)
+{
+    memset(&m_erase_stats, 0, sizeof(m_erase_stats));
+}
 
-    err_code = spi_transfer(&cmd, 1, &temp, 1);
+void memory_get_latency_stats(ext_mem_latency_stats_t *stats)
+{
+    *stats = m_latency_stats;
+}
 
-    /* Must wait for at least couple of ms */
-    nrf_delay_ms(10);
-    return err_code;
+void memory_clear_latency_stats(void)
+{
+    memset(&m_latency_stats, 0, sizeof(m_latency_stats));
 }
 
-ret_code_t release_ext_mem_deep_power_down(void)
+void memory_get_write_stats(ext_mem_write_stats_t *stats)
 {
-    /* Toggle the CS pin to release from the deep power down */
-    nrf_delay_ms(10);
-    nrf_gpio_pin_clear(SPI_nCS_PIN);
-    nrf_delay_ms(10);
-    nrf_gpio_pin_set(SPI_nCS_PIN);
-    nrf_delay_ms(10);
-    return NRF_SUCCESS;
+    *stats = m_write_stats;
 }
 
-ret_code_t memory_erase(uint32_t address, uint32_t size)
+void memory_clear_write_stats(void)
 {
-    ret_code_t err_code = NRF_SUCCESS;
-    uint8_t cmd[4];
-    uint8_t temp[4];
+    memset(&m_write_stats, 0, sizeof(m_write_stats));
+}
 
-    /** Check if address is aligned with 4K */
-    while (size > 0)
+void memory_set_write_verify(bool enable)
+{
+    m_write_verify = enable;
+}
+
+bool memory_get_write_verify(void)
+{
+    return m_write_verify;
+}
+
+/**@brief Program the data of one page
+ *
+ * The leading and trailing 0xFF bytes are not programmed, programming a 1 leaves
+ * the bit unchanged. The program is read back when the write verify is enabled.
+ *
+ * @param[in]  data_bytes Buffer for the command, the address and the data
+ * @param[in]  dummy Buffer for the bytes received
+ */
+static ret_code_t program_page(uint32_t address, const uint8_t *data, uint32_t len, uint8_t *data_bytes, uint8_t *dummy)
+{
+    ret_code_t err_code;
+    size_t header_len;
+
+    while ((len > 0) && (data[0] == 0xFF))
     {
-        /** Check address alignment and erase size with page size */
-        if ((address % MEM_PAGE_SIZE) != 0 || (size < MEM_PAGE_SIZE))
-        {
-            return NRF_ERROR_INVALID_DATA;
-        }
+        data++;
+        address++;
+        len--;
+    }
+    while ((len > 0) && (data[len - 1] == 0xFF))
+    {
+        len--;
+    }
 
-        cmd[1] = (address >> 16) & 0xFF;
-        cmd[2] = (address >> 8) & 0xFF;
-        cmd[3] = (address & 0xFF);
+    if (len == 0)
+    {
+        m_write_stats.programs_skipped++;
+        return NRF_SUCCESS;
+    }
 
-        if ((size >= MEM_SECTOR_SIZE) && (address % MEM_SECTOR_SIZE == 0))
-        {
-            cmd[0] = ERASE_64K_CMD;
-            size -= MEM_SECTOR_SIZE;
-            address += MEM_SECTOR_SIZE;
-        }
-        else if ((size >= MEM_PAGE_SIZE) && (address % MEM_PAGE_SIZE == 0))
-        {
-            cmd[0] = ERASE_4K_CMD;
-            size -= MEM_PAGE_SIZE;
-            address += MEM_PAGE_SIZE;
-        }
+    /* Always enable write before write/erase operation */
+    err_code = write_enable();
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
 
-        err_code = write_enable();
-        if (err_code != NRF_SUCCESS)
-        {
-            break;
-        }
+    header_len = set_cmd_address(data_bytes, m_dev->info.program_cmd, address);
+    memcpy(&data_bytes[header_len], data, len);
+    /* Command, address and data at the data frequency */
+    err_code = spi_transfer_phase(SPI_PHASE_DATA, data_bytes, len + header_len, dummy, len + header_len);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
 
-        err_code = spi_transfer(cmd, 4, temp, 4);
-        if (err_code != 0)
-        {
-            break;
-        }
+    /* Write completion (LSB of status register to '0') is waited for before the next command */
+    m_dev->busy = true;
+    m_dev->poll_period_us = m_dev->info.program_time_us / EXT_MEM_PROGRAM_NBR_POLLS;
+    m_dev->busy_erase = false;
+    m_dev->busy_start_us = spi_time_us();
+    m_write_stats.bytes_programmed += len;
 
-        err_code = wait_write_complete();
-        if (err_code != 0)
-        {
-            break;
-        }
+    if (!m_write_verify)
+    {
+        return NRF_SUCCESS;
+    }
+
+    /* The read waits for the end of the program */
+    header_len = set_cmd_address(data_bytes, m_dev->info.read_cmd, address);
+    memset(&data_bytes[header_len], 0, len);
+    err_code = spi_transfer_phase(SPI_PHASE_DATA, data_bytes, len + header_len, dummy, len + header_len);
+    if ((err_code == NRF_SUCCESS) && (memcmp(&dummy[header_len], data, len) != 0))
+    {
+        m_write_stats.verify_failures++;
+        err_code = EXT_MEM_ERROR_PROGRAM_FAILED;
     }
 
     return err_code;
@@ -199,18 +1262,18 @@ ret_code_t memory_erase(uint32_t address, uint32_t size)
 ret_code_t memory_access(uint8_t access_type, uint32_t address, uint8_t *data, uint32_t len)
 {
     ret_code_t err_code = NRF_SUCCESS;
-    /* Allocate extra 4 bytes for command and address */
-    uint8_t data_bytes[MAX_PROGRAM_LEN + 4] = { 0 };
-    /* Allocate extra 4 bytes for command and address */
-    uint8_t dummy[MAX_PROGRAM_LEN + 4] = { 0 };
-    size_t data_len, total_len, remaining_len;
+    /* Allocate extra bytes for command and address */
+    uint8_t data_bytes[MAX_PROGRAM_LEN + CMD_HEADER_MAX_LEN] = { 0 };
+    /* Allocate extra bytes for command and address */
+    uint8_t dummy[MAX_PROGRAM_LEN + CMD_HEADER_MAX_LEN] = { 0 };
+    size_t data_len, total_len, remaining_len, header_len;
 
     if (!data)
     {
         return NRF_ERROR_INVALID_PARAM;
     }
 
-    if ((address + len) > MEMORY_SIZE)
+    if ((address + len) > m_dev->info.size)
     {
         /* Data size exceeds limit */
         return NRF_ERROR_DATA_SIZE;
@@ -218,11 +1281,16 @@ ret_code_t memory_access(uint8_t access_type, uint32_t address, uint8_t *data, u
 
     total_len = 0;
 
-    /* Write data as a set of MAX_PROGRAM_LEN number of bytes in a single write command */
+    if ((access_type == MEM_ACCESS_WRITE) && (len > 0))
+    {
+        erased_map_update(address, len, false);
+    }
+
+    /* Write data as a set of page size number of bytes in a single write command */
     while ((total_len < len) && (err_code == NRF_SUCCESS))
     {
         /* Copy data only till the end of the current page */
-        data_len = MAX_PROGRAM_LEN - (address & MAX_PROG_LEN_MASK);
+        data_len = m_dev->info.page_size - (address & (m_dev->info.page_size - 1));
         remaining_len = len - total_len;
 
         if (remaining_len < data_len)
@@ -233,65 +1301,210 @@ ret_code_t memory_access(uint8_t access_type, uint32_t address, uint8_t *data, u
 
         if (access_type == MEM_ACCESS_WRITE)
         {
-            data_bytes[0] = PAGE_PROGRAM_CMD;
+            err_code = program_page(address, data + total_len, data_len, data_bytes, dummy);
         }
         else
         {
-            data_bytes[0] = READ_DATA_CMD;
+            header_len = set_cmd_address(data_bytes, m_dev->info.read_cmd, address);
+            memset(&data_bytes[header_len], 0, data_len);
+            /* Command, address and data at the data frequency */
+            err_code = spi_transfer_phase(SPI_PHASE_DATA, data_bytes, data_len + header_len, dummy, data_len + header_len);
+            if (err_code == NRF_SUCCESS)
+            {
+                /* Copy the read data to the output buffer */
+                memcpy(data + total_len, dummy + header_len, data_len);
+            }
         }
-        data_bytes[1] = (address >> 16) & 0xFF;
-        data_bytes[2] = (address >> 8) & 0xFF;
-        data_bytes[3] = (address & 0xFF);
 
-        if (access_type == MEM_ACCESS_WRITE)
+        if (err_code == NRF_SUCCESS)
         {
-            memcpy(&data_bytes[4], data + total_len, data_len);
+            total_len += data_len;
+            address += data_len;
         }
-        else
+    }
+
+    return err_code;
+}
+
+/**@brief Check if a buffer contains only 0xFF, comparing a word at a time
+ *
+ * @param[in]  data Word aligned buffer
+ * @param[in]  len Number of bytes in the buffer
+ */
+static bool buffer_is_blank(const uint32_t *data, uint32_t len)
+{
+    const uint8_t *tail;
+    uint32_t nbr_words = len / sizeof(uint32_t);
+
+    /* Compare eight words per iteration, exit on the first programmed word */
+    while (nbr_words >= 8)
+    {
+        if ((data[0] & data[1] & data[2] & data[3] & data[4] & data[5] & data[6] & data[7]) != 0xFFFFFFFF)
         {
-            memset(&data_bytes[4], 0, data_len);
+            return false;
         }
+        data += 8;
+        nbr_words -= 8;
+    }
 
-        if (access_type == MEM_ACCESS_WRITE)
+    while (nbr_words > 0)
+    {
+        if (*data++ != 0xFFFFFFFF)
         {
-            /* Always enable write before write/erase operation */
-            err_code = write_enable();
+            return false;
         }
+        nbr_words--;
+    }
 
-        if (err_code == NRF_SUCCESS)
+    tail = (const uint8_t*) data;
+    for (len %= sizeof(uint32_t); len > 0; len--)
+    {
+        if (*tail++ != 0xFF)
         {
-            err_code = spi_transfer(data_bytes, data_len + 4, dummy, data_len + 4);
+            return false;
         }
+    }
 
-        if (err_code == NRF_SUCCESS)
+    return true;
+}
+
+bool memory_is_blank(uint32_t address, uint32_t len)
+{
+    ret_code_t err_code;
+    uint8_t cmd[CMD_HEADER_MAX_LEN];
+    size_t cmd_len;
+    uint32_t chunk_len[BLANK_CHECK_NBR_BUFFERS];
+    uint32_t index = 0;
+    uint32_t next_index;
+    bool is_blank = true;
+
+    if ((address + len) > m_dev->info.size)
+    {
+        return false;
+    }
+
+    if (len == 0)
+    {
+        return true;
+    }
+
+    cmd_len = set_cmd_address(cmd, m_dev->info.read_cmd, address);
+
+    err_code = device_access();
+    if (err_code != NRF_SUCCESS)
+    {
+        return false;
+    }
+
+    /* Keep the chip selected: one read command streams the whole region */
+    spi_select(m_dev->cs_pin);
+    spi_set_phase(SPI_PHASE_DATA);
+    spi_cs_hold(true);
+
+    err_code = spi_txrx(cmd, cmd_len, NULL, 0);
+    if (err_code == NRF_SUCCESS)
+    {
+        chunk_len[index] = (len < BLANK_CHECK_BUFFER_LEN) ? len : BLANK_CHECK_BUFFER_LEN;
+        len -= chunk_len[index];
+        err_code = spi_txrx_start(NULL, 0, (uint8_t*) m_blank_check_buffer[index], chunk_len[index]);
+    }
+
+    while (err_code == NRF_SUCCESS)
+    {
+        err_code = spi_txrx_wait();
+        if (err_code != NRF_SUCCESS)
         {
-            if (access_type == MEM_ACCESS_WRITE)
-            {
-                /* Wait for write completion (LSB of status register to '0') */
-                err_code = wait_write_complete();
-            }
-            else
+            break;
+        }
+
+        /* Receive the next buffer while the current one is checked */
+        next_index = (index + 1) % BLANK_CHECK_NBR_BUFFERS;
+        chunk_len[next_index] = (len < BLANK_CHECK_BUFFER_LEN) ? len : BLANK_CHECK_BUFFER_LEN;
+        len -= chunk_len[next_index];
+        if (chunk_len[next_index] > 0)
+        {
+            err_code = spi_txrx_start(NULL, 0, (uint8_t*) m_blank_check_buffer[next_index], chunk_len[next_index]);
+        }
+
+        if (!buffer_is_blank(m_blank_check_buffer[index], chunk_len[index]))
+        {
+            is_blank = false;
+            if ((chunk_len[next_index] > 0) && (err_code == NRF_SUCCESS))
             {
-                /* Copy the read data to the output buffer */
-                memcpy(data + total_len, dummy + 4, data_len);
+                spi_txrx_wait();
             }
+            break;
         }
 
-        if (err_code == NRF_SUCCESS)
+        if (chunk_len[next_index] == 0)
         {
-            total_len += data_len;
-            address += data_len;
+            break;
         }
+        index = next_index;
     }
 
-    return err_code;
+    spi_cs_hold(false);
+
+    return is_blank && (err_code == NRF_SUCCESS);
 }
 
 ret_code_t memory_write(uint32_t address, uint8_t *data, uint32_t len)
 {
+    m_write_stats.bytes_requested += len;
     return memory_access(MEM_ACCESS_WRITE, address, data, len);
 }
 
+ret_code_t memory_write_if_changed(uint32_t address, uint8_t *data, uint32_t len)
+{
+    ret_code_t err_code = NRF_SUCCESS;
+    uint8_t current[MAX_PROGRAM_LEN];
+    uint32_t chunk_len;
+    uint32_t first;
+    uint32_t last;
+    uint32_t i;
+
+    m_write_stats.bytes_requested += len;
+    while ((len > 0) && (err_code == NRF_SUCCESS))
+    {
+        chunk_len = (len < sizeof(current)) ? len : sizeof(current);
+        err_code = memory_access(MEM_ACCESS_READ, address, current, chunk_len);
+
+        first = chunk_len;
+        last = 0;
+        for (i = 0; (i < chunk_len) && (err_code == NRF_SUCCESS); i++)
+        {
+            if ((current[i] & data[i]) != data[i])
+            {
+                /* Only an erase sets a bit back to 1 */
+                err_code = EXT_MEM_ERROR_PROGRAM_FAILED;
+            }
+            else if (current[i] != data[i])
+            {
+                first = (i < first) ? i : first;
+                last = i;
+            }
+        }
+
+        if (err_code == NRF_SUCCESS)
+        {
+            if (first < chunk_len)
+            {
+                err_code = memory_access(MEM_ACCESS_WRITE, address + first, data + first, last - first + 1);
+            }
+            else
+            {
+                m_write_stats.programs_skipped++;
+            }
+        }
+
+        address += chunk_len;
+        data += chunk_len;
+        len -= chunk_len;
+    }
+
+    return err_code;
+}
+
 ret_code_t memory_read(uint32_t address, uint8_t *data, uint32_t len)
 {
     return memory_access(MEM_ACCESS_READ, address, data, len);
@@ -301,7 +1514,7 @@ void memory_erase_chip(void)
 {
     uint64_t mem_key = MEM_INIT_KEY;
 
-    memory_erase(0x0, MEMORY_SIZE);
+    memory_erase(0x0, m_dev->info.size);
     /* Write memory key after formatting */
     memory_write(0x0, (uint8_t*) &mem_key, sizeof(mem_key));
 }
@@ -319,23 +1532,59 @@ uint32_t memory_erase_sector(uint32_t start_address)
 void ext_mem_init(void)
 {
     uint64_t mem_key;
+    uint32_t start_us;
+    bool reset_done;
+    uint8_t i;
 
     spi_init();
-    nrf_gpio_cfg_output(SPI_nCS_PIN);
+    start_us = spi_time_us();
     nrf_gpio_cfg_output(SPI_nWP_PIN);
     nrf_gpio_cfg_output(SPI_nHOLD_PIN);
 
-    nrf_gpio_pin_set(SPI_nCS_PIN);
     nrf_gpio_pin_set(SPI_nWP_PIN);
     nrf_gpio_pin_set(SPI_nHOLD_PIN);
 
-    /* Release from deep power down mode */
-    release_ext_mem_deep_power_down();
-    /* Perform software reset */
-    ext_mem_soft_reset();
+    for (i = 0; i < EXT_MEM_NBR_DEVICES; i++)
+    {
+        m_devices[i].cs_pin = m_cs_pins[i];
+        m_devices[i].info = m_default_mem_info;
+        m_devices[i].erase_timing = m_default_erase_timing;
+        m_devices[i].busy = false;
+        m_devices[i].poll_period_us = EXT_MEM_ERASE_POLL_PERIOD_US;
+        m_devices[i].asleep = false;
+        m_devices[i].state_ms = get_systick_timer();
+
+        nrf_gpio_cfg_output(m_devices[i].cs_pin);
+        nrf_gpio_pin_set(m_devices[i].cs_pin);
+    }
+
+    for (i = 0; i < EXT_MEM_NBR_DEVICES; i++)
+    {
+        m_dev = &m_devices[i];
+
+        /* Release from deep power down mode and reset, the state of the memory
+         * is unknown after a reset of the MCU */
+        if (wake_device(false, &reset_done) != NRF_SUCCESS)
+        {
+            NRF_LOG_WARNING("Memory %d does not answer after reset", i);
+        }
+    }
+    m_boot_time.wake_us = spi_time_us() - start_us;
+
+    for (i = 0; i < EXT_MEM_NBR_DEVICES; i++)
+    {
+        m_dev = &m_devices[i];
+        /* Read the memory parameters */
+        ext_mem_detect();
+    }
+    m_boot_time.detect_us = spi_time_us() - start_us;
+
+    /* The init key is kept in the first device only */
+    m_dev = &m_devices[0];
 
     /* Read first 8 bytes of memory */
     memory_read(0x0, (uint8_t*) &mem_key, sizeof(mem_key));
+    m_boot_time.first_read_us = spi_time_us() - start_us;
     if (mem_key == 0xFFFFFFFFFFFFFFFF)
     {
         /* Chip is formatted, update memory init key */
@@ -348,10 +1597,25 @@ void ext_mem_init(void)
     {
         NRF_LOG_INFO("Formatting external memory chip");
         NRF_LOG_FLUSH();
+        /* Format the other devices, their erases run while the first one is formatted */
+        for (i = 1; i < EXT_MEM_NBR_DEVICES; i++)
+        {
+            m_dev = &m_devices[i];
+            memory_erase(0x0, m_dev->info.size);
+        }
         /* Format memory */
+        m_dev = &m_devices[0];
         memory_erase_chip();
     }
 
+    for (i = 0; i < EXT_MEM_NBR_DEVICES; i++)
+    {
+        m_dev = &m_devices[i];
+        wait_device_ready();
+    }
+    m_dev = &m_devices[0];
+    m_init_done = true;
+
     NRF_LOG_INFO("External memory Initiated");
 }
 
@@ -0,0 +1,164 @@
+#if defined(__unix) || defined(__linux__)
+
+#include <stdio.h>
+#include <string.h>
+
+#include "nrf_error.h"
+#include "flash_backend.h"
+
+/** Flash image file, created erased when it does not exist */
+#ifndef FLASH_FILE_BACKEND_PATH
+#define FLASH_FILE_BACKEND_PATH     "flash.img"
+#endif
+
+/** Size of the flash image */
+#ifndef FLASH_FILE_BACKEND_SIZE
+#define FLASH_FILE_BACKEND_SIZE     (0x100000)
+#endif
+
+#define FLASH_FILE_PAGE_SIZE        256
+#define FLASH_FILE_ERASE_SIZE       (0x1000)
+
+static FILE *m_file;
+
+static uint32_t file_init(void)
+{
+    uint8_t erased[FLASH_FILE_ERASE_SIZE];
+    long file_len;
+    uint32_t i;
+
+    if (m_file != NULL)
+    {
+        fclose(m_file);
+    }
+
+    m_file = fopen(FLASH_FILE_BACKEND_PATH, "r+b");
+    if (m_file == NULL)
+    {
+        m_file = fopen(FLASH_FILE_BACKEND_PATH, "w+b");
+    }
+    if (m_file == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    /* Extend the image with erased pages */
+    fseek(m_file, 0, SEEK_END);
+    file_len = ftell(m_file);
+    memset(erased, 0xFF, sizeof(erased));
+    for (i = (uint32_t) file_len; i < FLASH_FILE_BACKEND_SIZE; i += sizeof(erased))
+    {
+        if (fwrite(erased, 1, SFS_SMALL(sizeof(erased), FLASH_FILE_BACKEND_SIZE - i), m_file) == 0)
+        {
+            return NRF_ERROR_INTERNAL;
+        }
+    }
+    fflush(m_file);
+
+    return NRF_SUCCESS;
+}
+
+static void file_get_caps(flash_backend_caps_t *caps)
+{
+    caps->size = FLASH_FILE_BACKEND_SIZE;
+    caps->page_size = FLASH_FILE_PAGE_SIZE;
+    caps->erase_size = FLASH_FILE_ERASE_SIZE;
+    caps->erase_sizes = FLASH_FILE_ERASE_SIZE;
+    caps->erase_time_ms = 0;
+    caps->program_time_us = 0;
+    caps->word_writes = 0;
+}
+
+static uint32_t file_read(uint32_t address, uint8_t *data, uint32_t len)
+{
+    if ((address + len) > FLASH_FILE_BACKEND_SIZE)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    if ((m_file == NULL) || (fseek(m_file, address, SEEK_SET) != 0) || (fread(data, 1, len, m_file) != len))
+    {
+        return NRF_ERROR_INTERNAL;
+    }
+
+    return NRF_SUCCESS;
+}
+
+/** Programming clears bits only, like a NOR flash: the image is read, ANDed and written back */
+static uint32_t file_write(uint32_t address, uint8_t *data, uint32_t len)
+{
+    uint8_t buffer[FLASH_FILE_PAGE_SIZE];
+    uint32_t data_len;
+    uint32_t i;
+
+    while (len > 0)
+    {
+        data_len = SFS_SMALL(len, sizeof(buffer));
+
+        if (file_read(address, buffer, data_len) != NRF_SUCCESS)
+        {
+            return NRF_ERROR_INTERNAL;
+        }
+
+        for (i = 0; i < data_len; i++)
+        {
+            buffer[i] &= data[i];
+        }
+
+        if ((fseek(m_file, address, SEEK_SET) != 0) || (fwrite(buffer, 1, data_len, m_file) != data_len))
+        {
+            return NRF_ERROR_INTERNAL;
+        }
+
+        address += data_len;
+        data += data_len;
+        len -= data_len;
+    }
+
+    fflush(m_file);
+    return NRF_SUCCESS;
+}
+
+static uint32_t file_erase(uint32_t address, uint32_t size)
+{
+    uint8_t erased[FLASH_FILE_ERASE_SIZE];
+
+    if (((address % FLASH_FILE_ERASE_SIZE) != 0) || ((size % FLASH_FILE_ERASE_SIZE) != 0))
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    if ((address + size) > FLASH_FILE_BACKEND_SIZE)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    if ((m_file == NULL) || (fseek(m_file, address, SEEK_SET) != 0))
+    {
+        return NRF_ERROR_INTERNAL;
+    }
+
+    memset(erased, 0xFF, sizeof(erased));
+    for (; size > 0; size -= sizeof(erased))
+    {
+        if (fwrite(erased, 1, sizeof(erased), m_file) != sizeof(erased))
+        {
+            return NRF_ERROR_INTERNAL;
+        }
+    }
+
+    fflush(m_file);
+    return NRF_SUCCESS;
+}
+
+const flash_backend_t flash_backend_file = {
+    .name = "file",
+    .init = file_init,
+    .get_caps = file_get_caps,
+    .write = file_write,
+    .read = file_read,
+    .erase = file_erase,
+    .map = NULL
+};
+
+#endif // __unix
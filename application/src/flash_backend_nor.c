@@ -0,0 +1,44 @@
+#include "app_error.h"
+#include "ext_mem_driver.h"
+#include "mem_array.h"
+#include "flash_backend.h"
+
+static uint32_t nor_init(void)
+{
+    ext_mem_init();
+    return mem_array_init(MEM_ARRAY_MODE, MEM_ARRAY_STRIPE_LEN);
+}
+
+static void nor_get_caps(flash_backend_caps_t *caps)
+{
+    uint8_t selected = ext_mem_selected_device();
+    const ext_mem_info_t *info;
+    ext_mem_erase_timing_t timing;
+
+    /* The devices of the array are expected to be of the same type, the first one is reported */
+    ext_mem_select_device(0);
+    info = ext_mem_get_info();
+    memory_get_erase_timing(&timing);
+
+    caps->size = mem_array_size();
+    caps->page_size = info->page_size;
+    caps->erase_size = MEM_PAGE_SIZE;
+    caps->erase_sizes = (info->erase_4k_cmd ? MEM_PAGE_SIZE : 0) | (info->erase_32k_cmd ? MEM_HALF_SECTOR_SIZE : 0)
+            | (info->erase_64k_cmd ? MEM_SECTOR_SIZE : 0);
+    caps->erase_time_ms = timing.erase_4k_ms;
+    caps->program_time_us = info->program_time_us;
+    caps->word_writes = 0;
+
+    ext_mem_select_device(selected);
+}
+
+const flash_backend_t flash_backend_nor = {
+    .name = "nor",
+    .init = nor_init,
+    .get_caps = nor_get_caps,
+    .write = mem_array_write,
+    .update = mem_array_write_if_changed,
+    .read = mem_array_read,
+    .erase = mem_array_erase,
+    .map = NULL
+};
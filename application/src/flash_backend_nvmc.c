@@ -0,0 +1,213 @@
+#include <string.h>
+
+#include "nrfx_nvmc.h"
+#include "app_error.h"
+#include "flash_backend.h"
+
+/** Internal flash region used as storage, it must be kept free of code */
+#ifndef FLASH_NVMC_START_ADDRESS
+#define FLASH_NVMC_START_ADDRESS    (0xE0000)
+#endif
+
+#ifndef FLASH_NVMC_SIZE
+#define FLASH_NVMC_SIZE             (0x10000)
+#endif
+
+/** nRF52840 typical page erase time and word write time */
+#define FLASH_NVMC_ERASE_TIME_MS    85
+#define FLASH_NVMC_WORD_TIME_US     41
+
+/** A word can be written twice only between erases (nWRITE) */
+#define FLASH_NVMC_WORD_WRITES      2
+
+#define FLASH_NVMC_NBR_WORDS        (FLASH_NVMC_SIZE / sizeof(uint32_t))
+
+/** Writes of each word since its erase, 2 bits per word */
+static uint8_t m_word_writes[FLASH_NVMC_NBR_WORDS / 4];
+
+static uint32_t word_writes_get(uint32_t word)
+{
+    return (m_word_writes[word / 4] >> ((word % 4) * 2)) & 0x03;
+}
+
+static void word_writes_set(uint32_t word, uint32_t writes)
+{
+    m_word_writes[word / 4] &= ~(0x03 << ((word % 4) * 2));
+    m_word_writes[word / 4] |= (writes << ((word % 4) * 2));
+}
+
+void flash_backend_invalidate_cache(void)
+{
+#if defined(NVMC_ICACHECNF_CACHEEN_Msk)
+    /** Disabling the cache drops its content */
+    if (nrf_nvmc_icache_enable_check(NRF_NVMC))
+    {
+        nrf_nvmc_icache_config_set(NRF_NVMC, NRF_NVMC_ICACHE_DISABLE);
+        nrf_nvmc_icache_config_set(NRF_NVMC, NRF_NVMC_ICACHE_ENABLE);
+    }
+#endif
+    __DSB();
+    __ISB();
+}
+
+static uint32_t nvmc_init(void)
+{
+    if (((FLASH_NVMC_START_ADDRESS % nrfx_nvmc_flash_page_size_get()) != 0)
+            || ((FLASH_NVMC_START_ADDRESS + FLASH_NVMC_SIZE) > nrfx_nvmc_flash_size_get()))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    /** The writes done before the reset are unknown, a programmed word takes its last one */
+    for (uint32_t word = 0; word < FLASH_NVMC_NBR_WORDS; word++)
+    {
+        uint32_t value = *(const uint32_t*) (FLASH_NVMC_START_ADDRESS + word * sizeof(uint32_t));
+        word_writes_set(word, (value == 0xFFFFFFFF) ? 0 : FLASH_NVMC_WORD_WRITES);
+    }
+
+    return NRF_SUCCESS;
+}
+
+static void nvmc_get_caps(flash_backend_caps_t *caps)
+{
+    caps->size = FLASH_NVMC_SIZE;
+    caps->page_size = nrfx_nvmc_flash_page_size_get();
+    caps->erase_size = nrfx_nvmc_flash_page_size_get();
+    caps->erase_sizes = nrfx_nvmc_flash_page_size_get();
+    caps->erase_time_ms = FLASH_NVMC_ERASE_TIME_MS;
+    caps->program_time_us = (caps->page_size / sizeof(uint32_t)) * FLASH_NVMC_WORD_TIME_US;
+    caps->word_writes = FLASH_NVMC_WORD_WRITES;
+}
+
+/**@brief Value of the word at word_address once the bytes of data in it are programmed */
+static uint32_t word_value_get(uint32_t word_address, uint32_t address, const uint8_t *data, uint32_t len)
+{
+    uint32_t value = *(const uint32_t*) (FLASH_NVMC_START_ADDRESS + word_address);
+    uint8_t *bytes = (uint8_t*) &value;
+
+    for (uint32_t i = 0; i < sizeof(uint32_t); i++)
+    {
+        if (((word_address + i) >= address) && ((word_address + i) < (address + len)))
+        {
+            /** Programming only clears bits */
+            bytes[i] &= data[word_address + i - address];
+        }
+    }
+    return value;
+}
+
+/** A word can be written twice only between erases (nWRITE). The words left unchanged
+ *  are not written, a write needing a third write of a word is refused as a whole.
+ */
+static uint32_t nvmc_write(uint32_t address, uint8_t *data, uint32_t len)
+{
+    uint32_t first_word;
+    uint32_t end_word;
+
+    if ((address + len) > FLASH_NVMC_SIZE)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+    if (len == 0)
+    {
+        return NRF_SUCCESS;
+    }
+
+    first_word = address / sizeof(uint32_t);
+    end_word = (address + len + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    for (uint32_t word = first_word; word < end_word; word++)
+    {
+        uint32_t word_address = word * sizeof(uint32_t);
+        uint32_t value = word_value_get(word_address, address, data, len);
+
+        if ((value != *(const uint32_t*) (FLASH_NVMC_START_ADDRESS + word_address))
+                && (word_writes_get(word) >= FLASH_NVMC_WORD_WRITES))
+        {
+            return NRF_ERROR_FORBIDDEN;
+        }
+    }
+
+    for (uint32_t word = first_word; word < end_word; word++)
+    {
+        uint32_t word_address = word * sizeof(uint32_t);
+        uint32_t value = word_value_get(word_address, address, data, len);
+
+        if (value != *(const uint32_t*) (FLASH_NVMC_START_ADDRESS + word_address))
+        {
+            nrfx_nvmc_word_write(FLASH_NVMC_START_ADDRESS + word_address, value);
+            while (!nrfx_nvmc_write_done_check())
+            {
+            }
+            word_writes_set(word, word_writes_get(word) + 1);
+        }
+    }
+    flash_backend_invalidate_cache();
+
+    return NRF_SUCCESS;
+}
+
+static uint32_t nvmc_read(uint32_t address, uint8_t *data, uint32_t len)
+{
+    if ((address + len) > FLASH_NVMC_SIZE)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    /* Internal flash is memory mapped */
+    memcpy(data, (const uint8_t*) (FLASH_NVMC_START_ADDRESS + address), len);
+    return NRF_SUCCESS;
+}
+
+static uint32_t nvmc_erase(uint32_t address, uint32_t size)
+{
+    uint32_t page_size = nrfx_nvmc_flash_page_size_get();
+    uint32_t err_code = NRF_SUCCESS;
+
+    if (((address % page_size) != 0) || ((size % page_size) != 0))
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    if ((address + size) > FLASH_NVMC_SIZE)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    for (; (size > 0) && (err_code == NRF_SUCCESS); size -= page_size, address += page_size)
+    {
+        err_code = nrfx_nvmc_page_erase(FLASH_NVMC_START_ADDRESS + address);
+        if (err_code == NRF_SUCCESS)
+        {
+            for (uint32_t word = address / sizeof(uint32_t); word < (address + page_size) / sizeof(uint32_t); word++)
+            {
+                word_writes_set(word, 0);
+            }
+        }
+    }
+    flash_backend_invalidate_cache();
+
+    return err_code;
+}
+
+/** Internal flash is read in place, no copy is needed */
+static uint32_t nvmc_map(uint32_t address, const uint8_t **data)
+{
+    if (address >= FLASH_NVMC_SIZE)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    *data = (const uint8_t*) (FLASH_NVMC_START_ADDRESS + address);
+    return NRF_SUCCESS;
+}
+
+const flash_backend_t flash_backend_nvmc = {
+    .name = "nvmc",
+    .init = nvmc_init,
+    .get_caps = nvmc_get_caps,
+    .write = nvmc_write,
+    .read = nvmc_read,
+    .erase = nvmc_erase,
+    .map = nvmc_map
+};
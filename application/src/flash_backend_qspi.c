@@ -0,0 +1,188 @@
+#include <string.h>
+
+#include "boards.h"
+#include "nrfx_qspi.h"
+#include "app_error.h"
+#include "flash_backend.h"
+
+/** Start of the XIP region of the QSPI memory */
+#define FLASH_QSPI_XIP_ADDRESS      (0x12000000)
+/** The XIP region is 128 MB, the 24 bit addressing limits it to 16 MB */
+#define FLASH_QSPI_MAX_SIZE         (0x1000000)
+#define FLASH_QSPI_PAGE_SIZE        256
+#define FLASH_QSPI_ERASE_SIZE       (0x1000)
+#define FLASH_QSPI_BLOCK_SIZE       (0x10000)
+
+#define FLASH_QSPI_READ_ID          0x9F
+#define FLASH_QSPI_RSTEN            0x66
+#define FLASH_QSPI_RST              0x99
+
+/** Typical erase and page program time of a MX25R6435F */
+#define FLASH_QSPI_ERASE_TIME_MS    40
+#define FLASH_QSPI_PROGRAM_TIME_US  850
+
+static uint32_t m_size;
+/** EasyDMA needs a word aligned buffer in RAM with a length multiple of 4 */
+static uint32_t m_page_buffer[FLASH_QSPI_PAGE_SIZE / sizeof(uint32_t)];
+
+/**@brief Wait for the end of a program or an erase, the XIP region reads the
+ *        status instead of the data while the memory is busy
+ */
+static void qspi_wait_ready(void)
+{
+    while (nrfx_qspi_mem_busy_check() == NRFX_ERROR_BUSY)
+    {
+    }
+}
+
+static uint32_t qspi_init(void)
+{
+    nrfx_qspi_config_t config = NRFX_QSPI_DEFAULT_CONFIG;
+    nrf_qspi_cinstr_conf_t cinstr = { .length = NRF_QSPI_CINSTR_LEN_1B, .io2_level = true, .io3_level = true };
+    uint8_t jedec_id[3];
+    uint32_t err_code;
+
+    err_code = nrfx_qspi_init(&config, NULL, NULL);
+    if (err_code != NRFX_SUCCESS)
+    {
+        return err_code;
+    }
+
+    /** Soft reset, the memory may have been left in an unknown state */
+    cinstr.opcode = FLASH_QSPI_RSTEN;
+    nrfx_qspi_cinstr_xfer(&cinstr, NULL, NULL);
+    cinstr.opcode = FLASH_QSPI_RST;
+    nrfx_qspi_cinstr_xfer(&cinstr, NULL, NULL);
+
+    cinstr.opcode = FLASH_QSPI_READ_ID;
+    cinstr.length = NRF_QSPI_CINSTR_LEN_4B;
+    cinstr.wipwait = true;
+    err_code = nrfx_qspi_cinstr_xfer(&cinstr, NULL, jedec_id);
+    if (err_code != NRFX_SUCCESS)
+    {
+        return err_code;
+    }
+
+    /** The third ID byte is the capacity as a power of two */
+    if ((jedec_id[2] < 16) || (jedec_id[2] > 31))
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    m_size = SFS_SMALL(1UL << jedec_id[2], FLASH_QSPI_MAX_SIZE);
+
+    return NRF_SUCCESS;
+}
+
+static void qspi_get_caps(flash_backend_caps_t *caps)
+{
+    caps->size = m_size;
+    caps->page_size = FLASH_QSPI_PAGE_SIZE;
+    caps->erase_size = FLASH_QSPI_ERASE_SIZE;
+    caps->erase_sizes = FLASH_QSPI_ERASE_SIZE | FLASH_QSPI_BLOCK_SIZE;
+    caps->erase_time_ms = FLASH_QSPI_ERASE_TIME_MS;
+    caps->program_time_us = FLASH_QSPI_PROGRAM_TIME_US;
+    caps->word_writes = 0;
+}
+
+/** Unaligned heads and tails are padded with 0xFF, programming 1 leaves a bit unchanged */
+static uint32_t qspi_write(uint32_t address, uint8_t *data, uint32_t len)
+{
+    uint32_t page_len;
+    uint32_t head;
+    uint32_t err_code = NRFX_SUCCESS;
+
+    if ((address + len) > m_size)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    while ((len > 0) && (err_code == NRFX_SUCCESS))
+    {
+        head = address % sizeof(uint32_t);
+        /** Do not cross a page boundary */
+        page_len = SFS_SMALL(len, FLASH_QSPI_PAGE_SIZE - (address % FLASH_QSPI_PAGE_SIZE));
+
+        memset(m_page_buffer, 0xFF, sizeof(m_page_buffer));
+        memcpy((uint8_t*) m_page_buffer + head, data, page_len);
+        err_code = nrfx_qspi_write(m_page_buffer, (head + page_len + 3) & ~3UL, address - head);
+
+        address += page_len;
+        data += page_len;
+        len -= page_len;
+    }
+
+    qspi_wait_ready();
+    flash_backend_invalidate_cache();
+
+    return err_code;
+}
+
+/** Reads go through the XIP region, it needs no alignment */
+static uint32_t qspi_read(uint32_t address, uint8_t *data, uint32_t len)
+{
+    if ((address + len) > m_size)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    memcpy(data, (const uint8_t*) (FLASH_QSPI_XIP_ADDRESS + address), len);
+    return NRF_SUCCESS;
+}
+
+static uint32_t qspi_erase(uint32_t address, uint32_t size)
+{
+    uint32_t err_code = NRFX_SUCCESS;
+
+    if (((address % FLASH_QSPI_ERASE_SIZE) != 0) || ((size % FLASH_QSPI_ERASE_SIZE) != 0))
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    if ((address + size) > m_size)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    while ((size > 0) && (err_code == NRFX_SUCCESS))
+    {
+        /** The driver waits for the previous erase before starting the next one */
+        if (((address % FLASH_QSPI_BLOCK_SIZE) == 0) && (size >= FLASH_QSPI_BLOCK_SIZE))
+        {
+            err_code = nrfx_qspi_erase(NRF_QSPI_ERASE_LEN_64KB, address);
+            address += FLASH_QSPI_BLOCK_SIZE;
+            size -= FLASH_QSPI_BLOCK_SIZE;
+        }
+        else
+        {
+            err_code = nrfx_qspi_erase(NRF_QSPI_ERASE_LEN_4KB, address);
+            address += FLASH_QSPI_ERASE_SIZE;
+            size -= FLASH_QSPI_ERASE_SIZE;
+        }
+    }
+
+    qspi_wait_ready();
+    flash_backend_invalidate_cache();
+
+    return err_code;
+}
+
+static uint32_t qspi_map(uint32_t address, const uint8_t **data)
+{
+    if (address >= m_size)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    *data = (const uint8_t*) (FLASH_QSPI_XIP_ADDRESS + address);
+    return NRF_SUCCESS;
+}
+
+const flash_backend_t flash_backend_qspi = {
+    .name = "qspi",
+    .init = qspi_init,
+    .get_caps = qspi_get_caps,
+    .write = qspi_write,
+    .read = qspi_read,
+    .erase = qspi_erase,
+    .map = qspi_map
+};
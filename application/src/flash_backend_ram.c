@@ -0,0 +1,165 @@
+#include <string.h>
+
+#include "nrf_error.h"
+#include "flash_backend.h"
+
+/** Size of the simulated memory, it holds the storage layout of storage_mngr */
+#ifndef FLASH_RAM_BACKEND_SIZE
+#define FLASH_RAM_BACKEND_SIZE      (0x100000)
+#endif
+
+#define FLASH_RAM_PAGE_SIZE         256
+#define FLASH_RAM_ERASE_SIZE        (0x1000)
+
+/** Writes of a 32 bit word allowed between erases, 0 when they are not limited.
+ *  A limit simulates the internal flash of flash_backend_nvmc.
+ */
+#ifndef FLASH_RAM_WORD_WRITES
+#define FLASH_RAM_WORD_WRITES       0
+#endif
+
+#define FLASH_RAM_NBR_WORDS         (FLASH_RAM_BACKEND_SIZE / sizeof(uint32_t))
+
+static uint8_t m_memory[FLASH_RAM_BACKEND_SIZE];
+#if FLASH_RAM_WORD_WRITES
+/** Writes of each word since its erase */
+static uint8_t m_word_writes[FLASH_RAM_NBR_WORDS];
+#endif
+
+static uint32_t ram_init(void)
+{
+    memset(m_memory, 0xFF, sizeof(m_memory));
+#if FLASH_RAM_WORD_WRITES
+    memset(m_word_writes, 0, sizeof(m_word_writes));
+#endif
+    return NRF_SUCCESS;
+}
+
+static void ram_get_caps(flash_backend_caps_t *caps)
+{
+    caps->size = FLASH_RAM_BACKEND_SIZE;
+    caps->page_size = FLASH_RAM_PAGE_SIZE;
+    caps->erase_size = FLASH_RAM_ERASE_SIZE;
+    caps->erase_sizes = FLASH_RAM_ERASE_SIZE;
+    caps->erase_time_ms = 0;
+    caps->program_time_us = 0;
+    caps->word_writes = FLASH_RAM_WORD_WRITES;
+}
+
+#if FLASH_RAM_WORD_WRITES
+/**@brief Check if a write changes the word at word_address */
+static bool word_changed(uint32_t word_address, uint32_t address, const uint8_t *data, uint32_t len)
+{
+    for (uint32_t i = word_address; i < (word_address + sizeof(uint32_t)); i++)
+    {
+        if ((i >= address) && (i < (address + len)) && ((m_memory[i] & data[i - address]) != m_memory[i]))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**@brief Count the writes of the words changed, as flash_backend_nvmc a write needing
+ *        more writes of a word than allowed is refused as a whole
+ */
+static uint32_t word_writes_count(uint32_t address, const uint8_t *data, uint32_t len)
+{
+    uint32_t first_word = address / sizeof(uint32_t);
+    uint32_t end_word = (address + len + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+    uint32_t word;
+
+    for (word = first_word; word < end_word; word++)
+    {
+        if (word_changed(word * sizeof(uint32_t), address, data, len) && (m_word_writes[word] >= FLASH_RAM_WORD_WRITES))
+        {
+            return NRF_ERROR_FORBIDDEN;
+        }
+    }
+
+    for (word = first_word; word < end_word; word++)
+    {
+        if (word_changed(word * sizeof(uint32_t), address, data, len))
+        {
+            m_word_writes[word]++;
+        }
+    }
+    return NRF_SUCCESS;
+}
+#endif
+
+/** Programming clears bits only, like a NOR flash: a 0 bit stays 0 until the page is erased */
+static uint32_t ram_write(uint32_t address, uint8_t *data, uint32_t len)
+{
+    uint32_t i;
+
+    if ((address + len) > FLASH_RAM_BACKEND_SIZE)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+#if FLASH_RAM_WORD_WRITES
+    if (word_writes_count(address, data, len) != NRF_SUCCESS)
+    {
+        return NRF_ERROR_FORBIDDEN;
+    }
+#endif
+
+    for (i = 0; i < len; i++)
+    {
+        m_memory[address + i] &= data[i];
+    }
+
+    return NRF_SUCCESS;
+}
+
+static uint32_t ram_read(uint32_t address, uint8_t *data, uint32_t len)
+{
+    if ((address + len) > FLASH_RAM_BACKEND_SIZE)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    memcpy(data, &m_memory[address], len);
+    return NRF_SUCCESS;
+}
+
+static uint32_t ram_erase(uint32_t address, uint32_t size)
+{
+    if (((address % FLASH_RAM_ERASE_SIZE) != 0) || ((size % FLASH_RAM_ERASE_SIZE) != 0))
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    if ((address + size) > FLASH_RAM_BACKEND_SIZE)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    memset(&m_memory[address], 0xFF, size);
+#if FLASH_RAM_WORD_WRITES
+    memset(&m_word_writes[address / sizeof(uint32_t)], 0, size / sizeof(uint32_t));
+#endif
+    return NRF_SUCCESS;
+}
+
+static uint32_t ram_map(uint32_t address, const uint8_t **data)
+{
+    if (address >= FLASH_RAM_BACKEND_SIZE)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    *data = &m_memory[address];
+    return NRF_SUCCESS;
+}
+
+const flash_backend_t flash_backend_ram = {
+    .name = "ram",
+    .init = ram_init,
+    .get_caps = ram_get_caps,
+    .write = ram_write,
+    .read = ram_read,
+    .erase = ram_erase,
+    .map = ram_map
+};
@@ -7,6 +7,7 @@
 #include "app_error.h"
 #include "large_file_storage.h"
 #include "ext_mem_driver.h"
+#include "flash_backend.h"
 
 #include "nrf_log.h"
 #include "nrf_log_ctrl.h"
@@ -30,6 +31,32 @@ static meas_store_status_t set_latest_written_file_address(uint32_t address);
 static uint32_t get_latest_written_file_address(void);
 static uint32_t get_meta_address(uint8_t action);
 static uint32_t current_file_address;
+/** Memory the files are stored in */
+static const flash_backend_t *m_backend;
+static flash_backend_caps_t m_caps;
+
+meas_store_status_t large_file_storage_init(const flash_backend_t *backend)
+{
+    flash_backend_caps_t caps;
+
+    backend->get_caps(&caps);
+    if (caps.size < LARGE_FILE_STORAGE_MIN_SIZE)
+    {
+        NRF_LOG_ERROR("%s backend too small for the large files", backend->name);
+        return MEAS_STORE_STATUS_INTERNAL_ERROR;
+    }
+
+    m_backend = backend;
+    m_caps = caps;
+    current_file_address = 0;
+    return MEAS_STORE_STATUS_SUCCESS;
+}
+
+/** End address of the storage, the end of the memory */
+static uint32_t data_end_address(void)
+{
+    return m_caps.size;
+}
 
 static uint32_t get_meta_address(uint8_t action)
 {
@@ -41,7 +68,7 @@ static uint32_t get_meta_address(uint8_t action)
         /** No current file info is stored. Start searching */
         while (address < META_DATA_END_ADDRESS)
         {
-            memory_read(address, &status, sizeof(status));
+            m_backend->read(address, &status, sizeof(status));
             if (status == NEW_META_DATA_SPACE)
             {
                 if (action == SEARCH_FILE)
@@ -81,7 +108,7 @@ static uint32_t get_meta_address(uint8_t action)
         else
         {
             address = META_DATA_START_ADDRESS;
-            memory_erase(address, META_DATA_END_ADDRESS - META_DATA_START_ADDRESS);
+            m_backend->erase(address, META_DATA_END_ADDRESS - META_DATA_START_ADDRESS);
         }
     }
 
@@ -98,13 +125,13 @@ meas_store_status_t set_latest_written_file_address(uint32_t data_address)
     meta_data.status = ACTIVE_META_DATA_SPACE;
     meta_data.last_written_meas_address = data_address;
 
-    memory_write(address, (uint8_t *) &meta_data, sizeof(meta_data));
+    m_backend->write(address, (uint8_t *) &meta_data, sizeof(meta_data));
 
     /** Invalidate old data */
     if (previous_address != 0)
     {
         meta_data.status = INACTIVE_META_DATA_SPACE;
-        memory_write(previous_address, (uint8_t *) &meta_data.status, sizeof(meta_data.status));
+        m_backend->write(previous_address, (uint8_t *) &meta_data.status, sizeof(meta_data.status));
     }
 //NRF_LOG_INFO("meta write address 0x%x meta last_wt_addr 0x%x", address, data_address);
     current_file_address = address;
@@ -119,7 +146,7 @@ uint32_t get_latest_written_file_address(void)
 
     if (address != 0)
     {
-        memory_read(address, (uint8_t *)&meta_data, sizeof(meta_data));
+        m_backend->read(address, (uint8_t *)&meta_data, sizeof(meta_data));
         data_address = meta_data.last_written_meas_address;
     }
 //NRF_LOG_INFO("meta read address 0x%x meta last_wt_addr 0x%x", address, data_address);
@@ -131,20 +158,20 @@ meas_store_status_t write_measurement_in_parts(uint32_t rem_len, uint8_t *data,
     /** Last written address */
     uint32_t address = get_latest_written_file_address();
     /** Total number of files can be stored */
-    uint32_t count = ((DATA_END_ADDRESS - DATA_START_ADDRESS)/FILE_ALLOC_SIZE) + 1;
+    uint32_t count = ((data_end_address() - DATA_START_ADDRESS)/FILE_ALLOC_SIZE) + 1;
     meas_store_status_t status = MEAS_STORE_STATUS_SUCCESS;
     file_header_t file_header;
     uint32_t erase_address;
 
     while (count > 0)
     {
-        if ((address < DATA_START_ADDRESS) || ((address + FILE_ALLOC_SIZE) >= DATA_END_ADDRESS))
+        if ((address < DATA_START_ADDRESS) || ((address + FILE_ALLOC_SIZE) >= data_end_address()))
         {
             address = DATA_START_ADDRESS;
         }
 
         /** Check if there is a partial or new file */
-        if (memory_read(address, (uint8_t *)&file_header, sizeof(file_header)) != 0)
+        if (m_backend->read(address, (uint8_t *)&file_header, sizeof(file_header)) != 0)
         {
             return MEAS_STORE_STATUS_IO_ERROR;
         }
@@ -163,7 +190,7 @@ meas_store_status_t write_measurement_in_parts(uint32_t rem_len, uint8_t *data,
         /** All allocations are occupied, erase the first allocation */
         address = DATA_START_ADDRESS;
         file_header.status = SPACE_FOR_NEW_FILE;
-        if (memory_erase(address, FILE_ALLOC_SIZE) != 0)
+        if (m_backend->erase(address, FILE_ALLOC_SIZE) != 0)
         {
             return MEAS_STORE_STATUS_IO_ERROR;
         }
@@ -177,7 +204,7 @@ meas_store_status_t write_measurement_in_parts(uint32_t rem_len, uint8_t *data,
         set_latest_written_file_address(address);
         file_header.file_len = rem_len;
 
-        if (memory_write(address, (uint8_t *) &file_header, sizeof(file_header)) != 0)
+        if (m_backend->write(address, (uint8_t *) &file_header, sizeof(file_header)) != 0)
         {
             return MEAS_STORE_STATUS_IO_ERROR;
         }
@@ -189,13 +216,13 @@ meas_store_status_t write_measurement_in_parts(uint32_t rem_len, uint8_t *data,
     {
         /** This is the last part of the file, mark the file as completed */
         file_header.status = UNREAD_FILE;
-        if (memory_write(address, (uint8_t *) &file_header.status, sizeof(file_header.status)) != 0)
+        if (m_backend->write(address, (uint8_t *) &file_header.status, sizeof(file_header.status)) != 0)
         {
             return MEAS_STORE_STATUS_IO_ERROR;
         }
         /** Erase memory for next file */
-        erase_address = ((address + (2*FILE_ALLOC_SIZE)) >= DATA_END_ADDRESS) ? DATA_START_ADDRESS : (address + FILE_ALLOC_SIZE);
-        if (memory_erase(erase_address, FILE_ALLOC_SIZE) != 0)
+        erase_address = ((address + (2*FILE_ALLOC_SIZE)) >= data_end_address()) ? DATA_START_ADDRESS : (address + FILE_ALLOC_SIZE);
+        if (m_backend->erase(erase_address, FILE_ALLOC_SIZE) != 0)
         {
             return MEAS_STORE_STATUS_IO_ERROR;
         }
@@ -205,7 +232,7 @@ meas_store_status_t write_measurement_in_parts(uint32_t rem_len, uint8_t *data,
     }
 
     address += ((file_header.file_len - rem_len) + sizeof(file_header));
-    if (memory_write(address, data, data_len) != 0)
+    if (m_backend->write(address, data, data_len) != 0)
     {
         return MEAS_STORE_STATUS_IO_ERROR;
     }
@@ -217,7 +244,7 @@ meas_store_status_t read_measurement_in_parts(uint32_t file_address, uint32_t re
     meas_store_status_t status = MEAS_STORE_STATUS_SUCCESS;
     file_header_t file_header;
 
-    if (memory_read(file_address, (uint8_t *) &file_header, sizeof(file_header)) != 0)
+    if (m_backend->read(file_address, (uint8_t *) &file_header, sizeof(file_header)) != 0)
     {
         return MEAS_STORE_STATUS_IO_ERROR;
     }
@@ -231,7 +258,7 @@ meas_store_status_t read_measurement_in_parts(uint32_t file_address, uint32_t re
     {
         /** This is the last part of the file, mark the file as read */
         file_header.status = READ_FILE;
-        if (memory_write(file_address, (uint8_t *) &file_header.status, sizeof(file_header.status)) != 0)
+        if (m_backend->write(file_address, (uint8_t *) &file_header.status, sizeof(file_header.status)) != 0)
         {
             return MEAS_STORE_STATUS_IO_ERROR;
         }
@@ -239,7 +266,7 @@ meas_store_status_t read_measurement_in_parts(uint32_t file_address, uint32_t re
     }
 
     file_address += ((file_header.file_len - rem_len) + sizeof(file_header));
-    if (memory_read(file_address, data, data_len) != 0)
+    if (m_backend->read(file_address, data, data_len) != 0)
     {
         return MEAS_STORE_STATUS_IO_ERROR;
     }
@@ -249,13 +276,13 @@ meas_store_status_t read_measurement_in_parts(uint32_t file_address, uint32_t re
 uint32_t first_written_file_address(void)
 {
     uint32_t address = get_latest_written_file_address();
-    uint32_t count = ((DATA_END_ADDRESS - DATA_START_ADDRESS)/FILE_ALLOC_SIZE) + 1;
+    uint32_t count = ((data_end_address() - DATA_START_ADDRESS)/FILE_ALLOC_SIZE) + 1;
     uint32_t i;
     uint8_t status;
 
     for (i= 0; i < count; i++)
     {
-        if ((address < DATA_START_ADDRESS) || ((address + FILE_ALLOC_SIZE) >= DATA_END_ADDRESS))
+        if ((address < DATA_START_ADDRESS) || ((address + FILE_ALLOC_SIZE) >= data_end_address()))
         {
             address = DATA_START_ADDRESS;
         }
@@ -264,7 +291,7 @@ uint32_t first_written_file_address(void)
             address += FILE_ALLOC_SIZE;
         }
 
-        if (memory_read(address,  &status, sizeof(status)) != 0)
+        if (m_backend->read(address,  &status, sizeof(status)) != 0)
         {
             return MEAS_STORE_STATUS_IO_ERROR;
         }
@@ -71,6 +71,7 @@ int main(void)
     while (1)
     {
         uart_data_handle();
+        ext_mem_idle_process();
         NRF_LOG_FLUSH();
     }
 }
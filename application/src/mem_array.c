@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+#include "nrf_log_default_backends.h"
+
+#include "app_error.h"
+#include "ext_mem_driver.h"
+#include "mem_array.h"
+
+#define MEM_ARRAY_MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/** A part of an access that is in one device */
+typedef struct
+{
+    uint8_t device;
+    uint32_t address;
+    uint32_t len;
+    uint8_t *data;
+} mem_array_segment_t;
+
+static mem_array_mode_t m_mode = MEM_ARRAY_CONCAT;
+static uint32_t m_stripe_len = MEM_SECTOR_SIZE;
+static uint32_t m_device_size[EXT_MEM_NBR_DEVICES];
+static uint32_t m_size;
+
+/**@brief Find the device and the device address of an array address
+ *
+ * The segment length is set to the bytes till the end of the stripe or the device.
+ */
+static void mem_array_map(uint32_t address, mem_array_segment_t *segment)
+{
+    uint32_t stripe;
+    uint32_t offset;
+    uint8_t device = 0;
+
+    if (m_mode == MEM_ARRAY_STRIPE)
+    {
+        stripe = address / m_stripe_len;
+        offset = address % m_stripe_len;
+        segment->device = stripe % EXT_MEM_NBR_DEVICES;
+        segment->address = (stripe / EXT_MEM_NBR_DEVICES) * m_stripe_len + offset;
+        segment->len = m_stripe_len - offset;
+    }
+    else
+    {
+        while ((device < (EXT_MEM_NBR_DEVICES - 1)) && (address >= m_device_size[device]))
+        {
+            address -= m_device_size[device];
+            device++;
+        }
+        segment->device = device;
+        segment->address = address;
+        segment->len = m_device_size[device] - address;
+    }
+}
+
+ret_code_t mem_array_init(mem_array_mode_t mode, uint32_t stripe_len)
+{
+    uint8_t selected = ext_mem_selected_device();
+    uint32_t min_size = 0xFFFFFFFF;
+    uint8_t i;
+
+    if ((mode == MEM_ARRAY_STRIPE) && ((stripe_len == 0) || ((stripe_len % MEM_PAGE_SIZE) != 0)))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_mode = mode;
+    m_stripe_len = stripe_len;
+    m_size = 0;
+
+    for (i = 0; i < EXT_MEM_NBR_DEVICES; i++)
+    {
+        ext_mem_select_device(i);
+        m_device_size[i] = ext_mem_get_info()->size;
+        m_size += m_device_size[i];
+        if (m_device_size[i] < min_size)
+        {
+            min_size = m_device_size[i];
+        }
+    }
+    ext_mem_select_device(selected);
+
+    if (m_mode == MEM_ARRAY_STRIPE)
+    {
+        /* Each device holds the same number of stripes */
+        m_size = (min_size / m_stripe_len) * m_stripe_len * EXT_MEM_NBR_DEVICES;
+    }
+
+    NRF_LOG_INFO("Memory array of %d devices, size %d bytes", EXT_MEM_NBR_DEVICES, m_size);
+
+    return NRF_SUCCESS;
+}
+
+uint32_t mem_array_size(void)
+{
+    return m_size;
+}
+
+/**@brief Program data page by page with the write function of the memory driver */
+static uint32_t mem_array_program(uint32_t address, uint8_t *data, uint32_t len,
+                                  ret_code_t (*write)(uint32_t, uint8_t*, uint32_t))
+{
+    ret_code_t err_code = NRF_SUCCESS;
+    mem_array_segment_t segment[EXT_MEM_NBR_DEVICES];
+    uint8_t selected = ext_mem_selected_device();
+    uint8_t nbr_segments;
+    uint32_t page_size;
+    uint32_t data_len;
+    bool pending;
+    uint8_t i;
+
+    if ((address + len) > m_size)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    while ((len > 0) && (err_code == NRF_SUCCESS))
+    {
+        /** Consecutive segments are in different devices */
+        for (nbr_segments = 0; (nbr_segments < EXT_MEM_NBR_DEVICES) && (len > 0); nbr_segments++)
+        {
+            mem_array_map(address, &segment[nbr_segments]);
+            segment[nbr_segments].len = MEM_ARRAY_MIN(segment[nbr_segments].len, len);
+            segment[nbr_segments].data = data;
+            address += segment[nbr_segments].len;
+            data += segment[nbr_segments].len;
+            len -= segment[nbr_segments].len;
+        }
+
+        /** Program a page of each segment in turn, a device is programming while the next one gets its page */
+        do
+        {
+            pending = false;
+            for (i = 0; (i < nbr_segments) && (err_code == NRF_SUCCESS); i++)
+            {
+                if (segment[i].len == 0)
+                {
+                    continue;
+                }
+
+                ext_mem_select_device(segment[i].device);
+                page_size = ext_mem_get_info()->page_size;
+                data_len = MEM_ARRAY_MIN(page_size - (segment[i].address & (page_size - 1)), segment[i].len);
+
+                err_code = write(segment[i].address, segment[i].data, data_len);
+
+                segment[i].address += data_len;
+                segment[i].data += data_len;
+                segment[i].len -= data_len;
+                pending |= (segment[i].len > 0);
+            }
+        }
+        while (pending && (err_code == NRF_SUCCESS));
+    }
+
+    ext_mem_select_device(selected);
+    return err_code;
+}
+
+uint32_t mem_array_write(uint32_t address, uint8_t *data, uint32_t len)
+{
+    return mem_array_program(address, data, len, memory_write);
+}
+
+uint32_t mem_array_write_if_changed(uint32_t address, uint8_t *data, uint32_t len)
+{
+    return mem_array_program(address, data, len, memory_write_if_changed);
+}
+
+uint32_t mem_array_read(uint32_t address, uint8_t *data, uint32_t len)
+{
+    ret_code_t err_code = NRF_SUCCESS;
+    mem_array_segment_t segment;
+    uint8_t selected = ext_mem_selected_device();
+
+    if ((address + len) > m_size)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    while ((len > 0) && (err_code == NRF_SUCCESS))
+    {
+        mem_array_map(address, &segment);
+        segment.len = MEM_ARRAY_MIN(segment.len, len);
+
+        ext_mem_select_device(segment.device);
+        err_code = memory_read(segment.address, data, segment.len);
+
+        address += segment.len;
+        data += segment.len;
+        len -= segment.len;
+    }
+
+    ext_mem_select_device(selected);
+    return err_code;
+}
+
+uint32_t mem_array_erase(uint32_t address, uint32_t size)
+{
+    ret_code_t err_code = NRF_SUCCESS;
+    mem_array_segment_t segment;
+    uint8_t selected = ext_mem_selected_device();
+
+    if ((address + size) > m_size)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    /** Erases do not wait for their completion, the erases in different devices overlap */
+    while ((size > 0) && (err_code == NRF_SUCCESS))
+    {
+        mem_array_map(address, &segment);
+        segment.len = MEM_ARRAY_MIN(segment.len, size);
+
+        ext_mem_select_device(segment.device);
+        err_code = memory_erase(segment.address, segment.len);
+
+        address += segment.len;
+        size -= segment.len;
+    }
+
+    ext_mem_select_device(selected);
+    return err_code;
+}
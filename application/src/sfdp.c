@@ -0,0 +1,206 @@
+#include <string.h>
+#include "sfdp.h"
+
+/** "SFDP" in little endian */
+#define SFDP_SIGNATURE              (0x50444653)
+#define SFDP_HEADER_LEN             8
+#define SFDP_PARAM_HEADER_LEN       8
+
+/** Parameter ID of the basic flash parameter table (JESD216) */
+#define SFDP_BASIC_TABLE_ID         (0xFF00)
+/** Table length of JESD216 (revision 1.0), erase and program times follow from revision A */
+#define SFDP_BASIC_TABLE_LEN_V1_0   9
+#define SFDP_BASIC_TABLE_MAX_LEN    16
+/** Parameter ID of the 4 byte address instruction table (JESD216B) */
+#define SFDP_4BAIT_TABLE_ID         (0xFF84)
+#define SFDP_4BAIT_TABLE_LEN        2
+
+/** Basic flash parameter table DWORD numbers (counted from one) */
+#define BFPT_DWORD(table, n)        sfdp_dword(&(table)[((n) - 1) * 4])
+
+static uint32_t sfdp_dword(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+/** Typical time from a 5 bit count and a 2 bit unit field */
+static uint32_t sfdp_typ_time(uint32_t count, uint32_t unit, const uint32_t *units)
+{
+    return (count + 1) * units[unit & 0x3];
+}
+
+static sfdp_status_t sfdp_parse_basic_table(const uint8_t *table, uint32_t nbr_dwords, sfdp_info_t *info)
+{
+    /** Erase time units in ms: 1 ms, 16 ms, 128 ms and 1 s */
+    static const uint32_t erase_units[] = { 1, 16, 128, 1000 };
+    /** Chip erase time units in ms: 16 ms, 256 ms, 4 s and 64 s */
+    static const uint32_t chip_erase_units[] = { 16, 256, 4000, 64000 };
+    uint32_t dword;
+    uint32_t i;
+
+    dword = BFPT_DWORD(table, 1);
+    info->address_mode = (sfdp_address_mode_t) ((dword >> 17) & 0x3);
+    info->fast_read_modes |= (dword & (1 << 16)) ? SFDP_FAST_READ_112 : 0;
+    info->fast_read_modes |= (dword & (1 << 20)) ? SFDP_FAST_READ_122 : 0;
+    info->fast_read_modes |= (dword & (1 << 21)) ? SFDP_FAST_READ_144 : 0;
+    info->fast_read_modes |= (dword & (1 << 22)) ? SFDP_FAST_READ_114 : 0;
+
+    dword = BFPT_DWORD(table, 2);
+    if (dword & 0x80000000)
+    {
+        /** Density is 2^N bits, only sizes up to 2 Gbyte are supported */
+        dword &= 0x7FFFFFFF;
+        if ((dword < 3) || (dword > 34))
+        {
+            return SFDP_STATUS_INVALID_TABLE;
+        }
+        info->density = 1UL << (dword - 3);
+    }
+    else
+    {
+        /** Density is N + 1 bits */
+        info->density = (dword / 8) + 1;
+    }
+
+    /** Erase types are described in DWORD 8 and 9 */
+    for (i = 0; i < SFDP_NBR_ERASE_TYPES; i++)
+    {
+        dword = BFPT_DWORD(table, 8 + (i / 2)) >> (16 * (i % 2));
+        if ((dword & 0xFF) != 0)
+        {
+            info->erase_type[i].size = 1UL << (dword & 0xFF);
+            info->erase_type[i].opcode = (dword >> 8) & 0xFF;
+        }
+    }
+
+    /** Page size 256 bytes when it is not given (JESD216 before revision A) */
+    info->page_size = 256;
+
+    if (nbr_dwords >= 11)
+    {
+        /** Typical erase time of each erase type in DWORD 10 */
+        dword = BFPT_DWORD(table, 10);
+        for (i = 0; i < SFDP_NBR_ERASE_TYPES; i++)
+        {
+            if (info->erase_type[i].size != 0)
+            {
+                info->erase_type[i].typ_time_ms = sfdp_typ_time((dword >> (4 + 7 * i)) & 0x1F, (dword >> (9 + 7 * i)) & 0x3, erase_units);
+            }
+        }
+
+        /** Page size, program and chip erase time in DWORD 11 */
+        dword = BFPT_DWORD(table, 11);
+        info->page_size = 1UL << ((dword >> 4) & 0xF);
+        info->page_program_typ_us = (((dword >> 8) & 0x1F) + 1) * ((dword & (1 << 13)) ? 64 : 8);
+        info->chip_erase_typ_ms = sfdp_typ_time((dword >> 24) & 0x1F, (dword >> 29) & 0x3, chip_erase_units);
+    }
+
+    if (nbr_dwords >= 16)
+    {
+        /** Enter 4 byte address mode methods in DWORD 16 */
+        info->enter_4b_methods = (BFPT_DWORD(table, 16) >> 24) & 0x3;
+    }
+
+    return SFDP_STATUS_SUCCESS;
+}
+
+static void sfdp_parse_4bait_table(const uint8_t *table, sfdp_info_t *info)
+{
+    uint32_t support = sfdp_dword(&table[0]);
+    uint32_t i;
+
+    info->read_4b = (support & (1 << 0)) != 0;
+    info->program_4b = (support & (1 << 6)) != 0;
+
+    /** Erase type 4 byte opcodes in DWORD 2 */
+    for (i = 0; i < SFDP_NBR_ERASE_TYPES; i++)
+    {
+        if ((info->erase_type[i].size != 0) && (support & (1 << (9 + i))))
+        {
+            info->erase_type[i].opcode_4b = table[4 + i];
+        }
+    }
+}
+
+sfdp_status_t sfdp_parse(sfdp_read_t sfdp_read, sfdp_info_t *info)
+{
+    uint8_t header[SFDP_HEADER_LEN];
+    uint8_t param_header[SFDP_PARAM_HEADER_LEN];
+    uint8_t table[SFDP_BASIC_TABLE_MAX_LEN * 4];
+    uint8_t table_4bait[SFDP_4BAIT_TABLE_LEN * 4];
+    uint32_t table_address = 0;
+    uint32_t table_4bait_address = 0;
+    uint32_t nbr_dwords = 0;
+    sfdp_status_t status;
+    uint32_t nbr_headers;
+    uint32_t i;
+
+    memset(info, 0, sizeof(sfdp_info_t));
+
+    if (sfdp_read(0, header, sizeof(header)) != 0)
+    {
+        return SFDP_STATUS_READ_ERROR;
+    }
+
+    if (sfdp_dword(header) != SFDP_SIGNATURE)
+    {
+        return SFDP_STATUS_NO_SIGNATURE;
+    }
+
+    info->minor_rev = header[4];
+    info->major_rev = header[5];
+    nbr_headers = header[6] + 1;
+
+    /** Use the last basic table with a supported major revision, it is the most recent one */
+    for (i = 0; i < nbr_headers; i++)
+    {
+        if (sfdp_read(SFDP_HEADER_LEN + i * SFDP_PARAM_HEADER_LEN, param_header, sizeof(param_header)) != 0)
+        {
+            return SFDP_STATUS_READ_ERROR;
+        }
+
+        if (((param_header[7] << 8) | param_header[0]) == SFDP_BASIC_TABLE_ID && param_header[2] == 1)
+        {
+            nbr_dwords = param_header[3];
+            table_address = param_header[4] | (param_header[5] << 8) | (param_header[6] << 16);
+        }
+        else if ((((param_header[7] << 8) | param_header[0]) == SFDP_4BAIT_TABLE_ID) && (param_header[3] >= SFDP_4BAIT_TABLE_LEN))
+        {
+            table_4bait_address = param_header[4] | (param_header[5] << 8) | (param_header[6] << 16);
+        }
+    }
+
+    if (nbr_dwords == 0)
+    {
+        return SFDP_STATUS_NO_BASIC_TABLE;
+    }
+
+    if (nbr_dwords < SFDP_BASIC_TABLE_LEN_V1_0)
+    {
+        return SFDP_STATUS_INVALID_TABLE;
+    }
+
+    if (nbr_dwords > SFDP_BASIC_TABLE_MAX_LEN)
+    {
+        nbr_dwords = SFDP_BASIC_TABLE_MAX_LEN;
+    }
+
+    if (sfdp_read(table_address, table, nbr_dwords * 4) != 0)
+    {
+        return SFDP_STATUS_READ_ERROR;
+    }
+
+    status = sfdp_parse_basic_table(table, nbr_dwords, info);
+
+    /** The 4 byte address instruction table is optional */
+    if ((status == SFDP_STATUS_SUCCESS) && (table_4bait_address != 0))
+    {
+        if (sfdp_read(table_4bait_address, table_4bait, sizeof(table_4bait)) != 0)
+        {
+            return SFDP_STATUS_READ_ERROR;
+        }
+        sfdp_parse_4bait_table(table_4bait, info);
+    }
+
+    return status;
+}
@@ -38,7 +38,22 @@
 /** An invalidated file is found */
 #define OLD_FILE       (0x00)
 
+/** On a memory limiting the writes of a word, each page state and file status
+ *  transition writes its own word and the files are aligned on words */
+#define SFS_WORD_LEN            (sizeof(uint32_t))
+#define SFS_WORD_ALIGN(len)     (((len) + SFS_WORD_LEN - 1) & ~(SFS_WORD_LEN - 1))
+/** Words of ACTIVE_PAGE, OLD_PAGE and OBSOLETE_PAGE at the start of a page */
+#define SFS_PAGE_STATE_WORDS    3
+/** Words of ACTIVE_FILE and OLD_FILE after the file header, the header holds the other status */
+#define SFS_FILE_STATUS_WORDS   2
+
 static sfs_parameters_t *sfs_param;
+/** Memory of sfs_parameters_t, it holds the garbage collection */
+static sfs_mem_t sfs_main_mem;
+/** Memory of the folder being accessed */
+static const sfs_mem_t *sfs_mem = &sfs_main_mem;
+/** Non zero when the folder being accessed and its garbage collection use a word per status */
+static uint8_t sfs_word_status;
 
 typedef enum
 {
@@ -58,11 +73,146 @@ static sfs_status_t sfs_search_page(uint32_t addr, uint32_t start_addr, sfs_sear
 static sfs_status_t sfs_perform_gc(sfs_file_info_t *file_info, uint32_t *nbr_of_fresh_pages_after_gc);
 static sfs_status_t sfs_move_active_files_to_gc_pages(uint32_t *address, uint32_t folder_start_address, uint32_t folder_end_address,
                                                       uint32_t page_size, uint32_t *gc_address, uint32_t gc_size);
-static sfs_status_t sfs_copy_data(uint32_t source_address, uint32_t dest_address, uint32_t data_len);
+static sfs_status_t sfs_copy_data(const sfs_mem_t *source_mem, uint32_t source_address, const sfs_mem_t *dest_mem, uint32_t dest_address,
+                                   uint32_t data_len);
 static sfs_status_t sfs_update_data_pages(uint32_t folder_start_address, uint32_t folder_end_address, uint32_t page_size, uint32_t gc_start_address,
                                           uint32_t gc_size, uint32_t gc_address);
 
-static sfs_status_t sfs_copy_data(uint32_t source_address, uint32_t dest_address, uint32_t data_len)
+/**@brief Write a page state or a file status, it is often already in the memory */
+static uint32_t sfs_write_status(const sfs_mem_t *mem, uint32_t address, uint8_t *status, uint32_t len)
+{
+    if (mem->mem_update != NULL)
+    {
+        return mem->mem_update(address, status, len);
+    }
+    return mem->mem_write(address, status, len);
+}
+
+/**@brief Length of the page state at the start of a page */
+static uint32_t sfs_page_state_len(void)
+{
+    return sfs_word_status ? (SFS_PAGE_STATE_WORDS * SFS_WORD_LEN) : sizeof(uint8_t);
+}
+
+/**@brief Offset of the data of a file from its header */
+static uint32_t sfs_file_header_len(void)
+{
+    return sfs_word_status ? (SFS_WORD_ALIGN(sizeof(sfs_file_header_t)) + (SFS_FILE_STATUS_WORDS * SFS_WORD_LEN)) : sizeof(sfs_file_header_t);
+}
+
+/**@brief Length of a file up to the header of the next file */
+static uint32_t sfs_file_len(uint32_t data_len)
+{
+    return sfs_file_header_len() + (sfs_word_status ? SFS_WORD_ALIGN(data_len) : data_len);
+}
+
+/**@brief Room kept after the last file of a page, the END_PAGE status is written there
+ *        and the header read there must not reach the next page
+ */
+static uint32_t sfs_end_page_len(void)
+{
+    return sfs_word_status ? sfs_file_header_len() : sizeof(uint8_t);
+}
+
+/**@brief Read the state of a page, with a word per state it is the last word written */
+static uint32_t sfs_read_page_state(const sfs_mem_t *mem, uint32_t address, uint8_t *page_state)
+{
+    uint32_t words[SFS_PAGE_STATE_WORDS];
+    uint32_t err_code;
+    uint32_t i;
+
+    if (!sfs_word_status)
+    {
+        return mem->mem_read(address, page_state, sizeof(*page_state));
+    }
+
+    err_code = mem->mem_read(address, (uint8_t*) words, sizeof(words));
+    *page_state = NEW_PAGE;
+    for (i = 0; (i < SFS_PAGE_STATE_WORDS) && (err_code == 0); i++)
+    {
+        if (words[i] != 0xFFFFFFFF)
+        {
+            *page_state = (uint8_t) words[i];
+        }
+    }
+    return err_code;
+}
+
+/**@brief Write the state of a page */
+static uint32_t sfs_write_page_state(const sfs_mem_t *mem, uint32_t address, uint8_t page_state)
+{
+    if (sfs_word_status)
+    {
+        if (page_state == OLD_PAGE)
+        {
+            address += SFS_WORD_LEN;
+        }
+        else if (page_state == OBSOLETE_PAGE)
+        {
+            address += 2 * SFS_WORD_LEN;
+        }
+    }
+    return sfs_write_status(mem, address, &page_state, sizeof(page_state));
+}
+
+/**@brief Read the header of a file, with a word per status the last word written gives the status */
+static uint32_t sfs_read_file_header(const sfs_mem_t *mem, uint32_t address, sfs_file_header_t *file_header)
+{
+    uint32_t words[SFS_FILE_STATUS_WORDS];
+    uint32_t err_code;
+    uint32_t i;
+
+    err_code = mem->mem_read(address, (uint8_t*) file_header, sizeof(*file_header));
+    if (!sfs_word_status || (err_code != 0))
+    {
+        return err_code;
+    }
+
+    err_code = mem->mem_read(address + SFS_WORD_ALIGN(sizeof(sfs_file_header_t)), (uint8_t*) words, sizeof(words));
+    for (i = 0; (i < SFS_FILE_STATUS_WORDS) && (err_code == 0); i++)
+    {
+        if (words[i] != 0xFFFFFFFF)
+        {
+            file_header->status = (uint8_t) words[i];
+        }
+    }
+    return err_code;
+}
+
+/**@brief Write the status of a file, PARTIAL_FILE and END_PAGE are in the header */
+static uint32_t sfs_write_file_status(const sfs_mem_t *mem, uint32_t address, uint8_t file_status)
+{
+    if (sfs_word_status)
+    {
+        if (file_status == ACTIVE_FILE)
+        {
+            address += SFS_WORD_ALIGN(sizeof(sfs_file_header_t));
+        }
+        else if (file_status == OLD_FILE)
+        {
+            address += SFS_WORD_ALIGN(sizeof(sfs_file_header_t)) + SFS_WORD_LEN;
+        }
+    }
+    return sfs_write_status(mem, address, &file_status, sizeof(file_status));
+}
+
+/**@brief Select the memory of a folder for the following accesses */
+static void sfs_select_folder_mem(uint16_t folder_id)
+{
+    if ((folder_id < sfs_param->nbr_folders) && (sfs_param->sfs_folder_info[folder_id].mem != NULL))
+    {
+        sfs_mem = sfs_param->sfs_folder_info[folder_id].mem;
+    }
+    else
+    {
+        sfs_mem = &sfs_main_mem;
+    }
+    /** The garbage collection pages take the layout of the folder */
+    sfs_word_status = (sfs_mem->word_writes != 0) || (sfs_main_mem.word_writes != 0);
+}
+
+static sfs_status_t sfs_copy_data(const sfs_mem_t *source_mem, uint32_t source_address, const sfs_mem_t *dest_mem, uint32_t dest_address,
+                                   uint32_t data_len)
 {
     uint8_t data[DATA_TRANSFER_SIZE];
     uint32_t len;
@@ -78,12 +228,12 @@ static sfs_status_t sfs_copy_data(uint32_t source_address, uint32_t dest_address
             len = data_len;
         }
 
-        if (sfs_param->mem_read(source_address, data, len) != 0)
+        if (source_mem->mem_read(source_address, data, len) != 0)
         {
             return SFS_STATUS_DRIVER_ERROR;
         }
 
-        if (sfs_param->mem_write(dest_address, data, len) != 0)
+        if (dest_mem->mem_write(dest_address, data, len) != 0)
         {
             return SFS_STATUS_DRIVER_ERROR;
         }
@@ -114,14 +264,14 @@ static sfs_status_t sfs_move_active_files_to_gc_pages(uint32_t *address, uint32_
          if (*address == page_start_address)
          {
              /** Read the page status */
-             if (sfs_param->mem_read(*address, &page_state, sizeof(page_state)) != 0)
+             if (sfs_read_page_state(sfs_mem, *address, &page_state) != 0)
              {
                  return SFS_STATUS_DRIVER_ERROR;
              }
 
              if (page_state == OBSOLETE_PAGE)
              {
-                 if (sfs_param->mem_erase(*address, page_size))
+                 if (sfs_mem->mem_erase(*address, page_size))
                  {
                      return SFS_STATUS_DRIVER_ERROR;
                  }
@@ -133,25 +283,25 @@ static sfs_status_t sfs_move_active_files_to_gc_pages(uint32_t *address, uint32_
                  /** All active files are collected */
                  status = SFS_STATUS_SUCCESS;
              }
-             *address += sizeof(page_state);
+             *address += sfs_page_state_len();
          }
 
         /** Iterate through all files in a folder page */
         while ((*address < (page_start_address + page_size)) && (*gc_address < gc_end_address) && (status == SFS_STATUS_BLANK))
         {
-            if (sfs_param->mem_read(*address, (uint8_t*) &file_header, sizeof(file_header)) != 0)
+            if (sfs_read_file_header(sfs_mem, *address, &file_header) != 0)
             {
                 return SFS_STATUS_DRIVER_ERROR;
             }
 
             if (file_header.status == OLD_FILE)
             {
-                *address += (sizeof(file_header) + file_header.data_len);
+                *address += sfs_file_len(file_header.data_len);
             }
             else if (file_header.status == END_PAGE || file_header.status == NEW_FILE)
             {
                 *address = PAGE_START_ADDR((*address), folder_start_address, page_size);
-                if (sfs_param->mem_erase(*address, page_size))
+                if (sfs_mem->mem_erase(*address, page_size))
                 {
                     return SFS_STATUS_DRIVER_ERROR;
                 }
@@ -167,7 +317,12 @@ static sfs_status_t sfs_move_active_files_to_gc_pages(uint32_t *address, uint32_
             }
             else if (file_header.status == ACTIVE_FILE || file_header.status == PARTIAL_FILE)
             {
-                next_gc_address = (*gc_address + sizeof(file_header) + file_header.data_len);
+                /** The file and the room for END_PAGE, after the page state of a new page */
+                next_gc_address = (*gc_address + sfs_file_len(file_header.data_len) + sfs_end_page_len() - 1);
+                if (PAGE_START_ADDR(*gc_address, gc_start_address, page_size) == *gc_address)
+                {
+                    next_gc_address += sfs_page_state_len();
+                }
                 /** Check if the active file fits into the current garbage page */
                 if (PAGE_START_ADDR(next_gc_address, gc_start_address, page_size) == PAGE_START_ADDR(*gc_address, gc_start_address, page_size))
                 {
@@ -175,44 +330,40 @@ static sfs_status_t sfs_move_active_files_to_gc_pages(uint32_t *address, uint32_
                     /** Update the page as active */
                     if (PAGE_START_ADDR(*gc_address, gc_start_address, page_size) == *gc_address)
                     {
-                        if (sfs_param->mem_erase(*gc_address, page_size))
+                        if (sfs_main_mem.mem_erase(*gc_address, page_size))
                         {
                             return SFS_STATUS_DRIVER_ERROR;
                         }
-                        page_state = ACTIVE_PAGE;
-                        if (sfs_param->mem_write(*gc_address, &page_state, sizeof(page_state)))
+                        if (sfs_write_page_state(&sfs_main_mem, *gc_address, ACTIVE_PAGE))
                         {
                             return SFS_STATUS_DRIVER_ERROR;
                         }
-                        *gc_address += sizeof(page_state);
+                        *gc_address += sfs_page_state_len();
                     }
                     /** Copy the active file to garbage collection page */
-                    if (sfs_copy_data(*address, *gc_address, (sizeof(file_header) + file_header.data_len)) != SFS_STATUS_SUCCESS)
+                    if (sfs_copy_data(sfs_mem, *address, &sfs_main_mem, *gc_address, sfs_file_len(file_header.data_len)) != SFS_STATUS_SUCCESS)
                     {
                         return SFS_STATUS_DRIVER_ERROR;
                     }
                     /** Update the status as OLD file */
-                    file_header.status = OLD_FILE;
-                    if (sfs_param->mem_write(*address, (uint8_t*) &file_header.status, sizeof(file_header.status)) != 0)
+                    if (sfs_write_file_status(sfs_mem, *address, OLD_FILE) != 0)
                     {
                         return SFS_STATUS_DRIVER_ERROR;
                     }
-                    *gc_address += (sizeof(file_header) + file_header.data_len);
-                    *address += (sizeof(file_header) + file_header.data_len);
+                    *gc_address += sfs_file_len(file_header.data_len);
+                    *address += sfs_file_len(file_header.data_len);
                 }
                 else
                 {
                     /** Data crossing a GC page */
                     /** Mark it as end of the page and copy this file starting from the next page */
-                    file_header.status = END_PAGE;
-                    if (sfs_param->mem_write(*gc_address, (uint8_t*) &file_header.status, sizeof(file_header.status)) != 0)
+                    if (sfs_write_file_status(&sfs_main_mem, *gc_address, END_PAGE) != 0)
                     {
                         return SFS_STATUS_DRIVER_ERROR;
                     }
                     /** Go to the beginning of the page and mark it as old */
                     *gc_address = PAGE_START_ADDR(*gc_address, gc_start_address, page_size);
-                    page_state = OLD_PAGE;
-                    if (sfs_param->mem_write(*gc_address, &page_state, sizeof(page_state)) != 0)
+                    if (sfs_write_page_state(&sfs_main_mem, *gc_address, OLD_PAGE) != 0)
                     {
                         return SFS_STATUS_DRIVER_ERROR;
                     }
@@ -242,7 +393,7 @@ static sfs_status_t sfs_update_data_pages(uint32_t folder_start_address, uint32_
     while ((gc_start_address < gc_end_address) && (folder_start_address < folder_end_address))
     {
         /** Read the data page status */
-        if (sfs_param->mem_read(folder_start_address, &data_page_state, sizeof(data_page_state)) != 0)
+        if (sfs_read_page_state(sfs_mem, folder_start_address, &data_page_state) != 0)
         {
             return SFS_STATUS_DRIVER_ERROR;
         }
@@ -250,7 +401,7 @@ static sfs_status_t sfs_update_data_pages(uint32_t folder_start_address, uint32_
         if (data_page_state == NEW_PAGE)
         {
             /** Read the GC page status */
-            if (sfs_param->mem_read(gc_start_address, &gc_page_state, sizeof(gc_page_state)) != 0)
+            if (sfs_read_page_state(&sfs_main_mem, gc_start_address, &gc_page_state) != 0)
             {
                 return SFS_STATUS_DRIVER_ERROR;
             }
@@ -260,7 +411,7 @@ static sfs_status_t sfs_update_data_pages(uint32_t folder_start_address, uint32_
                 /** Copy GC pages only till the data, not the entire GC space */
                 gc_copy_len = (gc_start_address + page_size) > gc_address ? (gc_address - gc_start_address) : page_size;
                 /** Copy contents of GC page to the data page */
-                status = sfs_copy_data(gc_start_address, folder_start_address, gc_copy_len);
+                status = sfs_copy_data(&sfs_main_mem, gc_start_address, sfs_mem, folder_start_address, gc_copy_len);
                 if (status != SFS_STATUS_SUCCESS)
                 {
                     return SFS_STATUS_DRIVER_ERROR;
@@ -281,7 +432,7 @@ static sfs_status_t sfs_find_nbr_of_free_pages(uint32_t start_address, uint32_t
 
     while (start_address < end_address)
     {
-        if (sfs_param->mem_read(start_address, &page_state, sizeof(page_state)) != 0)
+        if (sfs_read_page_state(sfs_mem, start_address, &page_state) != 0)
         {
             return SFS_STATUS_DRIVER_ERROR;
         }
@@ -364,7 +515,7 @@ static sfs_status_t sfs_search_page(uint32_t addr, uint32_t start_addr, sfs_sear
     /** Find the end address of the page */
     end_addr = start_addr + page_len;
     /** Read the page status */
-    if (sfs_param->mem_read(start_addr, &page_state, sizeof(page_state)) != 0)
+    if (sfs_read_page_state(sfs_mem, start_addr, &page_state) != 0)
     {
         return SFS_STATUS_DRIVER_ERROR;
     }
@@ -378,15 +529,15 @@ static sfs_status_t sfs_search_page(uint32_t addr, uint32_t start_addr, sfs_sear
 
     if (start_addr == addr)
     {
-        /** addr is equal to the start of the page, then increment by 1.
+        /** addr is equal to the start of the page, then skip the page state.
          * Sometimes the addr is taken from the last written address and it
          * should not be incremented in that case.*/
-        addr += sizeof(page_state);
+        addr += sfs_page_state_len();
     }
 
     while (addr < end_addr)
     {
-        if (sfs_param->mem_read(addr, (uint8_t*) &file_header, sizeof(file_header)) != 0)
+        if (sfs_read_file_header(sfs_mem, addr, &file_header) != 0)
         {
             return SFS_STATUS_DRIVER_ERROR;
         }
@@ -400,7 +551,7 @@ static sfs_status_t sfs_search_page(uint32_t addr, uint32_t start_addr, sfs_sear
         /** Look for space to store a new file */
         if ((search == SFS_SEARCH_FREE_SPACE) && (file_header.status == NEW_FILE))
         {
-            file_len = file_info->file_header.data_len + sizeof(sfs_file_header_t) + sizeof(page_state);
+            file_len = sfs_file_len(file_info->file_header.data_len) + sfs_end_page_len();
             /** Write a file only if it fits in this page, else declare the page is full */
             if ((end_addr - addr) >= file_len)
             {
@@ -408,7 +559,7 @@ static sfs_status_t sfs_search_page(uint32_t addr, uint32_t start_addr, sfs_sear
                 if (page_state == NEW_PAGE)
                 {
                     page_state = ACTIVE_PAGE;
-                    if (sfs_param->mem_write(start_addr, &page_state, sizeof(page_state)) != 0)
+                    if (sfs_write_page_state(sfs_mem, start_addr, page_state) != 0)
                     {
                         return SFS_STATUS_DRIVER_ERROR;
                     }
@@ -420,14 +571,12 @@ static sfs_status_t sfs_search_page(uint32_t addr, uint32_t start_addr, sfs_sear
             else
             {
                 /** Declare the page is full by marking it as old page, indicating that no free space available for new file */
-                page_state = OLD_PAGE;
-                if (sfs_param->mem_write(start_addr, &page_state, sizeof(page_state)) != 0)
+                if (sfs_write_page_state(sfs_mem, start_addr, OLD_PAGE) != 0)
                 {
                     return SFS_STATUS_DRIVER_ERROR;
                 }
                 /** Declare the page is full by marking end of page status in the following address */
-                page_state = END_PAGE;
-                if (sfs_param->mem_write(addr, &page_state, sizeof(page_state)) != 0)
+                if (sfs_write_file_status(sfs_mem, addr, END_PAGE) != 0)
                 {
                     return SFS_STATUS_DRIVER_ERROR;
                 }
@@ -483,14 +632,13 @@ static sfs_status_t sfs_search_page(uint32_t addr, uint32_t start_addr, sfs_sear
             last_file.file_header = file_header;
             last_file.address = addr;
         }
-        addr += sizeof(sfs_file_header_t) + file_header.data_len;
+        addr += sfs_file_len(file_header.data_len);
     }
 
     /** Declare a page as obsolete when it has no active file */
     if (is_active_file == 0)
     {
-        page_state = OBSOLETE_PAGE;
-        if (sfs_param->mem_write(start_addr, &page_state, sizeof(page_state)) != 0)
+        if (sfs_write_page_state(sfs_mem, start_addr, OBSOLETE_PAGE) != 0)
         {
             return SFS_STATUS_DRIVER_ERROR;
         }
@@ -521,6 +669,8 @@ static sfs_status_t sfs_search(sfs_search_type_t search, sfs_file_info_t *file_i
         return SFS_STATUS_WRONG_FOLDER;
     }
 
+    sfs_select_folder_mem(folder_id);
+
     addr = sfs_param->sfs_folder_info[folder_id].start_address;
     end_addr = addr + sfs_param->sfs_folder_info[folder_id].folder_len;
     last_written_address = sfs_param->sfs_folder_info[folder_id].last_written_address;
@@ -581,48 +731,100 @@ static sfs_status_t sfs_search(sfs_search_type_t search, sfs_file_info_t *file_i
     return status;
 }
 
+/**@brief Write the header and the data of a new file
+ *
+ * When a program fails, the file is marked old so that the search skips it.
+ *
+ * @return SFS_STATUS_PROGRAM_ERROR when the file is to be written again
+ */
+static sfs_status_t sfs_write_new_file(sfs_file_info_t *file_info, uint8_t *data)
+{
+    sfs_file_header_t header;
+    uint32_t err_code;
+
+    /** Write the header and the data */
+    err_code = sfs_mem->mem_write(file_info->address, (uint8_t*) &file_info->file_header, sizeof(sfs_file_header_t));
+    if (err_code == 0)
+    {
+        err_code = sfs_mem->mem_write(file_info->address + sfs_file_header_len(), data, file_info->file_header.data_len);
+    }
+
+    if (err_code == 0)
+    {
+        return SFS_STATUS_SUCCESS;
+    }
+    else if (err_code != SFS_MEM_PROGRAM_FAILED)
+    {
+        return SFS_STATUS_DRIVER_ERROR;
+    }
+
+    /** The length must be read back right to skip the file */
+    if ((sfs_mem->mem_read(file_info->address, (uint8_t*) &header, sizeof(header)) != 0)
+            || (header.data_len != file_info->file_header.data_len))
+    {
+        return SFS_STATUS_DRIVER_ERROR;
+    }
+
+    NRF_LOG_WARNING("Program failed at %x, file %x is written again", file_info->address, file_info->file_header.file_id);
+    if (sfs_write_file_status(sfs_mem, file_info->address, OLD_FILE) != 0)
+    {
+        return SFS_STATUS_DRIVER_ERROR;
+    }
+
+    return SFS_STATUS_PROGRAM_ERROR;
+}
+
 sfs_status_t sfs_write_file(uint32_t file_id, uint8_t *data, uint32_t data_len)
 {
     sfs_status_t status;
     sfs_file_info_t new_file_info;
     sfs_file_info_t old_file_info;
     uint16_t folder_id = FOLDER(file_id) - 1;
+    uint32_t retry;
 
-    new_file_info.file_header.file_id = file_id;
-    new_file_info.file_header.data_len = data_len;
-    old_file_info.file_header.file_id = file_id;
-    old_file_info.address = 0;
-    /** Search for new space and perform GC if needed*/
-    status = sfs_search(SFS_SEARCH_FREE_SPACE, &new_file_info);
-    /** Search for an existing file */
-    sfs_search(SFS_SEARCH_FILE_ID, &old_file_info);
-    if (status == SFS_STATUS_SUCCESS)
+    for (retry = 0; retry <= SFS_WRITE_RETRIES; retry++)
     {
+        new_file_info.file_header.file_id = file_id;
+        new_file_info.file_header.data_len = data_len;
+        old_file_info.file_header.file_id = file_id;
+        old_file_info.address = 0;
+        /** Search for new space and perform GC if needed*/
+        status = sfs_search(SFS_SEARCH_FREE_SPACE, &new_file_info);
+        /** Search for an existing file, the GC may have moved it */
+        sfs_search(SFS_SEARCH_FILE_ID, &old_file_info);
+        if (status != SFS_STATUS_SUCCESS)
+        {
+            break;
+        }
+
         new_file_info.file_header.status = ACTIVE_FILE;
         new_file_info.file_header.data_len = data_len;
         new_file_info.file_header.crc16 = crc16_compute(data, data_len, NULL);
-        sfs_param->sfs_folder_info[folder_id].last_written_address = new_file_info.address;
         NRF_LOG_INFO("Data written at %x, len: %d", new_file_info.address, data_len);
-        /** Write the header */
-        if (sfs_param->mem_write(new_file_info.address, (uint8_t*) &new_file_info.file_header, sizeof(sfs_file_header_t)) != 0)
+        status = sfs_write_new_file(&new_file_info, data);
+        if (status == SFS_STATUS_SUCCESS)
         {
-            return SFS_STATUS_DRIVER_ERROR;
+            sfs_param->sfs_folder_info[folder_id].last_written_address = new_file_info.address;
         }
-        /** Write the data */
-        new_file_info.address += sizeof(sfs_file_header_t);
-        if (sfs_param->mem_write(new_file_info.address, data, data_len) != 0)
+        if (status != SFS_STATUS_PROGRAM_ERROR)
         {
-            return SFS_STATUS_DRIVER_ERROR;
+            break;
         }
     }
 
+    /** The old file stays active when the new one could not be written */
+    if ((status == SFS_STATUS_PROGRAM_ERROR) || (status == SFS_STATUS_DRIVER_ERROR))
+    {
+        return status;
+    }
+
     /** Inactivate the old file */
     if (old_file_info.address)
     {
         old_file_info.file_header.status = OLD_FILE;
         NRF_LOG_INFO("Data invalidated at %x, len: %d", old_file_info.address, old_file_info.file_header.data_len);
         /** Write the header */
-        if (sfs_param->mem_write(old_file_info.address, (uint8_t*) &old_file_info.file_header.status, sizeof(old_file_info.file_header.status)) != 0)
+        if (sfs_write_file_status(sfs_mem, old_file_info.address, old_file_info.file_header.status) != 0)
         {
             return SFS_STATUS_DRIVER_ERROR;
         }
@@ -641,14 +843,14 @@ sfs_status_t sfs_read_file_data(sfs_file_info_t *file_info, uint8_t *data, uint3
     NRF_LOG_INFO("Read from %x, len: %d", file_info->address, data_len);
     NRF_LOG_FLUSH();
 
-    file_info->address += sizeof(sfs_file_header_t);
+    sfs_select_folder_mem(FOLDER(file_info->file_header.file_id) - 1);
+    file_info->address += sfs_file_header_len();
 
     if (data_len != file_info->file_header.data_len)
     {
         return SFS_STATUS_FILE_LEN_MISMATCH;
     }
-
-    if (sfs_param->mem_read(file_info->address, data, data_len) != 0)
+    if (sfs_mem->mem_read(file_info->address, data, data_len) != 0)
     {
         return SFS_STATUS_DRIVER_ERROR;
     }
@@ -662,6 +864,66 @@ sfs_status_t sfs_read_file_data(sfs_file_info_t *file_info, uint8_t *data, uint3
     return SFS_STATUS_SUCCESS;
 }
 
+sfs_status_t sfs_read_file_range(const sfs_file_info_t *file_info, uint32_t offset, uint8_t *data, uint32_t data_len)
+{
+    if ((offset > file_info->file_header.data_len) || (data_len > (file_info->file_header.data_len - offset)))
+    {
+        return SFS_STATUS_FILE_LEN_MISMATCH;
+    }
+
+    sfs_select_folder_mem(FOLDER(file_info->file_header.file_id) - 1);
+    if (sfs_mem->mem_read(file_info->address + sfs_file_header_len() + offset, data, data_len) != 0)
+    {
+        return SFS_STATUS_DRIVER_ERROR;
+    }
+
+    return SFS_STATUS_SUCCESS;
+}
+
+sfs_status_t sfs_map_file(uint32_t file_id, const uint8_t **data, uint32_t *data_len)
+{
+    sfs_file_info_t file_info;
+    sfs_status_t status;
+
+    file_info.file_header.file_id = file_id;
+    status = sfs_search(SFS_SEARCH_FILE_ID, &file_info);
+    if (status != SFS_STATUS_SUCCESS)
+    {
+        return status;
+    }
+
+    /** The memory of the folder is selected by the search */
+    if (sfs_mem->mem_map != NULL)
+    {
+        if (sfs_mem->mem_map(file_info.address + sfs_file_header_len(), data) != 0)
+        {
+            return SFS_STATUS_DRIVER_ERROR;
+        }
+    }
+    else if ((sfs_param->map_buffer != NULL) && (file_info.file_header.data_len <= sfs_param->map_buffer_len))
+    {
+        /** Fall back to a copy */
+        if (sfs_mem->mem_read(file_info.address + sfs_file_header_len(), sfs_param->map_buffer, file_info.file_header.data_len) != 0)
+        {
+            return SFS_STATUS_DRIVER_ERROR;
+        }
+        *data = sfs_param->map_buffer;
+    }
+    else
+    {
+        return SFS_STATUS_NOT_MAPPED;
+    }
+    *data_len = file_info.file_header.data_len;
+
+    /** Ignore CRC error when it does not contain valid data */
+    if ((crc16_compute(*data, *data_len, NULL) != file_info.file_header.crc16) && (file_info.file_header.crc16 != 0xFFFF))
+    {
+        return SFS_STATUS_CRC_ERROR;
+    }
+
+    return SFS_STATUS_SUCCESS;
+}
+
 sfs_status_t sfs_read_file(uint32_t file_id, uint8_t *data, uint32_t data_len)
 {
     sfs_status_t status;
@@ -715,15 +977,15 @@ sfs_status_t sfs_write_file_in_parts(uint32_t file_id, uint32_t rem_len, uint8_t
             new_file_info.file_header.file_id = file_id;
             new_file_info.file_header.status = PARTIAL_FILE;
             /** Write the header */
-            if (sfs_param->mem_write(file_address, (uint8_t*) &new_file_info.file_header, sizeof(sfs_file_header_t)) != 0)
+            if (sfs_mem->mem_write(file_address, (uint8_t*) &new_file_info.file_header, sizeof(sfs_file_header_t)) != 0)
             {
                 return SFS_STATUS_DRIVER_ERROR;
             }
         }
         /** Write the data */
-        file_address += (sizeof(sfs_file_header_t) + new_file_info.file_header.data_len - rem_len);
+        file_address += (sfs_file_header_len() + new_file_info.file_header.data_len - rem_len);
         /** Write the data */
-        if (sfs_param->mem_write(file_address, data, data_len) != 0)
+        if (sfs_mem->mem_write(file_address, data, data_len) != 0)
         {
             return SFS_STATUS_DRIVER_ERROR;
         }
@@ -740,17 +1002,16 @@ sfs_status_t sfs_write_file_in_parts(uint32_t file_id, uint32_t rem_len, uint8_t
             {
                 NRF_LOG_INFO("Invalidate old file %x at %x", file_id, old_file_info.address);
                 /** Update the status of the old file */
-                if (sfs_param->mem_write(old_file_info.address, (uint8_t*) &old_file_info.file_header.status,
-                                         sizeof(old_file_info.file_header.status)) != 0)
+                if (sfs_write_file_status(sfs_mem, old_file_info.address, old_file_info.file_header.status) != 0)
                 {
                     return SFS_STATUS_DRIVER_ERROR;
                 }
             }
             /** Point address to the beginning of the file header */
-            file_address += (data_len - new_file_info.file_header.data_len - sizeof(new_file_info.file_header));
+            file_address += (data_len - new_file_info.file_header.data_len - sfs_file_header_len());
             /** Update the status as active file and invalidate the old file while updating the last part */
             new_file_info.file_header.status = ACTIVE_FILE;
-            if (sfs_param->mem_write(file_address, (uint8_t*) &new_file_info.file_header.status, sizeof(new_file_info.file_header.status)) != 0)
+            if (sfs_write_file_status(sfs_mem, file_address, new_file_info.file_header.status) != 0)
             {
                 return SFS_STATUS_DRIVER_ERROR;
             }
@@ -776,8 +1037,8 @@ sfs_status_t sfs_read_file_in_parts(uint32_t file_id, uint32_t rem_len, uint8_t
     /** Read data in parts */
     if (status == SFS_STATUS_SUCCESS)
     {
-        address = file_info.address + (file_info.file_header.data_len - rem_len) + sizeof(sfs_file_header_t);
-        if (sfs_param->mem_read(address, data, data_len) != 0)
+        address = file_info.address + (file_info.file_header.data_len - rem_len) + sfs_file_header_len();
+        if (sfs_mem->mem_read(address, data, data_len) != 0)
         {
             return SFS_STATUS_DRIVER_ERROR;
         }
@@ -787,6 +1048,66 @@ sfs_status_t sfs_read_file_in_parts(uint32_t file_id, uint32_t rem_len, uint8_t
     return status;
 }
 
+/**@brief Check that the folders and the garbage collection fit in the memory
+ *        and do not overlap each other
+ */
+static sfs_status_t sfs_check_folders(void)
+{
+    uint8_t i, j;
+    sfs_folder_info_t *folder;
+    const sfs_mem_t *mem;
+
+    if ((sfs_param->gc_address + sfs_param->gc_len) > sfs_main_mem.mem_len)
+    {
+        NRF_LOG_INFO("Garbage collection at 0x%x is out of memory", sfs_param->gc_address);
+        return SFS_STATUS_NO_SPACE;
+    }
+
+    for (i = 0; i < sfs_param->nbr_folders; i++)
+    {
+        folder = &sfs_param->sfs_folder_info[i];
+        mem = (folder->mem != NULL) ? folder->mem : &sfs_main_mem;
+
+        if ((folder->page_len == 0) || (folder->folder_len % folder->page_len != 0))
+        {
+            NRF_LOG_INFO("Folder %d length 0x%x not multiple of page length", i, folder->folder_len);
+            return SFS_STATUS_ADDRESS_ALIGNMENT_ERROR;
+        }
+
+        if ((folder->start_address + folder->folder_len) > mem->mem_len)
+        {
+            NRF_LOG_INFO("Folder %d at 0x%x is out of memory", i, folder->start_address);
+            return SFS_STATUS_NO_SPACE;
+        }
+
+        if (folder->page_len > sfs_param->gc_len)
+        {
+            NRF_LOG_INFO("Folder %d page length is larger than garbage collection", i);
+            return SFS_STATUS_NO_SPACE;
+        }
+
+        if ((mem == &sfs_main_mem) && (folder->start_address < (sfs_param->gc_address + sfs_param->gc_len))
+                && (sfs_param->gc_address < (folder->start_address + folder->folder_len)))
+        {
+            NRF_LOG_INFO("Folder %d overlaps garbage collection", i);
+            return SFS_STATUS_NO_SPACE;
+        }
+
+        for (j = 0; j < i; j++)
+        {
+            if ((folder->mem == sfs_param->sfs_folder_info[j].mem)
+                    && (folder->start_address < (sfs_param->sfs_folder_info[j].start_address + sfs_param->sfs_folder_info[j].folder_len))
+                    && (sfs_param->sfs_folder_info[j].start_address < (folder->start_address + folder->folder_len)))
+            {
+                NRF_LOG_INFO("Folder %d overlaps folder %d", i, j);
+                return SFS_STATUS_NO_SPACE;
+            }
+        }
+    }
+
+    return SFS_STATUS_SUCCESS;
+}
+
 sfs_status_t sfs_init(sfs_parameters_t *sfs_parameters)
 {
     uint8_t i;
@@ -795,6 +1116,17 @@ sfs_status_t sfs_init(sfs_parameters_t *sfs_parameters)
 
     sfs_param = sfs_parameters;
 
+    sfs_main_mem.mem_write = sfs_param->mem_write;
+    sfs_main_mem.mem_update = sfs_param->mem_update;
+    sfs_main_mem.mem_read = sfs_param->mem_read;
+    sfs_main_mem.mem_erase = sfs_param->mem_erase;
+    sfs_main_mem.mem_map = sfs_param->mem_map;
+    sfs_main_mem.mem_len = sfs_param->mem_len;
+    sfs_main_mem.word_writes = sfs_param->word_writes;
+    sfs_mem = &sfs_main_mem;
+
+    status = sfs_check_folders();
+
     /** Initialize last written_address */
     for (i = 0; (i < sfs_param->nbr_folders) && (status == SFS_STATUS_SUCCESS); i++)
     {
@@ -808,7 +1140,6 @@ sfs_status_t sfs_init(sfs_parameters_t *sfs_parameters)
             return SFS_STATUS_ADDRESS_ALIGNMENT_ERROR;
         }
     }
-    /* TODO: perform address check for data and garbage collection address */
     return status;
 }
 
@@ -825,15 +1156,22 @@ sfs_status_t sfs_uninit(void)
 }
 
 /** Only for debugging */
-sfs_status_t sfs_last_written_info(uint32_t file_id, uint32_t *address, sfs_file_header_t *header)
+sfs_status_t sfs_last_written_info(uint32_t file_id, uint32_t *address, uint32_t *end_address, sfs_file_header_t *header)
 {
     uint16_t folder_id = FOLDER(file_id) - 1;
 
+    if (folder_id >= sfs_param->nbr_folders)
+    {
+        return SFS_STATUS_WRONG_FOLDER;
+    }
+
+    sfs_select_folder_mem(folder_id);
     *address = sfs_param->sfs_folder_info[folder_id].last_written_address;
-    if (sfs_param->mem_read(*address, (uint8_t*)header, sizeof(sfs_file_header_t)) != 0)
+    if (sfs_read_file_header(sfs_mem, *address, header) != 0)
     {
         return SFS_STATUS_DRIVER_ERROR;
     }
+    *end_address = *address + sfs_file_len(header->data_len);
 
     return SFS_STATUS_SUCCESS;
 }
@@ -1,89 +1,448 @@
 #include <stdlib.h>
 #include <string.h>
 #include "boards.h"
-#include "app_timer.h"
 #include "sdk_config.h"
 #include "nrf_gpio.h"
 #include "nrf_delay.h"
 #include "nrf_error.h"
 #include "app_error.h"
 #include "spi.h"
-#include "nrf_drv_spi.h"
+#include "nrfx_spim.h"
+#include "nrf_spim.h"
+#include "nrf_timer.h"
+#include "nrf_ppi.h"
 
 /* SPI timeout period : 0.5 seconds */
-#define SPI_TX_CHECK_PERIOD_MS   500
+#define SPI_TX_CHECK_PERIOD_US   500000
 
-#define SPI_INSTANCE  0 /**< SPI instance index. */
-static const nrf_drv_spi_t m_spi = NRF_DRV_SPI_INSTANCE(SPI_INSTANCE); /**< SPI instance. */
+/* SPIM3 is the only instance with a hardware chip select */
+#define SPI_INSTANCE  3 /**< SPI instance index. */
+static const nrfx_spim_t m_spim = NRFX_SPIM_INSTANCE(SPI_INSTANCE); /**< SPI instance. */
 static volatile bool m_spi_xfer_done; /**< Flag used to indicate that SPI instance completed the transfer. */
 
+/** Timer and PPI channels of the status reads while polling: the timer compare starts
+ *  a read, the END of the read stops and clears the timer */
+#ifndef SPI_POLL_TIMER
+#define SPI_POLL_TIMER           NRF_TIMER1
+#endif
+#ifndef SPI_POLL_PPI_CHANNEL
+#define SPI_POLL_PPI_CHANNEL     NRF_PPI_CHANNEL0
+#endif
+#ifndef SPI_POLL_STOP_PPI_CHANNEL
+#define SPI_POLL_STOP_PPI_CHANNEL NRF_PPI_CHANNEL3
+#endif
+/** Free running 1 MHz timer of the transfer timeouts and of the latencies */
+#ifndef SPI_TIME_TIMER
+#define SPI_TIME_TIMER             NRF_TIMER2
+#define SPI_TIME_TIMER_IRQn        TIMER2_IRQn
+#define SPI_TIME_TIMER_IRQHandler  TIMER2_IRQHandler
+#endif
+#define SPI_TIME_TIMER_IRQ_PRIORITY  6
+/** Chip select setup and hold time in 64 MHz periods */
+#define SPI_CS_DURATION          4
+/** Shortest poll period, a status read must end before the next one starts */
+#define SPI_POLL_MIN_PERIOD_US   20
+
 static bool m_spi_init_done = false;
 static volatile uint8_t m_spi_txrx_timeout = 0;
+/** Chip select pin driven by the SPIM */
+static uint32_t m_cs_pin = SPI_nCS_PIN;
+
+/** nRF52840 anomaly 198: SPIM3 may send corrupted data when another EasyDMA master or
+ *  the CPU accesses the RAM block of its transmit buffer. The transmit buffers are in a
+ *  RAM block of their own (see the linker script) and the transmitted bytes are copied there */
+#define SPI_TX_SECTION __attribute__((section(".spim3_tx")))
+static uint8_t m_tx_buffer[SPI_TX_MAX_LEN] SPI_TX_SECTION;
+
+/** Status polling state, the buffers are read by EasyDMA */
+static volatile bool m_poll_active;
+static volatile uint32_t m_poll_count;
+static uint8_t m_poll_tx[SPI_POLL_MAX_CMD_LEN] SPI_TX_SECTION;
+static uint8_t m_poll_rx[SPI_POLL_MAX_CMD_LEN];
+static size_t m_poll_len;
+static uint8_t m_poll_mask;
+
+static spi_stats_t m_stats;
+
+/** Frequency of each transfer phase in MHz and the phase in use */
+static uint32_t m_frequency_mhz[SPI_NBR_PHASES] = { SPI_COMMAND_FREQUENCY_MHZ, SPI_DATA_FREQUENCY_MHZ };
+static spi_phase_t m_phase = SPI_PHASE_COMMAND;
 
-/* Create timer */
-APP_TIMER_DEF(m_spi_txrx_timer);
+/**@brief Convert a frequency in MHz to the SPIM setting
+ *
+ * @return True when the frequency is supported
+ */
+static bool spi_frequency_get(uint32_t freq_mhz, nrf_spim_frequency_t *frequency)
+{
+    switch (freq_mhz)
+    {
+        case 1:
+            *frequency = NRF_SPIM_FREQ_1M;
+            break;
+        case 2:
+            *frequency = NRF_SPIM_FREQ_2M;
+            break;
+        case 4:
+            *frequency = NRF_SPIM_FREQ_4M;
+            break;
+        case 8:
+            *frequency = NRF_SPIM_FREQ_8M;
+            break;
+        case 16:
+            *frequency = NRF_SPIM_FREQ_16M;
+            break;
+        case 32:
+            *frequency = NRF_SPIM_FREQ_32M;
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+/**@brief Use the high drive outputs above 8 MHz, the standard drive rise time is too long */
+static void spi_pins_drive_set(void)
+{
+    nrf_gpio_pin_drive_t drive = NRF_GPIO_PIN_S0S1;
+
+    if ((m_frequency_mhz[SPI_PHASE_COMMAND] > 8) || (m_frequency_mhz[SPI_PHASE_DATA] > 8))
+    {
+        drive = NRF_GPIO_PIN_H0H1;
+    }
+
+    /* SCK input buffer must stay connected */
+    nrf_gpio_cfg(SPI_CLK_PIN, NRF_GPIO_PIN_DIR_OUTPUT, NRF_GPIO_PIN_INPUT_CONNECT, NRF_GPIO_PIN_NOPULL, drive, NRF_GPIO_PIN_NOSENSE);
+    nrf_gpio_cfg(SPI_MOSI_PIN, NRF_GPIO_PIN_DIR_OUTPUT, NRF_GPIO_PIN_INPUT_DISCONNECT, NRF_GPIO_PIN_NOPULL, drive, NRF_GPIO_PIN_NOSENSE);
+}
+
+/**@brief Stop the timer starting the status reads */
+static void spi_poll_stop(void)
+{
+    /* Cleared first, the END handler does not restart the timer anymore */
+    m_poll_active = false;
+    nrf_ppi_channel_disable(SPI_POLL_PPI_CHANNEL);
+    nrf_ppi_channel_disable(SPI_POLL_STOP_PPI_CHANNEL);
+    nrf_timer_task_trigger(SPI_POLL_TIMER, NRF_TIMER_TASK_STOP);
+}
 
 /**
  * @brief SPI user event handler.
  * @param event
  */
-static void spi_event_handler(const nrf_drv_spi_evt_t * p_event, void * p_context)
+static void spi_event_handler(const nrfx_spim_evt_t * p_event, void * p_context)
 {
+    if (m_poll_active)
+    {
+        m_poll_count++;
+        /* The status is the last byte received, keep polling while it is busy */
+        if ((m_poll_rx[m_poll_len - 1] & m_poll_mask) != 0)
+        {
+            /* The END stopped the timer, the next read starts a period from now */
+            nrf_timer_task_trigger(SPI_POLL_TIMER, NRF_TIMER_TASK_START);
+            return;
+        }
+        spi_poll_stop();
+    }
     m_spi_xfer_done = true;
 }
 
-static void spi_txrx_timer_handler(void *p_context)
+/**@brief Connect the hardware chip select to a pin, PSEL is only written while the SPIM is disabled */
+static void spi_csn_connect(uint32_t pin)
 {
-    UNUSED_PARAMETER(p_context);
-    m_spi_txrx_timeout = 1;
+    nrf_spim_disable(m_spim.p_reg);
+    nrf_spim_csn_configure(m_spim.p_reg, pin, NRF_SPIM_CSN_POL_LOW, SPI_CS_DURATION);
+    nrf_spim_enable(m_spim.p_reg);
 }
 
-ret_code_t spi_txrx(const uint8_t *tx_buff, size_t tx_len, uint8_t *rx_buff, size_t rx_len)
+/**@brief Arm the timeout, a single compare of the free running timer */
+static void spi_timeout_start(uint32_t timeout_us)
+{
+    m_spi_txrx_timeout = 0;
+    nrf_timer_event_clear(SPI_TIME_TIMER, NRF_TIMER_EVENT_COMPARE1);
+    nrf_timer_cc_write(SPI_TIME_TIMER, NRF_TIMER_CC_CHANNEL1, spi_time_us() + timeout_us);
+    nrf_timer_int_enable(SPI_TIME_TIMER, NRF_TIMER_INT_COMPARE1_MASK);
+}
+
+static void spi_timeout_stop(void)
+{
+    nrf_timer_int_disable(SPI_TIME_TIMER, NRF_TIMER_INT_COMPARE1_MASK);
+}
+
+void SPI_TIME_TIMER_IRQHandler(void)
+{
+    if (nrf_timer_event_check(SPI_TIME_TIMER, NRF_TIMER_EVENT_COMPARE1))
+    {
+        nrf_timer_event_clear(SPI_TIME_TIMER, NRF_TIMER_EVENT_COMPARE1);
+        nrf_timer_int_disable(SPI_TIME_TIMER, NRF_TIMER_INT_COMPARE1_MASK);
+        m_spi_txrx_timeout = 1;
+    }
+}
+
+uint32_t spi_time_us(void)
+{
+    nrf_timer_task_trigger(SPI_TIME_TIMER, NRF_TIMER_TASK_CAPTURE2);
+    return nrf_timer_cc_read(SPI_TIME_TIMER, NRF_TIMER_CC_CHANNEL2);
+}
+
+void spi_get_stats(spi_stats_t *stats)
+{
+    *stats = m_stats;
+}
+
+void spi_clear_stats(void)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+ret_code_t spi_txrx_start(const uint8_t *tx_buff, size_t tx_len, uint8_t *rx_buff, size_t rx_len)
 {
     ret_code_t err_code;
 
+    if (tx_len > SPI_TX_MAX_LEN)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
     const nrfx_spim_xfer_desc_t spim_xfer_desc =
     {
-        .p_tx_buffer = tx_buff,
+        .p_tx_buffer = m_tx_buffer,
         .tx_length = tx_len,
         .p_rx_buffer = rx_buff,
         .rx_length = rx_len
     };
 
+    if (tx_len > 0)
+    {
+        memcpy(m_tx_buffer, tx_buff, tx_len);
+    }
     m_spi_xfer_done = false;
-    app_timer_start(m_spi_txrx_timer, APP_TIMER_TICKS(SPI_TX_CHECK_PERIOD_MS), NULL);
+    spi_timeout_start(SPI_TX_CHECK_PERIOD_US);
+
+    m_stats.transfers++;
+    m_stats.bytes += (tx_len > rx_len) ? tx_len : rx_len;
+    err_code = nrfx_spim_xfer(&m_spim, &spim_xfer_desc, 0);
+    if (err_code != NRF_SUCCESS)
+    {
+        spi_timeout_stop();
+        /* Nothing to wait for */
+        m_spi_xfer_done = true;
+    }
+
+    return err_code;
+}
 
-    err_code = nrfx_spim_xfer(&m_spi.u.spim, &spim_xfer_desc, 0);
+ret_code_t spi_txrx_wait(void)
+{
+    ret_code_t err_code = NRF_SUCCESS;
 
+    /* Sleep till the END or the timeout interrupt */
     while ((m_spi_xfer_done == false) && (m_spi_txrx_timeout == 0))
-        ;
+    {
+        __WFE();
+    }
 
-    app_timer_stop(m_spi_txrx_timer);
+    spi_timeout_stop();
 
     if (m_spi_txrx_timeout == 1)
     {
         m_spi_txrx_timeout = 0;
-        err_code = (err_code == NRF_SUCCESS) ? NRF_ERROR_TIMEOUT : err_code;
+        err_code = (m_spi_xfer_done == false) ? NRF_ERROR_TIMEOUT : NRF_SUCCESS;
+        m_stats.timeouts += (err_code == NRF_ERROR_TIMEOUT) ? 1 : 0;
+    }
+
+    return err_code;
+}
+
+ret_code_t spi_txrx(const uint8_t *tx_buff, size_t tx_len, uint8_t *rx_buff, size_t rx_len)
+{
+    ret_code_t err_code;
+
+    err_code = spi_txrx_start(tx_buff, tx_len, rx_buff, rx_len);
+    if (err_code == NRF_SUCCESS)
+    {
+        err_code = spi_txrx_wait();
     }
 
     return err_code;
 }
 
+ret_code_t spi_poll_status(const uint8_t *cmd, size_t cmd_len, uint8_t mask, uint32_t period_us, uint32_t timeout_ms,
+                           uint32_t *nbr_polls)
+{
+    ret_code_t err_code;
+    uint32_t start_us;
+    bool timed_out;
+
+    if ((cmd_len == 0) || (cmd_len > SPI_POLL_MAX_CMD_LEN))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    const nrfx_spim_xfer_desc_t spim_xfer_desc =
+    {
+        .p_tx_buffer = m_poll_tx,
+        .tx_length = cmd_len,
+        .p_rx_buffer = m_poll_rx,
+        .rx_length = cmd_len
+    };
+
+    spi_set_phase(SPI_PHASE_COMMAND);
+    memcpy(m_poll_tx, cmd, cmd_len);
+    m_poll_len = cmd_len;
+    m_poll_mask = mask;
+    m_poll_count = 0;
+    m_spi_xfer_done = false;
+
+    /* The timer starts a status read a period after the previous one through PPI, the CPU only
+     * wakes to check the status. The END stops the timer in hardware, no read is started after
+     * the last one before the handler ran. */
+    nrf_timer_mode_set(SPI_POLL_TIMER, NRF_TIMER_MODE_TIMER);
+    nrf_timer_bit_width_set(SPI_POLL_TIMER, NRF_TIMER_BIT_WIDTH_32);
+    nrf_timer_frequency_set(SPI_POLL_TIMER, NRF_TIMER_FREQ_1MHz);
+    nrf_timer_cc_write(SPI_POLL_TIMER, NRF_TIMER_CC_CHANNEL0, (period_us < SPI_POLL_MIN_PERIOD_US) ? SPI_POLL_MIN_PERIOD_US : period_us);
+    nrf_timer_shorts_enable(SPI_POLL_TIMER, NRF_TIMER_SHORT_COMPARE0_CLEAR_MASK);
+    nrf_timer_task_trigger(SPI_POLL_TIMER, NRF_TIMER_TASK_CLEAR);
+    nrf_ppi_channel_endpoint_setup(SPI_POLL_PPI_CHANNEL,
+                                   (uint32_t) nrf_timer_event_address_get(SPI_POLL_TIMER, NRF_TIMER_EVENT_COMPARE0),
+                                   nrfx_spim_start_task_get(&m_spim));
+    nrf_ppi_channel_and_fork_endpoint_setup(SPI_POLL_STOP_PPI_CHANNEL,
+                                            nrfx_spim_end_event_get(&m_spim),
+                                            (uint32_t) nrf_timer_task_address_get(SPI_POLL_TIMER, NRF_TIMER_TASK_STOP),
+                                            (uint32_t) nrf_timer_task_address_get(SPI_POLL_TIMER, NRF_TIMER_TASK_CLEAR));
+
+    /* Same buffers for every read, the handler is called at each END */
+    err_code = nrfx_spim_xfer(&m_spim, &spim_xfer_desc, NRFX_SPIM_FLAG_HOLD_XFER | NRFX_SPIM_FLAG_REPEATED_XFER);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    m_poll_active = true;
+    start_us = spi_time_us();
+    spi_timeout_start(timeout_ms * 1000);
+    nrf_ppi_channel_enable(SPI_POLL_PPI_CHANNEL);
+    nrf_ppi_channel_enable(SPI_POLL_STOP_PPI_CHANNEL);
+    /* First read right away, the handler starts the timer */
+    nrf_spim_task_trigger(m_spim.p_reg, NRF_SPIM_TASK_START);
+
+    while ((m_spi_xfer_done == false) && (m_spi_txrx_timeout == 0))
+    {
+        __WFE();
+    }
+
+    spi_timeout_stop();
+    timed_out = m_poll_active;
+    if (timed_out)
+    {
+        /* Timeout, stop the read in progress and drop its END, its handler would end the next transfer */
+        spi_poll_stop();
+        nrfx_spim_abort(&m_spim);
+        nrf_spim_event_clear(m_spim.p_reg, NRF_SPIM_EVENT_END);
+        NVIC_ClearPendingIRQ(nrfx_get_irq_number(m_spim.p_reg));
+    }
+
+    if (nbr_polls != NULL)
+    {
+        *nbr_polls = m_poll_count;
+    }
+    m_stats.polls += m_poll_count;
+    m_stats.busy_wait_us += spi_time_us() - start_us;
+
+    m_spi_txrx_timeout = 0;
+    if (timed_out)
+    {
+        m_stats.timeouts++;
+        return NRF_ERROR_TIMEOUT;
+    }
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t spi_set_frequency(spi_phase_t phase, uint32_t freq_mhz)
+{
+    nrf_spim_frequency_t frequency;
+
+    if ((phase >= SPI_NBR_PHASES) || !spi_frequency_get(freq_mhz, &frequency))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_frequency_mhz[phase] = freq_mhz;
+    spi_pins_drive_set();
+    if (phase == m_phase)
+    {
+        nrf_spim_frequency_set(m_spim.p_reg, frequency);
+    }
+
+    return NRF_SUCCESS;
+}
+
+uint32_t spi_get_frequency(spi_phase_t phase)
+{
+    return (phase < SPI_NBR_PHASES) ? m_frequency_mhz[phase] : 0;
+}
+
+void spi_set_phase(spi_phase_t phase)
+{
+    nrf_spim_frequency_t frequency;
+
+    /* Only written on a change, most transfers stay in the same phase */
+    if ((phase != m_phase) && (phase < SPI_NBR_PHASES) && spi_frequency_get(m_frequency_mhz[phase], &frequency))
+    {
+        m_phase = phase;
+        nrf_spim_frequency_set(m_spim.p_reg, frequency);
+    }
+}
+
+void spi_select(uint32_t cs_pin)
+{
+    if (cs_pin != m_cs_pin)
+    {
+        m_cs_pin = cs_pin;
+        spi_csn_connect(cs_pin);
+    }
+}
+
+void spi_cs_hold(bool hold)
+{
+    if (hold)
+    {
+        /* The GPIO drives the pin while the SPIM does not */
+        nrf_gpio_pin_clear(m_cs_pin);
+        spi_csn_connect(NRF_SPIM_PIN_NOT_CONNECTED);
+    }
+    else
+    {
+        nrf_gpio_pin_set(m_cs_pin);
+        spi_csn_connect(m_cs_pin);
+    }
+}
+
 void spi_init(void)
 {
     if (m_spi_init_done == false)
     {
-        nrf_drv_spi_config_t spi_config = NRF_DRV_SPI_DEFAULT_CONFIG;
+        nrfx_spim_config_t spi_config = NRFX_SPIM_DEFAULT_CONFIG;
 
         spi_config.miso_pin = SPI_MISO_PIN;
         spi_config.mosi_pin = SPI_MOSI_PIN;
         spi_config.sck_pin = SPI_CLK_PIN;
-        spi_config.frequency = NRF_DRV_SPI_FREQ_8M;
+        spi_config.ss_pin = m_cs_pin;
+        spi_config.use_hw_ss = true;
+        spi_config.ss_duration = SPI_CS_DURATION;
+        spi_frequency_get(m_frequency_mhz[m_phase], &spi_config.frequency);
 
-        nrf_drv_spi_init(&m_spi, &spi_config, spi_event_handler, NULL);
+        nrfx_spim_init(&m_spim, &spi_config, spi_event_handler, NULL);
+        spi_pins_drive_set();
 
-        /* Create timer for timeout */
-        app_timer_create(&m_spi_txrx_timer, APP_TIMER_MODE_SINGLE_SHOT, spi_txrx_timer_handler);
+        /* Free running timer for the timeouts, cheaper than an app_timer per transfer */
+        nrf_timer_mode_set(SPI_TIME_TIMER, NRF_TIMER_MODE_TIMER);
+        nrf_timer_bit_width_set(SPI_TIME_TIMER, NRF_TIMER_BIT_WIDTH_32);
+        nrf_timer_frequency_set(SPI_TIME_TIMER, NRF_TIMER_FREQ_1MHz);
+        NVIC_SetPriority(SPI_TIME_TIMER_IRQn, SPI_TIME_TIMER_IRQ_PRIORITY);
+        NVIC_ClearPendingIRQ(SPI_TIME_TIMER_IRQn);
+        NVIC_EnableIRQ(SPI_TIME_TIMER_IRQn);
+        nrf_timer_task_trigger(SPI_TIME_TIMER, NRF_TIMER_TASK_START);
 
         m_spi_init_done = true;
     }
@@ -93,7 +452,7 @@ void spi_uninit(void)
 {
     if (m_spi_init_done == true)
     {
-        nrf_drv_spi_uninit(&m_spi);
+        nrfx_spim_uninit(&m_spim);
         m_spi_init_done = false;
     }
 }
@@ -10,24 +10,124 @@
 #include "app_error.h"
 #include "nrf_gpio.h"
 #include "ext_mem_driver.h"
+#include "flash_backend.h"
 #include "simple_fs.h"
+#include "large_file_storage.h"
 #include "storage_mngr.h"
 
+/** Memory used by the storage engines, flash_backend_qspi maps the files in the XIP region */
+#ifndef STORAGE_BACKEND
+#define STORAGE_BACKEND flash_backend_nor
+#endif
+
+/** Optional memory of the CONFIG folder, e.g. flash_backend_nvmc to read it in place from
+ *  the internal flash. The firmware defines it in flag_settings.mk, the folder stays in
+ *  STORAGE_BACKEND when it is not defined.
+ */
+//#define STORAGE_CONFIG_BACKEND flash_backend_nvmc
+
+/** Copy buffer of sfs_map_file for the folders that are not memory mapped */
+#ifndef STORAGE_MAP_BUFFER_LEN
+#define STORAGE_MAP_BUFFER_LEN 1024
+#endif
+
+/** Number of pages of the CONFIG folder in STORAGE_CONFIG_BACKEND */
+#ifndef STORAGE_CONFIG_NBR_PAGES
+#define STORAGE_CONFIG_NBR_PAGES 4
+#endif
+
+/** simple_fs relocates a file on the program failures of the memory driver */
+STATIC_ASSERT(SFS_MEM_PROGRAM_FAILED == EXT_MEM_ERROR_PROGRAM_FAILED);
+
 static sfs_parameters_t sfs_parameters;
 static sfs_folder_info_t sfs_folder_info[TOTAL_NBR_FOLDER];
+static uint8_t map_buffer[STORAGE_MAP_BUFFER_LEN];
+#ifdef STORAGE_CONFIG_BACKEND
+static sfs_mem_t config_mem;
+#endif
+
+#ifdef STORAGE_CONFIG_BACKEND
+/**@brief Move the CONFIG folder to its own backend */
+static sfs_status_t init_config_backend(void)
+{
+    const flash_backend_t *backend = &STORAGE_CONFIG_BACKEND;
+    flash_backend_caps_t caps;
+    uint32_t page_len;
+
+    if (backend->init() != NRF_SUCCESS)
+    {
+        return SFS_STATUS_DRIVER_ERROR;
+    }
+    backend->get_caps(&caps);
+
+    /** Folder pages are erased one at a time, the GC page must hold one page */
+    page_len = SFS_SMALL(ADDRESS_ALIGNMENT, caps.size);
+    if ((page_len % caps.erase_size) != 0)
+    {
+        page_len = caps.erase_size;
+    }
+
+    config_mem.mem_write = backend->write;
+    config_mem.mem_update = backend->update;
+    config_mem.mem_read = backend->read;
+    config_mem.mem_erase = backend->erase;
+    config_mem.mem_map = backend->map;
+    config_mem.mem_len = caps.size;
+    /** simple_fs writes a word per status on a memory limiting the writes of a word */
+    config_mem.word_writes = caps.word_writes;
+
+    sfs_folder_info[CONFIG_FOLDER].mem = &config_mem;
+    sfs_folder_info[CONFIG_FOLDER].page_len = page_len;
+    sfs_folder_info[CONFIG_FOLDER].folder_len = SFS_SMALL(page_len * STORAGE_CONFIG_NBR_PAGES, (caps.size / page_len) * page_len);
+    sfs_folder_info[CONFIG_FOLDER].start_address = 0;
+    NRF_LOG_INFO("Config folder on %s backend, %d bytes", backend->name, sfs_folder_info[CONFIG_FOLDER].folder_len);
+
+    return SFS_STATUS_SUCCESS;
+}
+#endif
 
 sfs_status_t init_storage (void)
 {
-    ext_mem_init();
+    const flash_backend_t *backend = &STORAGE_BACKEND;
+    flash_backend_caps_t caps;
+    uint32_t mem_len;
+    uint32_t data_pages;
+    uint32_t max_data_pages;
+
+    if (backend->init() != NRF_SUCCESS)
+    {
+        return SFS_STATUS_DRIVER_ERROR;
+    }
+    backend->get_caps(&caps);
+    /** large_file_storage rewrites its status bytes in place between erases */
+    if (caps.word_writes != 0)
+    {
+        NRF_LOG_ERROR("%s backend limits the writes of a word", backend->name);
+        return SFS_STATUS_DRIVER_ERROR;
+    }
+    mem_len = caps.size;
+    NRF_LOG_INFO("Storage on %s backend, size %d bytes", backend->name, mem_len);
+
+    /** The folders and the large files have a fixed layout */
+    if (large_file_storage_init(backend) != MEAS_STORE_STATUS_SUCCESS)
+    {
+        return SFS_STATUS_NO_SPACE;
+    }
 
     /** Function to write external memory */
-    sfs_parameters.mem_write = memory_write;
+    sfs_parameters.mem_write = backend->write;
+    /** Function to update the status bytes in external memory */
+    sfs_parameters.mem_update = backend->update;
     /** Function to read external memory */
-    sfs_parameters.mem_read = memory_read;
+    sfs_parameters.mem_read = backend->read;
     /** Function to page erase external memory */
-    sfs_parameters.mem_erase = memory_erase;
+    sfs_parameters.mem_erase = backend->erase;
+    /** Function to map external memory, NULL when it is not memory mapped */
+    sfs_parameters.mem_map = backend->map;
     /** Total size of the memory allocation */
-    sfs_parameters.mem_len = MEMORY_SIZE;
+    sfs_parameters.mem_len = mem_len;
+    /** Writes of a word allowed between two erases */
+    sfs_parameters.word_writes = caps.word_writes;
     /** Address for the garbage collection */
     sfs_parameters.gc_address = MEM_START_ADDRESS;
     /** Length of the garbage collection */
@@ -45,16 +145,37 @@ sfs_status_t init_storage (void)
     sfs_folder_info[LOG_FOLDER].start_address = (sfs_folder_info[CONFIG_FOLDER].start_address + sfs_folder_info[CONFIG_FOLDER].folder_len);
 
     sfs_folder_info[DATA_FOLDER].page_len = MEM_SECTOR_SIZE;
-    sfs_folder_info[DATA_FOLDER].folder_len = sfs_folder_info[DATA_FOLDER].page_len;
     sfs_folder_info[DATA_FOLDER].start_address = (sfs_folder_info[LOG_FOLDER].start_address + sfs_folder_info[LOG_FOLDER].folder_len);
+    /** One page per Mbyte of memory, till the large file meta data */
+    data_pages = mem_len / MEMORY_SIZE;
+    max_data_pages = (META_DATA_START_ADDRESS - sfs_folder_info[DATA_FOLDER].start_address) / sfs_folder_info[DATA_FOLDER].page_len;
+    if (data_pages > max_data_pages)
+    {
+        data_pages = max_data_pages;
+    }
+    if (data_pages == 0)
+    {
+        data_pages = 1;
+    }
+    sfs_folder_info[DATA_FOLDER].folder_len = sfs_folder_info[DATA_FOLDER].page_len * data_pages;
+
+#ifdef STORAGE_CONFIG_BACKEND
+    /** The LOG and DATA folders keep their address in the main memory */
+    if (init_config_backend() != SFS_STATUS_SUCCESS)
+    {
+        return SFS_STATUS_DRIVER_ERROR;
+    }
+#endif
 
     sfs_parameters.sfs_folder_info = sfs_folder_info;
+    sfs_parameters.map_buffer = map_buffer;
+    sfs_parameters.map_buffer_len = sizeof(map_buffer);
 
     return sfs_init(&sfs_parameters);
 }
 
 sfs_status_t uninit_storage (void)
 {
-    free(sfs_folder_info);
-    return SFS_STATUS_SUCCESS;
+    /** The folder info is static, it is not freed */
+    return sfs_uninit();
 }
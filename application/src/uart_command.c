@@ -11,58 +11,163 @@
 #include "nrf_log.h"
 #include "nrf_log_ctrl.h"
 #include "nrf_log_default_backends.h"
-#include "nrf_drv_uart.h"
 #include "nrf_delay.h"
 
 #include "app_timer.h"
 #include "boards.h"
-#include "app_uart.h"
 #include "crc16.h"
 
 #include "uart_command.h"
+#include "uart_dma.h"
+#include "uart_frame.h"
 #include "ext_mem_driver.h"
+#include "spi.h"
 #include "simple_fs.h"
 #include "systick.h"
 #include "large_file_storage.h"
 
 /** When UART is used for communication with the host do not use flow control.*/
-#define UART_HWFC NRF_UART_HWFC_DISABLED
+#define UART_HWFC false
+/** Baud rate at start up and after a failed negotiation */
+#define UART_BAUDRATE NRF_UARTE_BAUDRATE_115200
 
-/** UART Special characters used in packet framing */
-#define STX 0x02
-#define ETX 0x03
-#define DLE 0x04
+/** Time for the host to test the link at a negotiated baud rate */
+#ifndef UART_CONFIG_CONFIRM_MS
+#define UART_CONFIG_CONFIRM_MS 1000
+#endif
 
-/** Optimal to have half of the maximum packet length (4096 bytes) */
-#define UART_RX_FIFO_SIZE (1024 * 2)
-#define UART_TX_FIFO_SIZE (1024 * 2)
+/** Commands received and not executed yet, each one is a credit of the host window */
+#ifndef UART_CMD_QUEUE_LEN
+#define UART_CMD_QUEUE_LEN 3
+#endif
+/** Bytes the receive buffers hold while a command is executed, one buffer may be in use by the parser */
+#define UART_RX_WINDOW_BYTES ((UART_DMA_RX_NBR_BUFFERS - 1) * UART_DMA_RX_BUFFER_LEN)
+/** Largest data of an upload frame, the frame with its header and one argument fits the
+ *  receive window when every byte is escaped and STX/ETX are added */
+#define UART_UPLOAD_DATA_MAX_LEN (((UART_RX_WINDOW_BYTES - 2) / 2) - (4 * sizeof(uint16_t) + sizeof(uint32_t)))
+
+/** Largest data frame of a stream, it is also the default */
+#ifndef UART_STREAM_CHUNK_LEN
+#define UART_STREAM_CHUNK_LEN 1024
+#endif
 
-/** Should be more than the packet length (4096 bytes) */
-#define UART_RX_BUFFER_SIZE (1024 * 5)
-#define UART_TX_BUFFER_SIZE (1024 * 5)
+/** Upload data frames acknowledged together, a frame is also acknowledged when no
+ *  other command is queued so that the host never waits for its credits */
+#ifndef UART_UPLOAD_ACK_FRAMES
+#define UART_UPLOAD_ACK_FRAMES 2
+#endif
 
-/**
- * @brief UART data receive states.
- */
-typedef enum
-{
-    UART_RX_STATE_NONE = 0, UART_RX_STATE_BEGIN, UART_RX_STATE_PROGRESS
-} uart_rx_state_t;
+/** Command, number of arguments and payload length of a batch item, followed by the
+ *  arguments and the payload. The response item also holds the status after the command */
+#define UART_BATCH_ITEM_HEADER_SIZE (3 * sizeof(uint16_t))
+#define UART_BATCH_RESP_HEADER_SIZE (4 * sizeof(uint16_t))
+
+/** Response code of a command answered later, nothing is sent */
+#define UART_RESP_NONE 0xFFFF
+
+/** UART Special characters used in packet framing */
+#define STX UART_FRAME_STX
+#define ETX UART_FRAME_ETX
+#define DLE UART_FRAME_DLE
+
+/** CRC, message ID, response, number of arguments and arguments */
+#define UART_HEADER_SIZE (4 * sizeof(uint16_t) + MAX_NBR_ARGU * sizeof(uint32_t))
+/** Largest frame, unescaped */
+#define UART_FRAME_SIZE (UART_HEADER_SIZE + MAX_PAYLOAD_LEN)
+/** A frame is executed after room for a response header longer than the request one */
+#define UART_SLOT_SIZE (UART_HEADER_SIZE + UART_FRAME_SIZE)
+/** The executed frame and the frames the host window lets follow it */
+#define UART_RX_BUFFER_SIZE (UART_SLOT_SIZE + UART_RX_WINDOW_BYTES)
 
 typedef void (*cmd_function_t)(uart_cmd_t *p_uart_cmd);
 static cmd_function_t get_cmd_function(uart_cmd_t *p_uart_cmd);
-static void parse_cmd(uint16_t rx_data_len);
-static void clear_cmd(void);
-static uart_cmd_t m_uart_cmd;
+static uint16_t parse_cmd(uart_cmd_t *p_uart_cmd, uint8_t *frame, uint16_t rx_data_len, uint16_t crc16);
+static void clear_cmd(uart_cmd_t *p_uart_cmd);
+/** Ring of received commands, executed in order. The command after the queued ones is
+ *  parsed from the frame just received, it is answered BUSY when the queue is full.
+ *  The payload of a command is a view into its frame, the response is built in place */
+static uart_cmd_t m_cmd_queue[UART_CMD_QUEUE_LEN + 1];
+/** The queued frames follow each other after UART_HEADER_SIZE bytes, the frame being
+ *  received comes next. While the oldest one executes the others wait at the end of
+ *  the buffer, its response grows in place up to them */
 static uint8_t m_rx_buffer[UART_RX_BUFFER_SIZE];
-static uint8_t m_tx_buffer[UART_TX_BUFFER_SIZE];
-static uart_rx_state_t m_uart_rx_state = UART_RX_STATE_NONE;
-static bool m_data_ready_to_send = false;
-static bool m_crc_match_status = true;
+static uint16_t m_cmd_len[UART_CMD_QUEUE_LEN + 1];
+/** Parse status of each command, the command is executed when it is UART_RESP_NO_ERROR */
+static uint16_t m_cmd_status[UART_CMD_QUEUE_LEN + 1];
+static uint8_t m_cmd_head;
+static uint8_t m_cmd_count;
+/** Header of a response without payload */
+static uint8_t m_tx_buffer[UART_HEADER_SIZE];
+static uart_frame_t m_rx_frame;
+/** Negotiated configuration, applied after its response is sent */
+static bool m_uart_config_pending = false;
+static uint32_t m_uart_config_baudrate;
+static bool m_uart_config_hwfc;
+static uint32_t m_uart_config_confirm_ms;
+/** Negotiated framing, applied after its response is sent */
+static bool m_uart_framing_pending = false;
+static uart_frame_mode_t m_uart_framing_mode;
+/** Framing of the sent packets, the received ones are in m_rx_frame */
+static uart_frame_mode_t m_tx_frame_mode = UART_FRAME_MODE_DLE;
+/** COBS block not complete at the end of a write */
+static uint8_t m_cobs_block[UART_FRAME_COBS_BLOCK_LEN];
+static uint32_t m_cobs_len;
+/** Fall back to the start up configuration when no valid packet is received until then */
+static bool m_uart_config_unconfirmed = false;
+static uint32_t m_uart_config_deadline;
+
+/** File range pushed by COMMAND_SFS_STREAM, one frame per uart_data_handle call */
+typedef struct
+{
+    /** The range can be resent until the next stream */
+    bool valid;
+    uint16_t msg_id;
+    sfs_file_info_t file_info;
+    uint32_t offset;
+    uint32_t length;
+    uint32_t chunk_len;
+    uint32_t nbr_frames;
+    /** Next frame of the first pass, nbr_frames for the end frame */
+    uint32_t next_seq;
+    bool end_sent;
+    /** CRC of the range, computed by the first pass */
+    uint16_t crc16;
+    /** Frames requested again by the host */
+    uint32_t resend[MAX_NBR_ARGU];
+    uint8_t resend_count;
+} uart_stream_t;
+
+static uart_stream_t m_stream;
+
+/** File written by COMMAND_SFS_UPLOAD_DATA frames */
+typedef struct
+{
+    bool active;
+    uint32_t file_id;
+    uint32_t length;
+    /** Bytes written in order, acknowledged cumulatively */
+    uint32_t written;
+    /** Frames written since the last acknowledge */
+    uint32_t unacked;
+} uart_upload_t;
+
+static uart_upload_t m_upload;
+static uint8_t m_stream_buffer[UART_HEADER_SIZE + UART_STREAM_CHUNK_LEN];
+
+/** Item of a batch being executed */
+static uart_cmd_t m_batch_cmd;
 
 /********** Command Functions ********************/
 /**@brief Function to test UART communication */
 void cmd_uart_test(uart_cmd_t *p_uart_cmd);
+/**@brief Function to negotiate the baud rate and flow control */
+void cmd_uart_config(uart_cmd_t *p_uart_cmd);
+/**@brief Function to read the credits of the request window */
+void cmd_uart_window(uart_cmd_t *p_uart_cmd);
+/**@brief Function to negotiate the framing */
+void cmd_uart_framing(uart_cmd_t *p_uart_cmd);
+/**@brief Function to execute a list of commands */
+void cmd_batch(uart_cmd_t *p_uart_cmd);
 /**@brief Function to read data from a specific address */
 void cmd_ext_mem_read(uart_cmd_t *p_uart_cmd);
 /**@brief Function to write from a specific address */
@@ -71,6 +176,22 @@ void cmd_ext_mem_write(uart_cmd_t *p_uart_cmd);
 void cmd_ext_mem_page_erase(uart_cmd_t *p_uart_cmd);
 /**@brief Function to erase entire chip */
 void cmd_ext_mem_chip_erase(uart_cmd_t *p_uart_cmd);
+/**@brief Function to plan the erase of a range */
+void cmd_ext_mem_erase_plan(uart_cmd_t *p_uart_cmd);
+/**@brief Function to read the erase counters */
+void cmd_ext_mem_erase_stats(uart_cmd_t *p_uart_cmd);
+/**@brief Function to blank check a region */
+void cmd_ext_mem_blank_check(uart_cmd_t *p_uart_cmd);
+/**@brief Function to set the SPI frequencies */
+void cmd_ext_mem_spi_frequency(uart_cmd_t *p_uart_cmd);
+/**@brief Function to read the driver statistics */
+void cmd_ext_mem_stats(uart_cmd_t *p_uart_cmd);
+/**@brief Function to measure the wake time */
+void cmd_ext_mem_wake_benchmark(uart_cmd_t *p_uart_cmd);
+/**@brief Function to set the idle timeout and read the power counters */
+void cmd_ext_mem_power(uart_cmd_t *p_uart_cmd);
+/**@brief Function to enable the write verify */
+void cmd_ext_mem_write_verify(uart_cmd_t *p_uart_cmd);
 /**@brief Function to read sfs */
 void cmd_sfs_read(uart_cmd_t *p_uart_cmd);
 /**@brief Function to write sfs */
@@ -81,6 +202,16 @@ void cmd_sfs_write_in_parts(uart_cmd_t *p_uart_cmd);
 void cmd_sfs_read_in_parts(uart_cmd_t *p_uart_cmd);
 /**@brief Function to read last written file info */
 void cmd_sfs_last_written(uart_cmd_t *p_uart_cmd);
+/**@brief Function to measure the read latency of a file */
+void cmd_sfs_read_latency(uart_cmd_t *p_uart_cmd);
+/**@brief Function to stream a file range */
+void cmd_sfs_stream(uart_cmd_t *p_uart_cmd);
+/**@brief Function to request frames of a stream again */
+void cmd_sfs_stream_resend(uart_cmd_t *p_uart_cmd);
+/**@brief Function to start an upload */
+void cmd_sfs_upload(uart_cmd_t *p_uart_cmd);
+/**@brief Function to write a data frame of an upload */
+void cmd_sfs_upload_data(uart_cmd_t *p_uart_cmd);
 /**@brief Function to write measurement file */
 void cmd_meas_write(uart_cmd_t *p_uart_cmd);
 /**@brief Function to read measurement file */
@@ -94,111 +225,184 @@ typedef struct
     cmd_function_t cmd_function;
 } cmd_struct_t;
 
+/** Commands a batch may hold, they answer in one frame and do not change the link */
+static const uint16_t batch_cmds[] = { COMMAND_EXT_MEM_READ,
+                                       COMMAND_EXT_MEM_WRITE,
+                                       COMMAND_EXT_MEM_PAGE_ERASE,
+                                       COMMAND_SFS_READ,
+                                       COMMAND_SFS_WRITE,
+                                       COMMAND_SFS_READ_IN_PARTS,
+                                       COMMAND_SFS_WRITE_IN_PARTS };
+
 cmd_struct_t cmd_struct[] = {   { COMMAND_UART_TEST, cmd_uart_test },
+                                { COMMAND_UART_CONFIG, cmd_uart_config },
+                                { COMMAND_UART_WINDOW, cmd_uart_window },
+                                { COMMAND_UART_FRAMING, cmd_uart_framing },
+                                { COMMAND_BATCH, cmd_batch },
                                 { COMMAND_EXT_MEM_READ, cmd_ext_mem_read },
                                 { COMMAND_EXT_MEM_WRITE, cmd_ext_mem_write },
                                 { COMMAND_EXT_MEM_PAGE_ERASE, cmd_ext_mem_page_erase },
                                 { COMMAND_EXT_MEM_CHIP_ERASE, cmd_ext_mem_chip_erase },
+                                { COMMAND_EXT_MEM_ERASE_PLAN, cmd_ext_mem_erase_plan },
+                                { COMMAND_EXT_MEM_ERASE_STATS, cmd_ext_mem_erase_stats },
+                                { COMMAND_EXT_MEM_BLANK_CHECK, cmd_ext_mem_blank_check },
+                                { COMMAND_EXT_MEM_SPI_FREQUENCY, cmd_ext_mem_spi_frequency },
+                                { COMMAND_EXT_MEM_STATS, cmd_ext_mem_stats },
+                                { COMMAND_EXT_MEM_WAKE_BENCHMARK, cmd_ext_mem_wake_benchmark },
+                                { COMMAND_EXT_MEM_POWER, cmd_ext_mem_power },
+                                { COMMAND_EXT_MEM_WRITE_VERIFY, cmd_ext_mem_write_verify },
                                 { COMMAND_SFS_READ, cmd_sfs_read },
                                 { COMMAND_SFS_WRITE, cmd_sfs_write },
                                 { COMMAND_SFS_WRITE_IN_PARTS, cmd_sfs_write_in_parts },
                                 { COMMAND_SFS_READ_IN_PARTS, cmd_sfs_read_in_parts },
                                 { COMMAND_SFS_LAST_WRITTEN, cmd_sfs_last_written},
+                                { COMMAND_SFS_READ_LATENCY, cmd_sfs_read_latency},
+                                { COMMAND_SFS_STREAM, cmd_sfs_stream},
+                                { COMMAND_SFS_STREAM_RESEND, cmd_sfs_stream_resend},
+                                { COMMAND_SFS_UPLOAD, cmd_sfs_upload},
+                                { COMMAND_SFS_UPLOAD_DATA, cmd_sfs_upload_data},
                                 { COMMAND_MEAS_WRITE, cmd_meas_write},
                                 { COMMAND_MEAS_READ, cmd_meas_read}};
 
-/**@brief Function for handling UART errors.
- *
- * @param[in]   p_event   UART event.
- */
-void uart_error_handle(app_uart_evt_t *p_event)
-{
-    if (p_event->evt_type == APP_UART_COMMUNICATION_ERROR)
-    {
-        /** Wait for 5 seconds to avoid continues restart before WP is ready during bootup */
-        nrf_delay_ms(5000);
-        NRF_LOG_INFO("UART error");
-        //APP_ERROR_HANDLER(p_event->data.error_communication);
-    }
-    else if (p_event->evt_type == APP_UART_FIFO_ERROR)
-    {
-        APP_ERROR_HANDLER(p_event->data.error_code);
-    }
-}
-
 /**@brief Function for handling UART initialization. */
 void uart_init(void)
 {
     uint32_t err_code;
 
-    const app_uart_comm_params_t comm_params = {
-    RX_PIN_NUMBER,
-    TX_PIN_NUMBER,
-    RTS_PIN_NUMBER,
-    CTS_PIN_NUMBER,
-    UART_HWFC,
-    false, NRF_UART_BAUDRATE_115200 };
-
-    APP_UART_FIFO_INIT(&comm_params, UART_RX_FIFO_SIZE, UART_TX_FIFO_SIZE, uart_error_handle, _PRIO_APP_HIGH, err_code);
-
+    err_code = uart_dma_init(UART_BAUDRATE, UART_HWFC);
     APP_ERROR_CHECK(err_code);
 
-    /** Set UART data receive state to the BEGIN to receive data */
-    m_uart_rx_state = UART_RX_STATE_BEGIN;
+    /** Frames are unescaped from the receive buffers after the queued ones */
+    uart_frame_init(&m_rx_frame, m_rx_buffer + UART_HEADER_SIZE, UART_FRAME_SIZE);
 
-    NRF_LOG_INFO("Initialize UART FIFO");
+    NRF_LOG_INFO("Initialize UART DMA");
 }
 
 static void uart_put(char byte)
 {
-    while (app_uart_put(byte) != NRF_SUCCESS);
+    uart_dma_put(byte);
 }
 
-/**@brief Function for escaping bytes in the UART stream.
+/**@brief Function for COBS encoding a buffer to UART.
  *
- * @param[in]   byte   Byte to escape and write.
+ * The blocks found in the buffer are written in bulk, the block at the end of the
+ * buffer is kept until the next write or the end of the frame.
+ *
+ * @param[in]   ptr   Buffer to write.
+ * @param[in]   len   Length of buffer.
  */
-static void uart_write_escaped(uint8_t byte)
+static void uart_write_cobs(const uint8_t *ptr, uint32_t len)
 {
-    if (byte == STX || byte == ETX || byte == DLE)
-    {
-#ifdef DEBUG
-        NRF_LOG_INFO("Escaping byte 0x%02x as 0x%02x%02x", byte, DLE, (uint8_t) ~byte);
-#endif
-        uart_put(DLE);
-        uart_put(~byte);
-    }
-    else
+    const uint8_t *zero;
+    uint32_t run;
+
+    while (len > 0)
     {
-        uart_put(byte);
+        run = SFS_SMALL(len, UART_FRAME_COBS_BLOCK_LEN - m_cobs_len);
+        zero = memchr(ptr, 0, run);
+        if (zero != NULL)
+        {
+            run = zero - ptr;
+        }
+
+        if ((m_cobs_len == 0) && ((zero != NULL) || (run == UART_FRAME_COBS_BLOCK_LEN)))
+        {
+            /** The whole block is in the buffer */
+            uart_put(run + 1);
+            uart_dma_write(ptr, run);
+        }
+        else
+        {
+            memcpy(m_cobs_block + m_cobs_len, ptr, run);
+            m_cobs_len += run;
+            if ((zero != NULL) || (m_cobs_len == UART_FRAME_COBS_BLOCK_LEN))
+            {
+                uart_put(m_cobs_len + 1);
+                uart_dma_write(m_cobs_block, m_cobs_len);
+                m_cobs_len = 0;
+            }
+        }
+
+        /** The zero is replaced by the length of the next block */
+        run += (zero != NULL) ? 1 : 0;
+        ptr += run;
+        len -= run;
     }
 }
 
 /**@brief Function for writing a buffer to UART.
+ *
+ * The bytes are escaped or COBS encoded straight into the DMA transmit buffers, the
+ * next buffer is filled while the previous one is sent.
  *
  * @param[in]   buf   Buffer to write.
  * @param[in]   len   Length of buffer.
  */
-static void uart_write_buffer(void *buf, int len)
+static void uart_write_buffer(const void *buf, uint32_t len)
 {
 #ifdef DEBUG
     NRF_LOG_INFO("Writing to UART with length %d", len);
     ASSERT(buf);
 #endif
 
-    uint8_t *ptr = (uint8_t*) buf;
-    uint32_t i;
-
-    for (i = 0; i < len; i++)
+    if (m_tx_frame_mode == UART_FRAME_MODE_COBS)
     {
+        uart_write_cobs(buf, len);
+        return;
+    }
+
 #ifdef NO_UART_ESCAPING
-        uart_put(*ptr++);
+    uart_dma_write(buf, len);
 #else
-        uart_write_escaped(*ptr++);
+    const uint8_t *ptr = (const uint8_t*) buf;
+    uint8_t *out;
+    size_t space;
+    size_t used;
+
+    while (len > 0)
+    {
+        space = uart_dma_tx_reserve(&out);
+        uart_dma_tx_commit(uart_frame_escape(out, space, ptr, len, &used));
+        ptr += used;
+        len -= used;
+    }
 #endif
+}
+
+/**@brief Function for starting a frame. */
+static void uart_frame_begin(void)
+{
+    if (m_tx_frame_mode == UART_FRAME_MODE_COBS)
+    {
+        m_cobs_len = 0;
+    }
+    else
+    {
+        uart_put(STX);
     }
 }
 
+/**@brief Function for ending a frame and sending it.
+ *
+ * @return ret_code_t of the transmission, the frame is lost on an error
+ */
+static ret_code_t uart_frame_end(void)
+{
+    if (m_tx_frame_mode == UART_FRAME_MODE_COBS)
+    {
+        /** The last block, it is not followed by a zero */
+        uart_put(m_cobs_len + 1);
+        uart_dma_write(m_cobs_block, m_cobs_len);
+        uart_put(UART_FRAME_COBS_DELIMITER);
+        m_cobs_len = 0;
+    }
+    else
+    {
+        uart_put(ETX);
+    }
+    return uart_dma_flush();
+}
+
 cmd_function_t get_cmd_function(uart_cmd_t *p_uart_cmd)
 {
     cmd_function_t cmd_function = NULL;
@@ -221,199 +425,440 @@ cmd_function_t get_cmd_function(uart_cmd_t *p_uart_cmd)
     return cmd_function;
 }
 
-static void parse_cmd(uint16_t rx_data_len)
+/**@brief Get the function of a command allowed in a batch, NULL otherwise */
+static cmd_function_t get_batch_cmd_function(uart_cmd_t *p_uart_cmd)
+{
+    for (uint16_t i = 0; i < (sizeof(batch_cmds) / sizeof(batch_cmds[0])); i++)
+    {
+        if (p_uart_cmd->cmd_resp == batch_cmds[i])
+        {
+            return get_cmd_function(p_uart_cmd);
+        }
+    }
+
+    return NULL;
+}
+
+/**@brief Parse a received frame into a command, the payload stays in the frame
+ *
+ * The CRC of the frame is computed by the de-framer while the frame is received.
+ *
+ * @return UART_RESP_PKT_CRC_ERROR on a CRC mismatch, UART_RESP_CMD_DATA_ERROR when
+ *         the frame does not fit in the command
+ */
+static uint16_t parse_cmd(uart_cmd_t *p_uart_cmd, uint8_t *frame, uint16_t rx_data_len, uint16_t crc16)
 {
     uint16_t index = 0;
-    uint16_t crc16 = 0;
 
-    memcpy(&m_uart_cmd.crc, m_rx_buffer + index, sizeof(m_uart_cmd.crc));
-    index += sizeof(m_uart_cmd.crc);
+    memcpy(&p_uart_cmd->crc, frame + index, sizeof(p_uart_cmd->crc));
+    index += sizeof(p_uart_cmd->crc);
 
     /** Check crc16 */
-    crc16 = crc16_compute(m_rx_buffer + index, rx_data_len - index, NULL);
-    if (crc16 != m_uart_cmd.crc)
+    if ((rx_data_len < UART_FRAME_CRC_LEN) || (crc16 != p_uart_cmd->crc))
     {
         /** Set CRC mismatch status */
-        m_crc_match_status = false;
-        m_uart_cmd.nbr_arg = ZERO;
-        return;
-    }
-    else
-    {
-        m_crc_match_status = true;
+        p_uart_cmd->nbr_arg = ZERO;
+        return UART_RESP_PKT_CRC_ERROR;
     }
 
-    memcpy(&m_uart_cmd.msg_id, m_rx_buffer + index, sizeof(m_uart_cmd.msg_id));
-    index += sizeof(m_uart_cmd.msg_id);
+    memcpy(&p_uart_cmd->msg_id, frame + index, sizeof(p_uart_cmd->msg_id));
+    index += sizeof(p_uart_cmd->msg_id);
 
-    memcpy(&m_uart_cmd.cmd_resp, m_rx_buffer + index, sizeof(m_uart_cmd.cmd_resp));
-    index += sizeof(m_uart_cmd.cmd_resp);
+    memcpy(&p_uart_cmd->cmd_resp, frame + index, sizeof(p_uart_cmd->cmd_resp));
+    index += sizeof(p_uart_cmd->cmd_resp);
 
-    memcpy(&m_uart_cmd.nbr_arg, m_rx_buffer + index, sizeof(m_uart_cmd.nbr_arg));
-    index += sizeof(m_uart_cmd.nbr_arg);
+    memcpy(&p_uart_cmd->nbr_arg, frame + index, sizeof(p_uart_cmd->nbr_arg));
+    index += sizeof(p_uart_cmd->nbr_arg);
 
-    for (uint16_t i = 0; i < m_uart_cmd.nbr_arg; i++)
+    /** Arguments and payload larger than the command are not supported */
+    if ((p_uart_cmd->nbr_arg > MAX_NBR_ARGU)
+            || ((index + p_uart_cmd->nbr_arg * sizeof(p_uart_cmd->arg[0])) > rx_data_len)
+            || ((rx_data_len - index - p_uart_cmd->nbr_arg * sizeof(p_uart_cmd->arg[0])) > MAX_PAYLOAD_LEN))
     {
-        memcpy(&m_uart_cmd.arg[i], m_rx_buffer + index, sizeof(m_uart_cmd.arg[0]));
-        index += sizeof(m_uart_cmd.arg[0]);
+        return UART_RESP_CMD_DATA_ERROR;
     }
 
-    m_uart_cmd.paylen = rx_data_len - index;
-    memcpy(m_uart_cmd.payload, m_rx_buffer + index, m_uart_cmd.paylen);
+    /** The arguments are copied to be aligned, the payload is not */
+    memcpy(p_uart_cmd->arg, frame + index, p_uart_cmd->nbr_arg * sizeof(p_uart_cmd->arg[0]));
+    index += p_uart_cmd->nbr_arg * sizeof(p_uart_cmd->arg[0]);
+
+    p_uart_cmd->payload = frame + index;
+    p_uart_cmd->paylen = rx_data_len - index;
+    /** The room for the response is known when the command executes */
+    p_uart_cmd->payload_size = p_uart_cmd->paylen;
+
+    return UART_RESP_NO_ERROR;
 }
 
-static void send_cmd_data(uart_cmd_t *p_uart_cmd)
+/**@brief Function for sending a frame.
+ *
+ * The header is written backwards in the UART_HEADER_SIZE bytes in front of the
+ * payload, the frame is then sent in one piece. A frame without payload is built in
+ * m_tx_buffer.
+ */
+static void send_frame(uint16_t msg_id, uint16_t cmd_resp, uint16_t nbr_arg, const uint32_t *arg,
+                       uint8_t *payload, uint32_t paylen)
 {
-    uint16_t tx_data_len;
+    uint8_t *frame;
     uint16_t crc16;
-    uint16_t msg_data_len;
 
-    if (m_crc_match_status == false)
+    if (payload == NULL)
     {
-        /** UART Packet CRC Error */
-        p_uart_cmd->cmd_resp = UART_RESP_PKT_CRC_ERROR;
-        p_uart_cmd->nbr_arg = 0;
-        p_uart_cmd->paylen = 0;
+        payload = m_tx_buffer + sizeof(m_tx_buffer);
+        paylen = 0;
     }
 
-    tx_data_len = sizeof(p_uart_cmd->crc);
-    msg_data_len = sizeof(p_uart_cmd->msg_id);
-    msg_data_len += sizeof(p_uart_cmd->cmd_resp);
-    msg_data_len += sizeof(p_uart_cmd->nbr_arg);
-    msg_data_len += p_uart_cmd->nbr_arg * sizeof(p_uart_cmd->arg[0]);
-    msg_data_len += p_uart_cmd->paylen;
+    frame = payload - nbr_arg * sizeof(arg[0]);
+    memcpy(frame, arg, nbr_arg * sizeof(arg[0]));
+
+    frame -= sizeof(nbr_arg);
+    memcpy(frame, &nbr_arg, sizeof(nbr_arg));
 
-    memcpy(m_tx_buffer + tx_data_len, &p_uart_cmd->msg_id, sizeof(p_uart_cmd->msg_id));
-    tx_data_len += sizeof(p_uart_cmd->msg_id);
+    frame -= sizeof(cmd_resp);
+    memcpy(frame, &cmd_resp, sizeof(cmd_resp));
 
-    memcpy(m_tx_buffer + tx_data_len, &p_uart_cmd->cmd_resp, sizeof(p_uart_cmd->cmd_resp));
-    tx_data_len += sizeof(p_uart_cmd->cmd_resp);
+    frame -= sizeof(msg_id);
+    memcpy(frame, &msg_id, sizeof(msg_id));
 
-    memcpy(m_tx_buffer + tx_data_len, &p_uart_cmd->nbr_arg, sizeof(p_uart_cmd->nbr_arg));
-    tx_data_len += sizeof(p_uart_cmd->nbr_arg);
+    crc16 = crc16_compute(frame, (payload + paylen) - frame, NULL);
+    frame -= sizeof(crc16);
+    /** Update calculated CRC */
+    memcpy(frame, &crc16, sizeof(crc16));
 
-    for (uint16_t i = 0; i < p_uart_cmd->nbr_arg; i++)
+    uart_frame_begin();
+    uart_write_buffer(frame, (payload + paylen) - frame);
+    if (uart_frame_end() != NRF_SUCCESS)
     {
-        memcpy(m_tx_buffer + tx_data_len, &p_uart_cmd->arg[i], sizeof(p_uart_cmd->arg[0]));
-        tx_data_len += sizeof(p_uart_cmd->arg[0]);
+        NRF_LOG_WARNING("Response to message %u not sent", msg_id);
     }
+}
 
-    memcpy(m_tx_buffer + tx_data_len, p_uart_cmd->payload, p_uart_cmd->paylen);
-    tx_data_len += p_uart_cmd->paylen;
-
-    crc16 = crc16_compute(m_tx_buffer + sizeof(p_uart_cmd->crc), msg_data_len, NULL);
-    /** Update calculated CRC */
-    memcpy(m_tx_buffer, &crc16, sizeof(p_uart_cmd->crc));
+static void send_cmd_data(uart_cmd_t *p_uart_cmd, uint16_t status)
+{
+    if (status != UART_RESP_NO_ERROR)
+    {
+        /** UART Packet CRC Error or packet too large */
+        p_uart_cmd->cmd_resp = status;
+        p_uart_cmd->nbr_arg = 0;
+        p_uart_cmd->paylen = 0;
+    }
 
-    uart_put(STX);
-    uart_write_buffer(m_tx_buffer, tx_data_len);
-    uart_put(ETX);
+    send_frame(p_uart_cmd->msg_id, p_uart_cmd->cmd_resp, p_uart_cmd->nbr_arg, p_uart_cmd->arg,
+               p_uart_cmd->payload, p_uart_cmd->paylen);
 }
 
-static void execute_send_cmd(void)
+static void execute_send_cmd(uart_cmd_t *p_uart_cmd, uint16_t status)
 {
-    cmd_function_t cmd_function = get_cmd_function(&m_uart_cmd);
+    cmd_function_t cmd_function = get_cmd_function(p_uart_cmd);
 
     if (cmd_function != NULL)
     {
         /** Execute the command when CRC matched */
-        if (m_crc_match_status == true)
+        if (status == UART_RESP_NO_ERROR)
         {
-            cmd_function(&m_uart_cmd);
+            cmd_function(p_uart_cmd);
         }
     }
     else
     {
-        clear_cmd();
+        clear_cmd(p_uart_cmd);
         /** Send the error COMMAND NOT SUPPORTED */
-        m_uart_cmd.cmd_resp = UART_RESP_CMD_NOT_SUPPORTED;
+        p_uart_cmd->cmd_resp = UART_RESP_CMD_NOT_SUPPORTED;
     }
 
-    /** Send the result after executing command */
-    send_cmd_data(&m_uart_cmd);
+    /** Send the result after executing command, unless it is acknowledged later */
+    if (p_uart_cmd->cmd_resp != UART_RESP_NONE)
+    {
+        send_cmd_data(p_uart_cmd, status);
+    }
 }
 
-static void clear_cmd(void)
+static void clear_cmd(uart_cmd_t *p_uart_cmd)
 {
-    m_crc_match_status = true;
-    m_uart_cmd.cmd_resp = UART_RESP_NO_ERROR;
-    m_uart_cmd.crc = ZERO;
-    m_uart_cmd.nbr_arg = ZERO;
-    m_uart_cmd.paylen = ZERO;
+    p_uart_cmd->cmd_resp = UART_RESP_NO_ERROR;
+    p_uart_cmd->crc = ZERO;
+    p_uart_cmd->nbr_arg = ZERO;
+    p_uart_cmd->paylen = ZERO;
+    p_uart_cmd->payload = NULL;
+    p_uart_cmd->payload_size = ZERO;
 }
 
-void uart_data_handle(void)
+/**@brief Check the space for a response payload, the command answers
+ *        UART_RESP_CMD_DATA_ERROR when it does not fit
+ */
+static bool payload_fits(uart_cmd_t *p_uart_cmd, uint32_t len)
 {
-    uint8_t cr;
-    uint32_t err_code;
-    static uint16_t rx_data_len;
-    static uint8_t negate_byte;
+    if (len <= p_uart_cmd->payload_size)
+    {
+        return true;
+    }
+
+    p_uart_cmd->cmd_resp = UART_RESP_CMD_DATA_ERROR;
+    p_uart_cmd->paylen = 0;
+    return false;
+}
 
-    if ((m_data_ready_to_send == true) && (m_uart_rx_state == UART_RX_STATE_BEGIN))
+/**@brief Queue a received frame, or answer BUSY when the queue is full
+ *
+ * @return true when the frame is queued and stays in the receive buffer
+ */
+static bool queue_cmd(uint16_t rx_data_len)
+{
+    uint8_t index = (m_cmd_head + m_cmd_count) % (UART_CMD_QUEUE_LEN + 1);
+    uart_cmd_t *p_uart_cmd = &m_cmd_queue[index];
+
+    clear_cmd(p_uart_cmd);
+    m_cmd_status[index] = parse_cmd(p_uart_cmd, m_rx_frame.buffer, rx_data_len, m_rx_frame.crc16);
+    m_cmd_len[index] = rx_data_len;
+    /** A valid packet confirms the negotiated configuration */
+    if (m_cmd_status[index] != UART_RESP_PKT_CRC_ERROR)
     {
-        send_cmd_data(&m_uart_cmd);
-        m_data_ready_to_send = false;
+        m_uart_config_unconfirmed = false;
     }
 
-    err_code = app_uart_get(&cr);
+    if (m_cmd_count < UART_CMD_QUEUE_LEN)
+    {
+        m_cmd_count++;
+        return true;
+    }
+    else if (m_cmd_status[index] != UART_RESP_PKT_CRC_ERROR)
+    {
+        /** The host sent more requests than its credits, it sends this one again. The
+         *  frame has no room in front for the header, it is built in m_tx_buffer */
+        p_uart_cmd->cmd_resp = UART_RESP_BUSY;
+        p_uart_cmd->nbr_arg = ZERO;
+        p_uart_cmd->paylen = ZERO;
+        p_uart_cmd->payload = NULL;
+        send_cmd_data(p_uart_cmd, UART_RESP_NO_ERROR);
+    }
 
-    if (err_code == NRF_SUCCESS)
+    return false;
+}
+
+/**@brief Receive the next frame at buffer, up to the end of the receive buffer */
+static void rx_frame_set_buffer(uint8_t *buffer)
+{
+    size_t room = (m_rx_buffer + sizeof(m_rx_buffer)) - buffer;
+
+    uart_frame_set_buffer(&m_rx_frame, buffer, SFS_SMALL(room, UART_FRAME_SIZE));
+}
+
+/**@brief End of the received bytes, the bytes of a dropped frame are not kept */
+static uint8_t *rx_frames_end(void)
+{
+    return m_rx_frame.buffer + (m_rx_frame.in_frame ? m_rx_frame.len : 0);
+}
+
+/**@brief Move the frames queued after the oldest one, and the frame being received
+ *
+ * @param[in]  src Start of the frames
+ * @param[in]  dst Their new place
+ */
+static void rx_frames_move(uint8_t *src, uint8_t *dst)
+{
+    size_t len = rx_frames_end() - src;
+    size_t room;
+
+    memmove(dst, src, len);
+    for (uint8_t i = 1; i < m_cmd_count; i++)
     {
-        switch (m_uart_rx_state)
+        uart_cmd_t *p_uart_cmd = &m_cmd_queue[(m_cmd_head + i) % (UART_CMD_QUEUE_LEN + 1)];
+
+        if (p_uart_cmd->payload != NULL)
         {
-            case UART_RX_STATE_NONE:
-            case UART_RX_STATE_BEGIN:
-                if (cr == STX)
-                {
-                    rx_data_len = 0;
-                    negate_byte = 0;
-                    m_uart_rx_state = UART_RX_STATE_PROGRESS;
-                }
-                break;
-            case UART_RX_STATE_PROGRESS:
-                if (cr == STX && negate_byte == 0)
-                {
-                    rx_data_len = 0;
-                    m_uart_rx_state = UART_RX_STATE_PROGRESS;
-                }
-                else if (cr == ETX && negate_byte == 0)
-                {
-                    if (rx_data_len == 0)
-                    {
-                        uart_put(STX);
-                        uart_put(ETX);
-                    }
-                    else
-                    {
-                        app_uart_flush();
-                        parse_cmd(rx_data_len);
-                        execute_send_cmd();
-                        clear_cmd();
-                    }
-                    m_uart_rx_state = UART_RX_STATE_BEGIN;
-                }
-                else if (cr == DLE && negate_byte == 0)
-                {
-                    negate_byte = 1;
-                }
-                else
-                {
-                    if (negate_byte == 1)
-                    {
-                        m_rx_buffer[rx_data_len] = ~cr;
-                        negate_byte = 0;
-                    }
-                    else
-                    {
-                        m_rx_buffer[rx_data_len] = cr;
-                    }
-                    rx_data_len++;
-                }
-                break;
-            default:
-                break;
+            p_uart_cmd->payload = dst + (p_uart_cmd->payload - src);
         }
     }
+
+    room = (m_rx_buffer + sizeof(m_rx_buffer)) - (dst + (m_rx_frame.buffer - src));
+    uart_frame_move_buffer(&m_rx_frame, dst + (m_rx_frame.buffer - src), SFS_SMALL(room, UART_FRAME_SIZE));
+}
+
+/**@brief Execute the oldest command, its response is built in place
+ *
+ * The host window bounds the frames that follow it, at the end of the buffer they
+ * leave the room of the largest response.
+ */
+static void execute_oldest_cmd(void)
+{
+    uart_cmd_t *p_uart_cmd = &m_cmd_queue[m_cmd_head];
+    uint8_t *next = m_rx_buffer + UART_HEADER_SIZE + m_cmd_len[m_cmd_head];
+    uint8_t *end = m_rx_buffer + sizeof(m_rx_buffer) - (rx_frames_end() - next);
+
+    rx_frames_move(next, end);
+    if (p_uart_cmd->payload != NULL)
+    {
+        p_uart_cmd->payload_size = SFS_SMALL((uint32_t) (end - p_uart_cmd->payload), MAX_PAYLOAD_LEN);
+    }
+
+    execute_send_cmd(p_uart_cmd, m_cmd_status[m_cmd_head]);
+
+    /** The next command is the oldest one, it gets the room in front for its header */
+    rx_frames_move(end, m_rx_buffer + UART_HEADER_SIZE);
+    m_cmd_head = (m_cmd_head + 1) % (UART_CMD_QUEUE_LEN + 1);
+    m_cmd_count--;
+}
+
+/**@brief Apply a negotiated configuration or framing once its response is sent, and
+ *        fall back to the start up configuration when the host does not confirm it
+ */
+static void uart_config_process(void)
+{
+    if (m_uart_config_pending == true)
+    {
+        m_uart_config_pending = false;
+        APP_ERROR_CHECK(uart_dma_reconfigure(m_uart_config_baudrate, m_uart_config_hwfc));
+        uart_frame_set_mode(&m_rx_frame, m_rx_frame.mode);
+        m_uart_config_unconfirmed = true;
+        m_uart_config_deadline = get_systick_timer() + m_uart_config_confirm_ms;
+    }
+    else if (m_uart_framing_pending == true)
+    {
+        m_uart_framing_pending = false;
+        m_tx_frame_mode = m_uart_framing_mode;
+        uart_frame_set_mode(&m_rx_frame, m_uart_framing_mode);
+        m_uart_config_unconfirmed = true;
+        m_uart_config_deadline = get_systick_timer() + m_uart_config_confirm_ms;
+    }
+    else if ((m_uart_config_unconfirmed == true) && ((int32_t) (get_systick_timer() - m_uart_config_deadline) >= 0))
+    {
+        m_uart_config_unconfirmed = false;
+        /** The host may not receive at this setting, nothing more is sent with it */
+        uart_dma_tx_abort();
+        APP_ERROR_CHECK(uart_dma_reconfigure(UART_BAUDRATE, UART_HWFC));
+        m_tx_frame_mode = UART_FRAME_MODE_DLE;
+        uart_frame_set_mode(&m_rx_frame, UART_FRAME_MODE_DLE);
+        NRF_LOG_INFO("UART configuration not confirmed, back to 115200 and DLE framing");
+    }
+}
+
+/**@brief Read the data of a frame of the stream in the stream buffer
+ *
+ * A failed read ends the stream with a frame holding the error and the sequence number.
+ *
+ * @return false when the read failed
+ */
+static bool stream_read_frame(uint32_t seq, uint32_t *len)
+{
+    uint32_t offset = seq * m_stream.chunk_len;
+    uint32_t arg[1];
+    sfs_status_t status;
+
+    *len = SFS_SMALL(m_stream.chunk_len, m_stream.length - offset);
+    /** The previous frame is still sent by EasyDMA while this one is read */
+    status = sfs_read_file_range(&m_stream.file_info, m_stream.offset + offset, m_stream_buffer + UART_HEADER_SIZE, *len);
+    if (status != SFS_STATUS_SUCCESS)
+    {
+        arg[0] = seq;
+        send_frame(m_stream.msg_id, status, 1, arg, NULL, 0);
+        m_stream.valid = false;
+        return false;
+    }
+    return true;
+}
+
+/**@brief Send a data frame of the stream read by stream_read_frame */
+static void stream_send_data(uint32_t seq, uint32_t len)
+{
+    uint32_t arg[2];
+
+    arg[0] = seq;
+    arg[1] = m_stream.offset + (seq * m_stream.chunk_len);
+    send_frame(m_stream.msg_id, UART_RESP_STREAM_DATA, 2, arg, m_stream_buffer + UART_HEADER_SIZE, len);
+}
+
+/**@brief Send the end frame of the stream, it holds the CRC of the data frames */
+static void stream_send_end(void)
+{
+    uint32_t arg[3];
+
+    arg[0] = m_stream.nbr_frames;
+    arg[1] = m_stream.length;
+    arg[2] = m_stream.crc16;
+    send_frame(m_stream.msg_id, UART_RESP_STREAM_END, 3, arg, NULL, 0);
+}
+
+/**@brief Push the next frame of the stream, the frames requested again first */
+static void stream_process(void)
+{
+    uint32_t seq;
+    uint32_t len;
+
+    if (m_stream.valid == false)
+    {
+        return;
+    }
+
+    if (m_stream.resend_count > 0)
+    {
+        seq = m_stream.resend[0];
+        m_stream.resend_count--;
+        memmove(m_stream.resend, m_stream.resend + 1, m_stream.resend_count * sizeof(m_stream.resend[0]));
+        if (seq == m_stream.nbr_frames)
+        {
+            stream_send_end();
+        }
+        else if (stream_read_frame(seq, &len))
+        {
+            stream_send_data(seq, len);
+        }
+    }
+    else if (m_stream.next_seq < m_stream.nbr_frames)
+    {
+        seq = m_stream.next_seq++;
+        if (stream_read_frame(seq, &len))
+        {
+            /** Each data frame is in the CRC once, in the order of the data */
+            m_stream.crc16 = crc16_compute(m_stream_buffer + UART_HEADER_SIZE, len, &m_stream.crc16);
+            stream_send_data(seq, len);
+        }
+    }
+    else if (m_stream.end_sent == false)
+    {
+        stream_send_end();
+        m_stream.end_sent = true;
+    }
+}
+
+void uart_data_handle(void)
+{
+    const uint8_t *data;
+    size_t len;
+    size_t used;
+
+    /** Queue all the received frames, the next ones are received while a command executes */
+    while (uart_dma_rx_get(&data, &len))
+    {
+        bool frame_done = uart_frame_deframe(&m_rx_frame, data, len, &used);
+
+        uart_dma_rx_release(used);
+        if (frame_done)
+        {
+            if (m_rx_frame.len == 0)
+            {
+                uart_frame_begin();
+                uart_frame_end();
+            }
+            else if (queue_cmd(m_rx_frame.len))
+            {
+                /** The next frame is received after the queued one */
+                rx_frame_set_buffer(m_rx_frame.buffer + m_rx_frame.len);
+            }
+            else
+            {
+                rx_frame_set_buffer(m_rx_frame.buffer);
+            }
+        }
+    }
+
+    /** Execute the oldest command */
+    if (m_cmd_count > 0)
+    {
+        execute_oldest_cmd();
+    }
+
+    stream_process();
+    uart_config_process();
 }
 
 void cmd_uart_test(uart_cmd_t *p_uart_cmd)
@@ -423,6 +868,190 @@ void cmd_uart_test(uart_cmd_t *p_uart_cmd)
     p_uart_cmd->cmd_resp = UART_RESP_NO_ERROR;
 }
 
+/** arg[0] baud rate in bits per second, up to 1000000.
+ *  arg[1] 1 enables the RTS/CTS flow control.
+ *  arg[2] time in ms to confirm the configuration, 0 for the default.
+ *  The device switches after the response, a valid packet received at the new
+ *  baud rate confirms it, otherwise the device goes back to 115200 without flow control.
+ *  Response: arg[3] the baud rate applied, arg[4] the confirm time
+ */
+void cmd_uart_config(uart_cmd_t *p_uart_cmd)
+{
+    uint32_t baudrate = uart_dma_baudrate_get(p_uart_cmd->arg[0]);
+
+    p_uart_cmd->nbr_arg = 5;
+    p_uart_cmd->paylen = 0;
+    if (baudrate == 0)
+    {
+        p_uart_cmd->arg[3] = 0;
+        p_uart_cmd->arg[4] = 0;
+        p_uart_cmd->cmd_resp = UART_RESP_CMD_DATA_ERROR;
+        return;
+    }
+
+    m_uart_config_baudrate = baudrate;
+    m_uart_config_hwfc = (p_uart_cmd->arg[1] != 0);
+    m_uart_config_confirm_ms = p_uart_cmd->arg[2] ? p_uart_cmd->arg[2] : UART_CONFIG_CONFIRM_MS;
+    m_uart_config_pending = true;
+
+    p_uart_cmd->arg[3] = p_uart_cmd->arg[0];
+    p_uart_cmd->arg[4] = m_uart_config_confirm_ms;
+    p_uart_cmd->cmd_resp = UART_RESP_NO_ERROR;
+}
+
+/** Response: arg[0] the number of requests the host may send without waiting for
+ *  their responses, arg[1] the number of bytes (escaped) they may take in total
+ */
+void cmd_uart_window(uart_cmd_t *p_uart_cmd)
+{
+    p_uart_cmd->arg[0] = UART_CMD_QUEUE_LEN;
+    p_uart_cmd->arg[1] = UART_RX_WINDOW_BYTES;
+    p_uart_cmd->nbr_arg = 2;
+    p_uart_cmd->paylen = 0;
+    p_uart_cmd->cmd_resp = UART_RESP_NO_ERROR;
+}
+
+/** arg[0] framing, 0 for STX/ETX with DLE escaping, 1 for COBS.
+ *  arg[1] time in ms to confirm the framing, 0 for the default.
+ *  The device switches after the response, a valid packet received in the new framing
+ *  confirms it, otherwise the device goes back to the start up configuration.
+ *  Response: arg[2] the framing
+ */
+void cmd_uart_framing(uart_cmd_t *p_uart_cmd)
+{
+    p_uart_cmd->nbr_arg = 3;
+    p_uart_cmd->paylen = 0;
+    if (p_uart_cmd->arg[0] > UART_FRAME_MODE_COBS)
+    {
+        p_uart_cmd->arg[2] = m_tx_frame_mode;
+        p_uart_cmd->cmd_resp = UART_RESP_CMD_DATA_ERROR;
+        return;
+    }
+
+    m_uart_framing_mode = (uart_frame_mode_t) p_uart_cmd->arg[0];
+    m_uart_config_confirm_ms = p_uart_cmd->arg[1] ? p_uart_cmd->arg[1] : UART_CONFIG_CONFIRM_MS;
+    m_uart_framing_pending = true;
+
+    p_uart_cmd->arg[2] = m_uart_framing_mode;
+    p_uart_cmd->cmd_resp = UART_RESP_NO_ERROR;
+}
+
+/** Payload: items of a uint16 command, a uint16 number of arguments, a uint16 payload
+ *  length, the uint32 arguments and the payload. The items are executed in order until
+ *  the responses do not fit in one payload.
+ *  Response: arg[0] the number of items executed, the host sends the others again.
+ *  The payload holds an item per command executed: a uint16 command, a uint16 status,
+ *  a uint16 number of arguments, a uint16 payload length, the arguments and the payload.
+ *  The data of a write is not sent back. UART_RESP_CMD_DATA_ERROR when an item does not
+ *  fit in the payload.
+ *  The items move to the end of the payload space and the response is built from its
+ *  start, the batch stops when the response reaches the items not executed.
+ */
+void cmd_batch(uart_cmd_t *p_uart_cmd)
+{
+    uart_cmd_t *p_item = &m_batch_cmd;
+    uint8_t *response = p_uart_cmd->payload;
+    uint8_t *items = p_uart_cmd->payload + p_uart_cmd->payload_size - p_uart_cmd->paylen;
+    cmd_function_t cmd_function;
+    uint16_t header[4];
+    uint32_t index = 0;
+    uint32_t resp_len = 0;
+    uint32_t item_len;
+    uint32_t nbr_items = 0;
+    bool is_write;
+    uint16_t status = UART_RESP_NO_ERROR;
+
+    memmove(items, p_uart_cmd->payload, p_uart_cmd->paylen);
+    while (index < p_uart_cmd->paylen)
+    {
+        if ((index + UART_BATCH_ITEM_HEADER_SIZE) > p_uart_cmd->paylen)
+        {
+            status = UART_RESP_CMD_DATA_ERROR;
+            break;
+        }
+        memcpy(header, items + index, UART_BATCH_ITEM_HEADER_SIZE);
+        item_len = UART_BATCH_ITEM_HEADER_SIZE + header[1] * sizeof(p_item->arg[0]) + header[2];
+        if ((header[1] > MAX_NBR_ARGU) || ((index + item_len) > p_uart_cmd->paylen))
+        {
+            status = UART_RESP_CMD_DATA_ERROR;
+            break;
+        }
+
+        /** A write or an erase answers with its arguments only, it is not executed when they do not fit */
+        if ((resp_len + UART_BATCH_RESP_HEADER_SIZE + sizeof(p_item->arg)) > p_uart_cmd->payload_size)
+        {
+            break;
+        }
+
+        clear_cmd(p_item);
+        p_item->msg_id = p_uart_cmd->msg_id;
+        p_item->cmd_resp = header[0];
+        p_item->nbr_arg = header[1];
+        p_item->paylen = header[2];
+        memcpy(p_item->arg, items + index + UART_BATCH_ITEM_HEADER_SIZE, p_item->nbr_arg * sizeof(p_item->arg[0]));
+        is_write = (p_item->paylen > 0);
+        if (is_write)
+        {
+            /** The data of a write is a view into the batch */
+            p_item->payload = items + index + item_len - p_item->paylen;
+        }
+        else
+        {
+            /** A read writes its data in the response, after room for the largest arguments */
+            p_item->payload = response + resp_len + UART_BATCH_RESP_HEADER_SIZE + sizeof(p_item->arg);
+            p_item->payload_size = p_uart_cmd->payload_size - (resp_len + UART_BATCH_RESP_HEADER_SIZE + sizeof(p_item->arg));
+        }
+
+        cmd_function = get_batch_cmd_function(p_item);
+        if (cmd_function != NULL)
+        {
+            cmd_function(p_item);
+        }
+        else
+        {
+            p_item->cmd_resp = UART_RESP_CMD_NOT_SUPPORTED;
+            p_item->nbr_arg = ZERO;
+            p_item->paylen = ZERO;
+        }
+
+        /** A read that does not fit in the space left is sent again in the next batch */
+        if ((p_item->cmd_resp == UART_RESP_CMD_DATA_ERROR) && !is_write && (nbr_items > 0))
+        {
+            break;
+        }
+        if (is_write)
+        {
+            p_item->paylen = 0;
+        }
+
+        header[1] = p_item->cmd_resp;
+        header[2] = p_item->nbr_arg;
+        header[3] = p_item->paylen;
+        memcpy(response + resp_len, header, UART_BATCH_RESP_HEADER_SIZE);
+        resp_len += UART_BATCH_RESP_HEADER_SIZE;
+        memcpy(response + resp_len, p_item->arg, p_item->nbr_arg * sizeof(p_item->arg[0]));
+        resp_len += p_item->nbr_arg * sizeof(p_item->arg[0]);
+        /** The data moves down when there are fewer arguments than the room left for them */
+        memmove(response + resp_len, p_item->payload, p_item->paylen);
+        resp_len += p_item->paylen;
+
+        index += item_len;
+        nbr_items++;
+
+        /** The response overwrote the next items, the host sends them again */
+        if ((resp_len > (index + (items - response))) && (index < p_uart_cmd->paylen))
+        {
+            break;
+        }
+    }
+
+    p_uart_cmd->cmd_resp = status;
+    p_uart_cmd->arg[0] = nbr_items;
+    p_uart_cmd->nbr_arg = 1;
+    p_uart_cmd->payload = response;
+    p_uart_cmd->paylen = resp_len;
+}
+
 void cmd_ext_mem_write(uart_cmd_t *p_uart_cmd)
 {
     p_uart_cmd->cmd_resp = memory_write(p_uart_cmd->arg[0], p_uart_cmd->payload, p_uart_cmd->paylen);
@@ -430,8 +1059,11 @@ void cmd_ext_mem_write(uart_cmd_t *p_uart_cmd)
 
 void cmd_ext_mem_read(uart_cmd_t *p_uart_cmd)
 {
-    p_uart_cmd->cmd_resp = memory_read(p_uart_cmd->arg[0], p_uart_cmd->payload, p_uart_cmd->arg[1]);
-    p_uart_cmd->paylen = p_uart_cmd->arg[1];
+    if (payload_fits(p_uart_cmd, p_uart_cmd->arg[1]))
+    {
+        p_uart_cmd->cmd_resp = memory_read(p_uart_cmd->arg[0], p_uart_cmd->payload, p_uart_cmd->arg[1]);
+        p_uart_cmd->paylen = p_uart_cmd->arg[1];
+    }
 }
 
 void cmd_ext_mem_page_erase(uart_cmd_t *p_uart_cmd)
@@ -446,6 +1078,248 @@ void cmd_ext_mem_chip_erase(uart_cmd_t *p_uart_cmd)
     p_uart_cmd->cmd_resp = UART_RESP_NO_ERROR;
 }
 
+void cmd_ext_mem_erase_plan(uart_cmd_t *p_uart_cmd)
+{
+    ext_mem_erase_plan_t plan;
+    uint32_t index = 2;
+
+    p_uart_cmd->cmd_resp = memory_erase_plan(p_uart_cmd->arg[0], p_uart_cmd->arg[1], &plan);
+    /** Send the planned erase commands and the predicted time */
+    p_uart_cmd->arg[index++] = plan.nbr_4k;
+    p_uart_cmd->arg[index++] = plan.nbr_32k;
+    p_uart_cmd->arg[index++] = plan.nbr_64k;
+    p_uart_cmd->arg[index++] = plan.nbr_chip;
+    p_uart_cmd->arg[index++] = plan.time_ms;
+    p_uart_cmd->nbr_arg = index;
+}
+
+void cmd_ext_mem_erase_stats(uart_cmd_t *p_uart_cmd)
+{
+    ext_mem_erase_stats_t stats;
+    uint32_t index = 1;
+
+    memory_get_erase_stats(&stats);
+    /** Clear the counters when requested to start a new workload */
+    if (p_uart_cmd->arg[0] != 0)
+    {
+        memory_clear_erase_stats();
+    }
+
+    p_uart_cmd->arg[index++] = stats.pages_requested;
+    p_uart_cmd->arg[index++] = stats.pages_erased;
+    p_uart_cmd->arg[index++] = stats.blank_checks;
+    p_uart_cmd->arg[index++] = stats.planned_time_ms;
+    p_uart_cmd->arg[index++] = stats.time_ms;
+    p_uart_cmd->arg[index++] = stats.busy_wait_ms;
+    p_uart_cmd->arg[index++] = stats.status_polls;
+    p_uart_cmd->nbr_arg = index;
+    p_uart_cmd->cmd_resp = UART_RESP_NO_ERROR;
+}
+
+/**@brief Blank check by reading the region into a buffer and checking it byte by byte */
+static bool blank_check_with_read(uint32_t address, uint32_t len, uint8_t *buffer, uint32_t size)
+{
+    uint32_t read_len;
+    uint32_t i;
+
+    while (len > 0)
+    {
+        read_len = (len < size) ? len : size;
+        if (memory_read(address, buffer, read_len) != NRF_SUCCESS)
+        {
+            return false;
+        }
+
+        for (i = 0; i < read_len; i++)
+        {
+            if (buffer[i] != 0xFF)
+            {
+                return false;
+            }
+        }
+        address += read_len;
+        len -= read_len;
+    }
+    return true;
+}
+
+void cmd_ext_mem_blank_check(uart_cmd_t *p_uart_cmd)
+{
+    uint32_t time_ms;
+    bool is_blank;
+
+    /** Record the start time */
+    time_ms = get_systick_timer();
+    if (p_uart_cmd->arg[2] == 0)
+    {
+        is_blank = memory_is_blank(p_uart_cmd->arg[0], p_uart_cmd->arg[1]);
+    }
+    else
+    {
+        /** Reference method for the benchmark */
+        is_blank = (p_uart_cmd->payload_size > 0)
+                && blank_check_with_read(p_uart_cmd->arg[0], p_uart_cmd->arg[1], p_uart_cmd->payload, p_uart_cmd->payload_size);
+    }
+    p_uart_cmd->arg[3] = is_blank;
+    p_uart_cmd->arg[4] = get_systick_timer() - time_ms;
+    p_uart_cmd->nbr_arg = 5;
+    p_uart_cmd->paylen = 0;
+    p_uart_cmd->cmd_resp = UART_RESP_NO_ERROR;
+}
+
+/** arg[0] command frequency, arg[1] data frequency in MHz, 0 keeps the frequency.
+ *  Response: arg[2] and arg[3] the frequencies in use
+ */
+void cmd_ext_mem_spi_frequency(uart_cmd_t *p_uart_cmd)
+{
+    p_uart_cmd->cmd_resp = UART_RESP_NO_ERROR;
+    if ((p_uart_cmd->arg[0] != 0) && (spi_set_frequency(SPI_PHASE_COMMAND, p_uart_cmd->arg[0]) != NRF_SUCCESS))
+    {
+        p_uart_cmd->cmd_resp = UART_RESP_CMD_DATA_ERROR;
+    }
+    if ((p_uart_cmd->arg[1] != 0) && (spi_set_frequency(SPI_PHASE_DATA, p_uart_cmd->arg[1]) != NRF_SUCCESS))
+    {
+        p_uart_cmd->cmd_resp = UART_RESP_CMD_DATA_ERROR;
+    }
+    p_uart_cmd->arg[2] = spi_get_frequency(SPI_PHASE_COMMAND);
+    p_uart_cmd->arg[3] = spi_get_frequency(SPI_PHASE_DATA);
+    p_uart_cmd->nbr_arg = 4;
+    p_uart_cmd->paylen = 0;
+}
+
+/** arg[0] not 0 clears the statistics, arg[1] selects the page.
+ *  Page 0: SPI transfers, bytes, timeouts, status polls and busy wait time in us.
+ *  Page 1: program count, mean and max latency in us, erase count, mean and max latency in us.
+ *  Page 2: bytes written, bytes programmed, programs skipped, verify failures.
+ */
+void cmd_ext_mem_stats(uart_cmd_t *p_uart_cmd)
+{
+    spi_stats_t spi_stats;
+    ext_mem_latency_stats_t latency;
+    ext_mem_write_stats_t write_stats;
+    uint32_t index = 2;
+
+    spi_get_stats(&spi_stats);
+    memory_get_latency_stats(&latency);
+    memory_get_write_stats(&write_stats);
+    if (p_uart_cmd->arg[0] != 0)
+    {
+        spi_clear_stats();
+        memory_clear_latency_stats();
+        memory_clear_write_stats();
+    }
+
+    p_uart_cmd->cmd_resp = UART_RESP_NO_ERROR;
+    if (p_uart_cmd->arg[1] == 0)
+    {
+        p_uart_cmd->arg[index++] = spi_stats.transfers;
+        p_uart_cmd->arg[index++] = spi_stats.bytes;
+        p_uart_cmd->arg[index++] = spi_stats.timeouts;
+        p_uart_cmd->arg[index++] = spi_stats.polls;
+        p_uart_cmd->arg[index++] = spi_stats.busy_wait_us;
+    }
+    else if (p_uart_cmd->arg[1] == 1)
+    {
+        p_uart_cmd->arg[index++] = latency.program.count;
+        p_uart_cmd->arg[index++] = latency.program.count ? (latency.program.total_us / latency.program.count) : 0;
+        p_uart_cmd->arg[index++] = latency.program.max_us;
+        p_uart_cmd->arg[index++] = latency.erase.count;
+        p_uart_cmd->arg[index++] = latency.erase.count ? (latency.erase.total_us / latency.erase.count) : 0;
+        p_uart_cmd->arg[index++] = latency.erase.max_us;
+    }
+    else if (p_uart_cmd->arg[1] == 2)
+    {
+        p_uart_cmd->arg[index++] = write_stats.bytes_requested;
+        p_uart_cmd->arg[index++] = write_stats.bytes_programmed;
+        p_uart_cmd->arg[index++] = write_stats.programs_skipped;
+        p_uart_cmd->arg[index++] = write_stats.verify_failures;
+    }
+    else
+    {
+        p_uart_cmd->cmd_resp = UART_RESP_CMD_DATA_ERROR;
+    }
+    p_uart_cmd->nbr_arg = index;
+    p_uart_cmd->paylen = 0;
+}
+
+/** arg[0] not 0 for the fast wake, arg[1] number of sleep and wake cycles.
+ *  Response: arg[2] mean and arg[3] max time from the wake to the end of the first read
+ *  in us, arg[4] to arg[6] boot wake, detection and first read time in us
+ */
+void cmd_ext_mem_wake_benchmark(uart_cmd_t *p_uart_cmd)
+{
+    const ext_mem_boot_time_t *boot_time = ext_mem_get_boot_time();
+    uint32_t total_us = 0;
+    uint32_t max_us = 0;
+    uint32_t time_us;
+    uint32_t i;
+
+    p_uart_cmd->cmd_resp = UART_RESP_NO_ERROR;
+    for (i = 0; (i < p_uart_cmd->arg[1]) && (p_uart_cmd->cmd_resp == UART_RESP_NO_ERROR); i++)
+    {
+        ext_mem_sleep();
+        time_us = spi_time_us();
+        if ((ext_mem_wake(p_uart_cmd->arg[0] != 0) != NRF_SUCCESS)
+                || (memory_read(0x0, p_uart_cmd->payload, sizeof(uint64_t)) != NRF_SUCCESS))
+        {
+            p_uart_cmd->cmd_resp = UART_RESP_CMD_DATA_ERROR;
+        }
+        time_us = spi_time_us() - time_us;
+        total_us += time_us;
+        max_us = (time_us > max_us) ? time_us : max_us;
+    }
+
+    p_uart_cmd->arg[2] = (i > 0) ? (total_us / i) : 0;
+    p_uart_cmd->arg[3] = max_us;
+    p_uart_cmd->arg[4] = boot_time->wake_us;
+    p_uart_cmd->arg[5] = boot_time->detect_us;
+    p_uart_cmd->arg[6] = boot_time->first_read_us;
+    p_uart_cmd->nbr_arg = 7;
+    p_uart_cmd->paylen = 0;
+}
+
+/** arg[0] not 0 clears the counters, arg[1] not 0 sets the idle timeout to arg[2] ms (0 disables).
+ *  Response: arg[3] idle timeout, arg[4] sleeps, arg[5] wakes, arg[6] mean and arg[7] max
+ *  wake time in us, arg[8] time asleep and arg[9] time awake in ms
+ */
+void cmd_ext_mem_power(uart_cmd_t *p_uart_cmd)
+{
+    ext_mem_power_stats_t stats;
+
+    if (p_uart_cmd->arg[1] != 0)
+    {
+        ext_mem_set_idle_timeout(p_uart_cmd->arg[2]);
+    }
+    ext_mem_get_power_stats(&stats);
+    if (p_uart_cmd->arg[0] != 0)
+    {
+        ext_mem_clear_power_stats();
+    }
+
+    p_uart_cmd->arg[3] = ext_mem_get_idle_timeout();
+    p_uart_cmd->arg[4] = stats.sleeps;
+    p_uart_cmd->arg[5] = stats.wakes;
+    p_uart_cmd->arg[6] = stats.wakes ? (stats.wake_total_us / stats.wakes) : 0;
+    p_uart_cmd->arg[7] = stats.wake_max_us;
+    p_uart_cmd->arg[8] = stats.sleep_ms;
+    p_uart_cmd->arg[9] = stats.awake_ms;
+    p_uart_cmd->nbr_arg = 10;
+    p_uart_cmd->paylen = 0;
+    p_uart_cmd->cmd_resp = UART_RESP_NO_ERROR;
+}
+
+/** arg[0] 0 disables and 1 enables the write verify.
+ *  Response: arg[1] the write verify state
+ */
+void cmd_ext_mem_write_verify(uart_cmd_t *p_uart_cmd)
+{
+    memory_set_write_verify(p_uart_cmd->arg[0] != 0);
+    p_uart_cmd->arg[1] = memory_get_write_verify();
+    p_uart_cmd->nbr_arg = 2;
+    p_uart_cmd->paylen = 0;
+    p_uart_cmd->cmd_resp = UART_RESP_NO_ERROR;
+}
+
 void cmd_sfs_read(uart_cmd_t *p_uart_cmd)
 {
     sfs_file_info_t file_info;
@@ -465,18 +1339,20 @@ void cmd_sfs_read(uart_cmd_t *p_uart_cmd)
     p_uart_cmd->arg[index++] = file_info.file_header.data_len;
     p_uart_cmd->arg[index++] = file_info.file_header.status;
     p_uart_cmd->arg[index++] = file_info.address + sizeof(sfs_file_header_t) + file_info.file_header.data_len;
-    p_uart_cmd->arg[index++] = get_systick_timer() - time_ms;
-    p_uart_cmd->nbr_arg = index;
 
-    if (p_uart_cmd->cmd_resp == 0)
+    if ((p_uart_cmd->cmd_resp == 0) && payload_fits(p_uart_cmd, file_info.file_header.data_len))
     {
         p_uart_cmd->cmd_resp = sfs_read_file_data(&file_info, p_uart_cmd->payload, file_info.file_header.data_len);
     }
+    /** Search and data read time */
+    p_uart_cmd->arg[index++] = get_systick_timer() - time_ms;
+    p_uart_cmd->nbr_arg = index;
 }
 
 void cmd_sfs_write(uart_cmd_t *p_uart_cmd)
 {
     uint32_t address;
+    uint32_t end_address;
     sfs_file_header_t header;
     uint32_t time_ms;
     uint32_t index = 1;
@@ -484,14 +1360,14 @@ void cmd_sfs_write(uart_cmd_t *p_uart_cmd)
     /** Record the start time */
     time_ms = get_systick_timer();
     p_uart_cmd->cmd_resp = sfs_write_file(p_uart_cmd->arg[0], p_uart_cmd->payload, p_uart_cmd->paylen);
-    if (sfs_last_written_info(p_uart_cmd->arg[0], &address, &header) == SFS_STATUS_SUCCESS)
+    if (sfs_last_written_info(p_uart_cmd->arg[0], &address, &end_address, &header) == SFS_STATUS_SUCCESS)
     {
         /** Send the last written file info */
         p_uart_cmd->arg[index++] = address;
         p_uart_cmd->arg[index++] = header.file_id;
         p_uart_cmd->arg[index++] = header.data_len;
         p_uart_cmd->arg[index++] = header.status;
-        p_uart_cmd->arg[index++] = address + sizeof(header) + header.data_len;
+        p_uart_cmd->arg[index++] = end_address;
         p_uart_cmd->arg[index++] = get_systick_timer() - time_ms;
         p_uart_cmd->nbr_arg = index;
     }
@@ -504,25 +1380,245 @@ void cmd_sfs_write_in_parts(uart_cmd_t *p_uart_cmd)
 
 void cmd_sfs_read_in_parts(uart_cmd_t *p_uart_cmd)
 {
-    p_uart_cmd->cmd_resp = sfs_read_file_in_parts(p_uart_cmd->arg[0], p_uart_cmd->arg[1], p_uart_cmd->payload, p_uart_cmd->arg[2]);
-    p_uart_cmd->paylen = p_uart_cmd->arg[2];
+    if (payload_fits(p_uart_cmd, p_uart_cmd->arg[2]))
+    {
+        p_uart_cmd->cmd_resp = sfs_read_file_in_parts(p_uart_cmd->arg[0], p_uart_cmd->arg[1], p_uart_cmd->payload, p_uart_cmd->arg[2]);
+        p_uart_cmd->paylen = p_uart_cmd->arg[2];
+    }
 }
 
 void cmd_sfs_last_written(uart_cmd_t *p_uart_cmd)
 {
     uint32_t address;
+    uint32_t end_address;
     sfs_file_header_t header;
 
-    p_uart_cmd->cmd_resp = sfs_last_written_info(p_uart_cmd->arg[0], &address, &header);
+    p_uart_cmd->cmd_resp = sfs_last_written_info(p_uart_cmd->arg[0], &address, &end_address, &header);
     /** Send the last written file info */
     p_uart_cmd->arg[1] = address;
     p_uart_cmd->arg[2] = header.file_id;
     p_uart_cmd->arg[3] = header.data_len;
     p_uart_cmd->arg[4] = header.status;
-    p_uart_cmd->arg[5] = address + sizeof(header) + header.data_len;
+    p_uart_cmd->arg[5] = end_address;
     p_uart_cmd->nbr_arg = 6;
 }
 
+/** arg[0] file ID, arg[1] number of reads.
+ *  Response: arg[2] time of the copied reads, arg[3] time of the mapped reads in ms,
+ *  arg[4] status of the mapped read (SFS_STATUS_NOT_MAPPED when the folder is not mapped)
+ */
+void cmd_sfs_read_latency(uart_cmd_t *p_uart_cmd)
+{
+    sfs_file_info_t file_info;
+    const uint8_t *data;
+    uint32_t data_len;
+    uint32_t time_ms;
+    uint32_t i;
+    sfs_status_t status = SFS_STATUS_SUCCESS;
+
+    file_info.file_header.file_id = p_uart_cmd->arg[0];
+    p_uart_cmd->cmd_resp = sfs_read_file_info(&file_info);
+    p_uart_cmd->nbr_arg = 5;
+    p_uart_cmd->paylen = 0;
+    if ((p_uart_cmd->cmd_resp != SFS_STATUS_SUCCESS) || (file_info.file_header.data_len > p_uart_cmd->payload_size))
+    {
+        return;
+    }
+
+    /** Copy the file into the payload buffer */
+    time_ms = get_systick_timer();
+    for (i = 0; (i < p_uart_cmd->arg[1]) && (status == SFS_STATUS_SUCCESS); i++)
+    {
+        status = sfs_read_file(file_info.file_header.file_id, p_uart_cmd->payload, file_info.file_header.data_len);
+    }
+    p_uart_cmd->arg[2] = get_systick_timer() - time_ms;
+    p_uart_cmd->cmd_resp = status;
+
+    /** Get a pointer to the file */
+    time_ms = get_systick_timer();
+    for (i = 0; (i < p_uart_cmd->arg[1]) && (status == SFS_STATUS_SUCCESS); i++)
+    {
+        status = sfs_map_file(file_info.file_header.file_id, &data, &data_len);
+    }
+    p_uart_cmd->arg[3] = get_systick_timer() - time_ms;
+    p_uart_cmd->arg[4] = status;
+}
+
+/** arg[0] file ID, arg[1] offset in the file, arg[2] length, 0 up to the end of the file,
+ *  arg[3] data length per frame, 0 for UART_STREAM_CHUNK_LEN.
+ *  Response: arg[4] the length, arg[5] the number of data frames, arg[6] the data length
+ *  per frame. The data frames follow with the message ID of the request, response
+ *  UART_RESP_STREAM_DATA, arg[0] the sequence number and arg[1] the offset. The end frame
+ *  has the response UART_RESP_STREAM_END, arg[0] the number of data frames, arg[1] the
+ *  length and arg[2] the CRC16 of the range. The file must not be written meanwhile.
+ */
+void cmd_sfs_stream(uart_cmd_t *p_uart_cmd)
+{
+    uint32_t chunk_len = p_uart_cmd->arg[3] ? p_uart_cmd->arg[3] : UART_STREAM_CHUNK_LEN;
+
+    memset(&m_stream, 0, sizeof(m_stream));
+    p_uart_cmd->nbr_arg = 7;
+    p_uart_cmd->paylen = 0;
+    p_uart_cmd->arg[4] = 0;
+    p_uart_cmd->arg[5] = 0;
+    p_uart_cmd->arg[6] = 0;
+
+    if (chunk_len > UART_STREAM_CHUNK_LEN)
+    {
+        p_uart_cmd->cmd_resp = UART_RESP_CMD_DATA_ERROR;
+        return;
+    }
+
+    /** The file is searched once for the whole stream */
+    m_stream.file_info.file_header.file_id = p_uart_cmd->arg[0];
+    p_uart_cmd->cmd_resp = sfs_read_file_info(&m_stream.file_info);
+    if (p_uart_cmd->cmd_resp != SFS_STATUS_SUCCESS)
+    {
+        return;
+    }
+
+    m_stream.offset = p_uart_cmd->arg[1];
+    m_stream.length = p_uart_cmd->arg[2];
+    if (m_stream.offset > m_stream.file_info.file_header.data_len)
+    {
+        p_uart_cmd->cmd_resp = SFS_STATUS_FILE_LEN_MISMATCH;
+        return;
+    }
+    if (m_stream.length == 0)
+    {
+        m_stream.length = m_stream.file_info.file_header.data_len - m_stream.offset;
+    }
+    if (m_stream.length > (m_stream.file_info.file_header.data_len - m_stream.offset))
+    {
+        p_uart_cmd->cmd_resp = SFS_STATUS_FILE_LEN_MISMATCH;
+        return;
+    }
+
+    m_stream.msg_id = p_uart_cmd->msg_id;
+    m_stream.chunk_len = chunk_len;
+    m_stream.nbr_frames = (m_stream.length + chunk_len - 1) / chunk_len;
+    m_stream.crc16 = 0xFFFF;
+    m_stream.valid = true;
+
+    p_uart_cmd->arg[4] = m_stream.length;
+    p_uart_cmd->arg[5] = m_stream.nbr_frames;
+    p_uart_cmd->arg[6] = m_stream.chunk_len;
+}
+
+/** arg[0..n] sequence numbers of the frames to send again, the number of data frames
+ *  for the end frame. Only the frames already sent are sent again. The frames follow
+ *  the response.
+ *  Response: arg[n+1] the number of frames queued
+ */
+void cmd_sfs_stream_resend(uart_cmd_t *p_uart_cmd)
+{
+    uint16_t nbr_arg = SFS_SMALL(p_uart_cmd->nbr_arg, MAX_NBR_ARGU - 1);
+    uint32_t queued = 0;
+
+    p_uart_cmd->paylen = 0;
+    if (m_stream.valid == false)
+    {
+        p_uart_cmd->cmd_resp = UART_RESP_CMD_DATA_ERROR;
+        p_uart_cmd->nbr_arg = 0;
+        return;
+    }
+
+    for (uint16_t i = 0; i < nbr_arg; i++)
+    {
+        bool sent = (p_uart_cmd->arg[i] < m_stream.next_seq)
+                || ((p_uart_cmd->arg[i] == m_stream.nbr_frames) && m_stream.end_sent);
+
+        if (sent && (m_stream.resend_count < MAX_NBR_ARGU))
+        {
+            m_stream.resend[m_stream.resend_count++] = p_uart_cmd->arg[i];
+            queued++;
+        }
+    }
+
+    p_uart_cmd->arg[nbr_arg] = queued;
+    p_uart_cmd->nbr_arg = nbr_arg + 1;
+    p_uart_cmd->cmd_resp = UART_RESP_NO_ERROR;
+}
+
+/** arg[0] file ID, arg[1] file length. The data follows in COMMAND_SFS_UPLOAD_DATA frames.
+ *  Response: arg[2] the number of data frames the host may send ahead, arg[3] the bytes
+ *  they may take in total, arg[4] the largest data length per frame, its escaped frame
+ *  fits the window
+ */
+void cmd_sfs_upload(uart_cmd_t *p_uart_cmd)
+{
+    memset(&m_upload, 0, sizeof(m_upload));
+    p_uart_cmd->arg[2] = UART_CMD_QUEUE_LEN;
+    p_uart_cmd->arg[3] = UART_RX_WINDOW_BYTES;
+    p_uart_cmd->arg[4] = SFS_SMALL(UART_UPLOAD_DATA_MAX_LEN, MAX_PAYLOAD_LEN);
+    p_uart_cmd->nbr_arg = 5;
+    p_uart_cmd->paylen = 0;
+
+    if (p_uart_cmd->arg[1] == 0)
+    {
+        p_uart_cmd->cmd_resp = UART_RESP_CMD_DATA_ERROR;
+        return;
+    }
+
+    m_upload.file_id = p_uart_cmd->arg[0];
+    m_upload.length = p_uart_cmd->arg[1];
+    m_upload.active = true;
+    p_uart_cmd->cmd_resp = UART_RESP_NO_ERROR;
+}
+
+/** arg[0] offset of the data in the file.
+ *  The next frames are received by EasyDMA while the data is programmed. Frames are
+ *  acknowledged cumulatively, a response acknowledges its frame and the ones before.
+ *  A frame not at the next offset is dropped, the host sends again from the
+ *  acknowledged offset.
+ *  Response: arg[1] the number of bytes written in order
+ */
+void cmd_sfs_upload_data(uart_cmd_t *p_uart_cmd)
+{
+    bool ack;
+
+    if (m_upload.active == false)
+    {
+        p_uart_cmd->cmd_resp = UART_RESP_CMD_DATA_ERROR;
+    }
+    else if (p_uart_cmd->arg[0] != m_upload.written)
+    {
+        /** A frame before was lost, acknowledge so that the host goes back */
+        p_uart_cmd->cmd_resp = UART_RESP_NO_ERROR;
+    }
+    else if (p_uart_cmd->paylen > (m_upload.length - m_upload.written))
+    {
+        p_uart_cmd->cmd_resp = SFS_STATUS_FILE_LEN_MISMATCH;
+        m_upload.active = false;
+    }
+    else
+    {
+        p_uart_cmd->cmd_resp = sfs_write_file_in_parts(m_upload.file_id, m_upload.length - m_upload.written,
+                                                       p_uart_cmd->payload, p_uart_cmd->paylen);
+        if (p_uart_cmd->cmd_resp == SFS_STATUS_SUCCESS)
+        {
+            m_upload.written += p_uart_cmd->paylen;
+            m_upload.unacked++;
+            ack = (m_upload.written == m_upload.length) || (m_upload.unacked >= UART_UPLOAD_ACK_FRAMES) || (m_cmd_count <= 1);
+            if (ack == false)
+            {
+                p_uart_cmd->cmd_resp = UART_RESP_NONE;
+                return;
+            }
+            m_upload.active = (m_upload.written < m_upload.length);
+        }
+        else
+        {
+            m_upload.active = false;
+        }
+    }
+
+    m_upload.unacked = 0;
+    p_uart_cmd->arg[1] = m_upload.written;
+    p_uart_cmd->nbr_arg = 2;
+    p_uart_cmd->paylen = 0;
+}
+
 void cmd_meas_write(uart_cmd_t *p_uart_cmd)
 {
     p_uart_cmd->cmd_resp = write_measurement_in_parts(p_uart_cmd->arg[0], p_uart_cmd->payload, p_uart_cmd->paylen);
@@ -531,6 +1627,9 @@ void cmd_meas_write(uart_cmd_t *p_uart_cmd)
 void cmd_meas_read(uart_cmd_t *p_uart_cmd)
 {
     uint32_t address = first_written_file_address();
-    p_uart_cmd->cmd_resp = read_measurement_in_parts(address, p_uart_cmd->arg[0], p_uart_cmd->payload, p_uart_cmd->arg[1]);
-    p_uart_cmd->paylen = p_uart_cmd->arg[1];
+    if (payload_fits(p_uart_cmd, p_uart_cmd->arg[1]))
+    {
+        p_uart_cmd->cmd_resp = read_measurement_in_parts(address, p_uart_cmd->arg[0], p_uart_cmd->payload, p_uart_cmd->arg[1]);
+        p_uart_cmd->paylen = p_uart_cmd->arg[1];
+    }
 }
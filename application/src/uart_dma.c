@@ -0,0 +1,480 @@
+#include <string.h>
+#include "boards.h"
+#include "sdk_config.h"
+#include "nrf_error.h"
+#include "app_error.h"
+#include "app_util_platform.h"
+#include "nrf_delay.h"
+#include "nrfx_uarte.h"
+#include "nrf_timer.h"
+#include "nrf_ppi.h"
+#include "systick.h"
+#include "uart_dma.h"
+
+#define UART_DMA_INSTANCE 0
+static const nrfx_uarte_t m_uarte = NRFX_UARTE_INSTANCE(UART_DMA_INSTANCE);
+
+/** Counter of the received bytes, incremented by RXDRDY through PPI */
+#ifndef UART_DMA_COUNT_TIMER
+#define UART_DMA_COUNT_TIMER       NRF_TIMER3
+#endif
+/** RX timeout timer, cleared and started by RXDRDY through PPI */
+#ifndef UART_DMA_TIMEOUT_TIMER
+#define UART_DMA_TIMEOUT_TIMER     NRF_TIMER4
+#define UART_DMA_TIMEOUT_IRQn      TIMER4_IRQn
+#define UART_DMA_TIMEOUT_IRQHandler TIMER4_IRQHandler
+#endif
+#ifndef UART_DMA_COUNT_PPI_CHANNEL
+#define UART_DMA_COUNT_PPI_CHANNEL   NRF_PPI_CHANNEL1
+#endif
+#ifndef UART_DMA_TIMEOUT_PPI_CHANNEL
+#define UART_DMA_TIMEOUT_PPI_CHANNEL NRF_PPI_CHANNEL2
+#endif
+/** Wait for a transmit buffer beyond its time on the line, the host may never assert CTS */
+#ifndef UART_DMA_TX_TIMEOUT_MS
+#define UART_DMA_TX_TIMEOUT_MS       100
+#endif
+
+/** Receive buffers, the reader releases them in order */
+static uint8_t m_rx_buffer[UART_DMA_RX_NBR_BUFFERS][UART_DMA_RX_BUFFER_LEN];
+/** Bytes received in each buffer */
+static volatile uint32_t m_rx_len[UART_DMA_RX_NBR_BUFFERS];
+/** Buffer filled by the UARTE */
+static volatile uint8_t m_rx_write;
+/** Buffers given to the UARTE, the one being filled and the queued one */
+static volatile uint8_t m_rx_queued;
+/** Filled buffers not released by the reader */
+static volatile uint8_t m_rx_filled;
+/** Byte count at the start of the buffer being filled */
+static volatile uint32_t m_rx_start_count;
+/** Buffer and offset of the reader */
+static uint8_t m_rx_read;
+static uint32_t m_rx_offset;
+
+/** Two transmit buffers, one is written while the other one is sent */
+static uint8_t m_tx_buffer[2][UART_DMA_TX_BUFFER_LEN];
+static uint8_t m_tx_index;
+static size_t m_tx_len;
+static volatile bool m_tx_busy;
+/** First error of the buffers sent since the last flush returned */
+static ret_code_t m_tx_err_code;
+/** Longest time a buffer may take to be sent */
+static uint32_t m_tx_timeout_ms;
+
+static uart_dma_stats_t m_stats;
+/** Baud rate in bits per second and flow control of the current configuration */
+static uint32_t m_bits_per_s;
+static bool m_hwfc;
+
+/** Baud rates supported by the UARTE */
+static const struct
+{
+    uint32_t bits_per_s;
+    uint32_t baudrate;
+} m_baudrates[] = { { 9600, NRF_UARTE_BAUDRATE_9600 },
+                    { 19200, NRF_UARTE_BAUDRATE_19200 },
+                    { 38400, NRF_UARTE_BAUDRATE_38400 },
+                    { 57600, NRF_UARTE_BAUDRATE_57600 },
+                    { 115200, NRF_UARTE_BAUDRATE_115200 },
+                    { 230400, NRF_UARTE_BAUDRATE_230400 },
+                    { 250000, NRF_UARTE_BAUDRATE_250000 },
+                    { 460800, NRF_UARTE_BAUDRATE_460800 },
+                    { 921600, NRF_UARTE_BAUDRATE_921600 },
+                    { 1000000, NRF_UARTE_BAUDRATE_1000000 } };
+
+/**@brief Number of bytes received, captured from the counter timer */
+static uint32_t rx_count(void)
+{
+    nrf_timer_task_trigger(UART_DMA_COUNT_TIMER, NRF_TIMER_TASK_CAPTURE0);
+    return nrf_timer_cc_read(UART_DMA_COUNT_TIMER, NRF_TIMER_CC_CHANNEL0);
+}
+
+/**@brief Queue the next free buffer after the ones given to the UARTE
+ *
+ * Called from the UARTE interrupt and, with the interrupt masked, by the reader.
+ */
+static void rx_queue(void)
+{
+    uint8_t index;
+
+    if ((m_rx_queued >= 2) || ((m_rx_queued + m_rx_filled) >= UART_DMA_RX_NBR_BUFFERS))
+    {
+        return;
+    }
+
+    index = (m_rx_write + m_rx_queued) % UART_DMA_RX_NBR_BUFFERS;
+    m_rx_len[index] = 0;
+    if (nrfx_uarte_rx(&m_uarte, m_rx_buffer[index], UART_DMA_RX_BUFFER_LEN) == NRFX_SUCCESS)
+    {
+        m_rx_queued++;
+    }
+}
+
+/**@brief The buffer being filled is full, the UARTE continues in the queued buffer */
+static void rx_buffer_done(uint32_t len)
+{
+    m_rx_len[m_rx_write] = len;
+    m_rx_start_count += len;
+    m_rx_write = (m_rx_write + 1) % UART_DMA_RX_NBR_BUFFERS;
+    m_rx_queued--;
+    m_rx_filled++;
+    m_stats.rx_buffers++;
+}
+
+static void uart_dma_event_handler(nrfx_uarte_event_t const *p_event, void *p_context)
+{
+    uint32_t len;
+
+    switch (p_event->type)
+    {
+        case NRFX_UARTE_EVT_RX_DONE:
+            rx_buffer_done(p_event->data.rxtx.bytes);
+            if (m_rx_queued == 0)
+            {
+                /* No buffer was free, the reception restarts when the reader releases one.
+                 * With the flow control the UARTE holds the next bytes until then and the
+                 * count stays exact, without it the bytes received meanwhile are lost */
+                m_stats.rx_overruns++;
+                if (!m_hwfc)
+                {
+                    m_rx_start_count = rx_count();
+                }
+            }
+            rx_queue();
+            break;
+
+        case NRFX_UARTE_EVT_ERROR:
+            /* The driver aborts the reception, it restarts in the next buffer. The
+             * amount register is not updated yet, the counter gives the bytes received */
+            m_stats.rx_errors++;
+            if (m_rx_queued > 0)
+            {
+                len = rx_count() - m_rx_start_count;
+                rx_buffer_done((len < UART_DMA_RX_BUFFER_LEN) ? len : UART_DMA_RX_BUFFER_LEN);
+            }
+            m_rx_queued = 0;
+            m_rx_start_count = rx_count();
+            rx_queue();
+            rx_queue();
+            break;
+
+        case NRFX_UARTE_EVT_TX_DONE:
+            m_stats.tx_bytes += p_event->data.rxtx.bytes;
+            m_tx_busy = false;
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**@brief The line is idle, the bytes of the buffer being filled are in RAM */
+void UART_DMA_TIMEOUT_IRQHandler(void)
+{
+    uint32_t len;
+
+    nrf_timer_event_clear(UART_DMA_TIMEOUT_TIMER, NRF_TIMER_EVENT_COMPARE0);
+    if (m_rx_queued > 0)
+    {
+        len = rx_count() - m_rx_start_count;
+        m_rx_len[m_rx_write] = (len < UART_DMA_RX_BUFFER_LEN) ? len : UART_DMA_RX_BUFFER_LEN;
+    }
+    m_stats.rx_timeouts++;
+}
+
+/**@brief Count RXDRDY and restart the RX timeout on each byte
+ *
+ * @param[in]  timeout_us Idle time after the last byte
+ */
+static void rx_timers_init(uint32_t timeout_us)
+{
+    uint32_t rxdrdy = nrfx_uarte_event_address_get(&m_uarte, NRF_UARTE_EVENT_RXDRDY);
+
+    nrf_timer_mode_set(UART_DMA_COUNT_TIMER, NRF_TIMER_MODE_COUNTER);
+    nrf_timer_bit_width_set(UART_DMA_COUNT_TIMER, NRF_TIMER_BIT_WIDTH_32);
+    nrf_timer_task_trigger(UART_DMA_COUNT_TIMER, NRF_TIMER_TASK_CLEAR);
+    nrf_timer_task_trigger(UART_DMA_COUNT_TIMER, NRF_TIMER_TASK_START);
+
+    nrf_timer_mode_set(UART_DMA_TIMEOUT_TIMER, NRF_TIMER_MODE_TIMER);
+    nrf_timer_bit_width_set(UART_DMA_TIMEOUT_TIMER, NRF_TIMER_BIT_WIDTH_32);
+    nrf_timer_frequency_set(UART_DMA_TIMEOUT_TIMER, NRF_TIMER_FREQ_1MHz);
+    nrf_timer_cc_write(UART_DMA_TIMEOUT_TIMER, NRF_TIMER_CC_CHANNEL0, timeout_us);
+    /* One timeout per burst, the next byte starts the timer again */
+    nrf_timer_shorts_enable(UART_DMA_TIMEOUT_TIMER, NRF_TIMER_SHORT_COMPARE0_STOP_MASK | NRF_TIMER_SHORT_COMPARE0_CLEAR_MASK);
+    nrf_timer_event_clear(UART_DMA_TIMEOUT_TIMER, NRF_TIMER_EVENT_COMPARE0);
+    nrf_timer_int_enable(UART_DMA_TIMEOUT_TIMER, NRF_TIMER_INT_COMPARE0_MASK);
+    NRFX_IRQ_PRIORITY_SET(UART_DMA_TIMEOUT_IRQn, NRFX_UARTE_DEFAULT_CONFIG_IRQ_PRIORITY);
+    NRFX_IRQ_ENABLE(UART_DMA_TIMEOUT_IRQn);
+
+    nrf_ppi_channel_endpoint_setup(UART_DMA_COUNT_PPI_CHANNEL, rxdrdy,
+            (uint32_t) nrf_timer_task_address_get(UART_DMA_COUNT_TIMER, NRF_TIMER_TASK_COUNT));
+    nrf_ppi_channel_and_fork_endpoint_setup(UART_DMA_TIMEOUT_PPI_CHANNEL, rxdrdy,
+            (uint32_t) nrf_timer_task_address_get(UART_DMA_TIMEOUT_TIMER, NRF_TIMER_TASK_CLEAR),
+            (uint32_t) nrf_timer_task_address_get(UART_DMA_TIMEOUT_TIMER, NRF_TIMER_TASK_START));
+    nrf_ppi_channel_enable(UART_DMA_COUNT_PPI_CHANNEL);
+    nrf_ppi_channel_enable(UART_DMA_TIMEOUT_PPI_CHANNEL);
+}
+
+/**@brief Stop the buffer being sent
+ *
+ * STOPTX ends the transfer with ENDTX within a character, the driver then reports
+ * TX_DONE with the bytes sent.
+ */
+static void tx_abort(void)
+{
+    nrfx_uarte_tx_abort(&m_uarte);
+    while (m_tx_busy)
+    {
+        __WFE();
+    }
+}
+
+/**@brief Sleep till the buffer being sent is done, the SysTick wakes the CPU each ms
+ *
+ * @return NRF_ERROR_TIMEOUT when the buffer was not sent in time and was aborted
+ */
+static ret_code_t tx_wait(void)
+{
+    uint32_t start_ms = get_systick_timer();
+
+    while (m_tx_busy)
+    {
+        if ((get_systick_timer() - start_ms) >= m_tx_timeout_ms)
+        {
+            tx_abort();
+            m_stats.tx_timeouts++;
+            return NRF_ERROR_TIMEOUT;
+        }
+        __WFE();
+    }
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t uart_dma_init(uint32_t baudrate, bool hwfc)
+{
+    nrfx_uarte_config_t config = NRFX_UARTE_DEFAULT_CONFIG;
+    uint32_t bits_per_s;
+    ret_code_t err_code;
+
+    config.pseltxd = TX_PIN_NUMBER;
+    config.pselrxd = RX_PIN_NUMBER;
+    config.pselcts = CTS_PIN_NUMBER;
+    config.pselrts = RTS_PIN_NUMBER;
+    config.hwfc = hwfc ? NRF_UARTE_HWFC_ENABLED : NRF_UARTE_HWFC_DISABLED;
+    config.baudrate = (nrf_uarte_baudrate_t) baudrate;
+
+    err_code = nrfx_uarte_init(&m_uarte, &config, uart_dma_event_handler);
+    if (err_code != NRFX_SUCCESS)
+    {
+        return err_code;
+    }
+
+    /* The BAUDRATE register is the baud rate scaled by 2^32 / 16 MHz, 10 bits per character */
+    bits_per_s = (uint32_t) (((uint64_t) baudrate * 16000000) >> 32);
+    rx_timers_init((UART_DMA_RX_TIMEOUT_CHARS * 10 * 1000000UL) / bits_per_s + 1);
+    m_bits_per_s = bits_per_s;
+    m_hwfc = hwfc;
+    m_tx_timeout_ms = (UART_DMA_TX_BUFFER_LEN * 10 * 1000UL) / bits_per_s + UART_DMA_TX_TIMEOUT_MS;
+
+    m_tx_index = 0;
+    m_tx_len = 0;
+    m_tx_busy = false;
+    m_tx_err_code = NRF_SUCCESS;
+    m_rx_write = 0;
+    m_rx_queued = 0;
+    m_rx_filled = 0;
+    m_rx_read = 0;
+    m_rx_offset = 0;
+    m_rx_start_count = rx_count();
+    rx_queue();
+    rx_queue();
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t uart_dma_reconfigure(uint32_t baudrate, bool hwfc)
+{
+    uart_dma_flush();
+    tx_wait();
+    /* ENDTX comes when the last byte is read from RAM, let it leave the shift register */
+    nrf_delay_us((2 * 10 * 1000000UL) / m_bits_per_s + 1);
+
+    nrf_ppi_channel_disable(UART_DMA_COUNT_PPI_CHANNEL);
+    nrf_ppi_channel_disable(UART_DMA_TIMEOUT_PPI_CHANNEL);
+    NRFX_IRQ_DISABLE(UART_DMA_TIMEOUT_IRQn);
+    nrf_timer_task_trigger(UART_DMA_TIMEOUT_TIMER, NRF_TIMER_TASK_STOP);
+    nrf_timer_task_trigger(UART_DMA_COUNT_TIMER, NRF_TIMER_TASK_STOP);
+    nrfx_uarte_uninit(&m_uarte);
+
+    return uart_dma_init(baudrate, hwfc);
+}
+
+uint32_t uart_dma_baudrate_get(uint32_t bits_per_s)
+{
+    for (uint32_t i = 0; i < (sizeof(m_baudrates) / sizeof(m_baudrates[0])); i++)
+    {
+        if (m_baudrates[i].bits_per_s == bits_per_s)
+        {
+            return m_baudrates[i].baudrate;
+        }
+    }
+
+    return 0;
+}
+
+/**@brief Move the reader to the next buffer once the UARTE left the read buffer
+ *        and all its data is released
+ */
+static void rx_read_next(void)
+{
+    while ((m_rx_filled > 0) && (m_rx_offset >= m_rx_len[m_rx_read]))
+    {
+        m_rx_read = (m_rx_read + 1) % UART_DMA_RX_NBR_BUFFERS;
+        m_rx_offset = 0;
+
+        NRFX_IRQ_DISABLE(nrfx_get_irq_number(m_uarte.p_reg));
+        m_rx_filled--;
+        if ((m_rx_queued == 0) && !m_hwfc)
+        {
+            /* Restart the reception stopped by an overrun */
+            m_rx_start_count = rx_count();
+        }
+        rx_queue();
+        rx_queue();
+        NRFX_IRQ_ENABLE(nrfx_get_irq_number(m_uarte.p_reg));
+    }
+}
+
+bool uart_dma_rx_get(const uint8_t **data, size_t *len)
+{
+    uint32_t rx_len;
+
+    /* A buffer ended by an error may be empty */
+    rx_read_next();
+    rx_len = m_rx_len[m_rx_read];
+    if (rx_len <= m_rx_offset)
+    {
+        return false;
+    }
+
+    *data = &m_rx_buffer[m_rx_read][m_rx_offset];
+    *len = rx_len - m_rx_offset;
+    return true;
+}
+
+void uart_dma_rx_release(size_t len)
+{
+    m_rx_offset += len;
+    m_stats.rx_bytes += len;
+    rx_read_next();
+}
+
+/**@brief Send a full buffer while writing, an error is kept for the next flush */
+static void tx_flush_full(void)
+{
+    ret_code_t err_code = uart_dma_flush();
+
+    if (m_tx_err_code == NRF_SUCCESS)
+    {
+        m_tx_err_code = err_code;
+    }
+}
+
+void uart_dma_put(uint8_t byte)
+{
+    m_tx_buffer[m_tx_index][m_tx_len++] = byte;
+    if (m_tx_len == UART_DMA_TX_BUFFER_LEN)
+    {
+        tx_flush_full();
+    }
+}
+
+void uart_dma_write(const uint8_t *data, size_t len)
+{
+    uint8_t *buffer;
+    size_t space;
+
+    while (len > 0)
+    {
+        space = uart_dma_tx_reserve(&buffer);
+        if (space > len)
+        {
+            space = len;
+        }
+        memcpy(buffer, data, space);
+        uart_dma_tx_commit(space);
+        data += space;
+        len -= space;
+    }
+}
+
+size_t uart_dma_tx_reserve(uint8_t **buffer)
+{
+    if ((UART_DMA_TX_BUFFER_LEN - m_tx_len) < 2)
+    {
+        tx_flush_full();
+    }
+
+    *buffer = &m_tx_buffer[m_tx_index][m_tx_len];
+    return UART_DMA_TX_BUFFER_LEN - m_tx_len;
+}
+
+void uart_dma_tx_commit(size_t len)
+{
+    m_tx_len += len;
+    if (m_tx_len == UART_DMA_TX_BUFFER_LEN)
+    {
+        tx_flush_full();
+    }
+}
+
+ret_code_t uart_dma_flush(void)
+{
+    ret_code_t err_code = m_tx_err_code;
+    ret_code_t tx_err_code;
+
+    m_tx_err_code = NRF_SUCCESS;
+    if (m_tx_len == 0)
+    {
+        return err_code;
+    }
+
+    /* The other buffer is written while this one is sent */
+    if ((tx_wait() != NRF_SUCCESS) && (err_code == NRF_SUCCESS))
+    {
+        err_code = NRF_ERROR_TIMEOUT;
+    }
+    m_tx_busy = true;
+    tx_err_code = nrfx_uarte_tx(&m_uarte, m_tx_buffer[m_tx_index], m_tx_len);
+    if (tx_err_code != NRFX_SUCCESS)
+    {
+        m_tx_busy = false;
+        m_stats.tx_errors++;
+        err_code = (err_code != NRF_SUCCESS) ? err_code : tx_err_code;
+    }
+
+    m_tx_index ^= 1;
+    m_tx_len = 0;
+    return err_code;
+}
+
+void uart_dma_tx_abort(void)
+{
+    if (m_tx_busy)
+    {
+        tx_abort();
+    }
+    m_tx_len = 0;
+    m_tx_err_code = NRF_SUCCESS;
+}
+
+void uart_dma_get_stats(uart_dma_stats_t *stats)
+{
+    *stats = m_stats;
+}
+
+void uart_dma_clear_stats(void)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
@@ -0,0 +1,301 @@
+#include <string.h>
+
+#include "uart_frame.h"
+#include "crc16.h"
+
+#define ONES_32     0x01010101UL
+#define HIGHS_32    0x80808080UL
+
+/** Initial value of crc16_compute */
+#define CRC16_INIT  0xFFFF
+
+/** Non zero when a byte of the word is zero */
+#define HAS_ZERO_BYTE(v)    (((v) - ONES_32) & ~(v) & HIGHS_32)
+/** Non zero when a byte of the word equals c */
+#define HAS_BYTE(v, c)      HAS_ZERO_BYTE((v) ^ (ONES_32 * (c)))
+
+static bool is_special(uint8_t byte)
+{
+    return (byte == UART_FRAME_STX) || (byte == UART_FRAME_ETX) || (byte == UART_FRAME_DLE);
+}
+
+void uart_frame_init(uart_frame_t *frame, uint8_t *buffer, size_t size)
+{
+    frame->buffer = buffer;
+    frame->size = size;
+    frame->len = 0;
+    frame->crc16 = CRC16_INIT;
+    frame->in_frame = false;
+    frame->escape = false;
+    frame->overflow = false;
+    frame->mode = UART_FRAME_MODE_DLE;
+    frame->cobs_remaining = 0;
+    frame->cobs_zero = false;
+}
+
+void uart_frame_set_mode(uart_frame_t *frame, uart_frame_mode_t mode)
+{
+    uart_frame_init(frame, frame->buffer, frame->size);
+    frame->mode = mode;
+}
+
+void uart_frame_set_buffer(uart_frame_t *frame, uint8_t *buffer, size_t size)
+{
+    frame->buffer = buffer;
+    frame->size = size;
+    frame->len = 0;
+    frame->crc16 = CRC16_INIT;
+}
+
+void uart_frame_move_buffer(uart_frame_t *frame, uint8_t *buffer, size_t size)
+{
+    frame->buffer = buffer;
+    frame->size = size;
+}
+
+size_t uart_frame_find_special(const uint8_t *data, size_t len)
+{
+    size_t index = 0;
+    uint32_t word;
+
+    /** Bytewise up to the first aligned word */
+    while ((index < len) && (((uintptr_t) (data + index) % sizeof(uint32_t)) != 0))
+    {
+        if (is_special(data[index]))
+        {
+            return index;
+        }
+        index++;
+    }
+
+    /** A word at a time, the matching byte is then found bytewise */
+    while ((index + sizeof(uint32_t)) <= len)
+    {
+        word = *(const uint32_t*) (data + index);
+        if (HAS_BYTE(word, UART_FRAME_STX) | HAS_BYTE(word, UART_FRAME_ETX) | HAS_BYTE(word, UART_FRAME_DLE))
+        {
+            break;
+        }
+        index += sizeof(uint32_t);
+    }
+
+    while (index < len)
+    {
+        if (is_special(data[index]))
+        {
+            return index;
+        }
+        index++;
+    }
+
+    return len;
+}
+
+size_t uart_frame_escape(uint8_t *out, size_t size, const uint8_t *data, size_t len, size_t *used)
+{
+    size_t index = 0;
+    size_t written = 0;
+    size_t run;
+
+    while ((index < len) && (written < size))
+    {
+        run = len - index;
+        if (run > (size - written))
+        {
+            run = size - written;
+        }
+        run = uart_frame_find_special(data + index, run);
+        memcpy(out + written, data + index, run);
+        written += run;
+        index += run;
+
+        if ((index == len) || (written == size) || !is_special(data[index]))
+        {
+            continue;
+        }
+
+        if ((size - written) < 2)
+        {
+            break;
+        }
+        out[written++] = UART_FRAME_DLE;
+        out[written++] = (uint8_t) ~data[index++];
+    }
+
+    *used = index;
+    return written;
+}
+
+/**@brief Start a frame, or start again when the previous one was not complete
+ */
+static void frame_restart(uart_frame_t *frame)
+{
+    frame->overflow = false;
+    frame->len = 0;
+    frame->crc16 = CRC16_INIT;
+}
+
+/**@brief Append bytes to the frame, the frame is marked as overflowed when they do not fit
+ *
+ * The bytes after the CRC field are added to the CRC while they are in the cache.
+ */
+static void frame_append(uart_frame_t *frame, const uint8_t *data, size_t len)
+{
+    size_t skip;
+
+    if (frame->overflow || (len == 0))
+    {
+        return;
+    }
+
+    if ((frame->len + len) > frame->size)
+    {
+        frame->overflow = true;
+        return;
+    }
+
+    memcpy(frame->buffer + frame->len, data, len);
+    skip = (frame->len < UART_FRAME_CRC_LEN) ? (UART_FRAME_CRC_LEN - frame->len) : 0;
+    if (len > skip)
+    {
+        frame->crc16 = crc16_compute(data + skip, len - skip, &frame->crc16);
+    }
+    frame->len += len;
+}
+
+/**@brief Decode COBS blocks, a zero ends the frame
+ */
+static bool cobs_deframe(uart_frame_t *frame, const uint8_t *data, size_t len, size_t *used)
+{
+    static const uint8_t zero = 0;
+    size_t index = 0;
+    size_t run;
+    const uint8_t *delimiter;
+    uint8_t code;
+
+    while (index < len)
+    {
+        if (frame->cobs_remaining > 0)
+        {
+            run = len - index;
+            if (run > frame->cobs_remaining)
+            {
+                run = frame->cobs_remaining;
+            }
+            delimiter = memchr(data + index, UART_FRAME_COBS_DELIMITER, run);
+            if (delimiter != NULL)
+            {
+                /** The frame ended inside a block, it is corrupted */
+                index = (size_t) (delimiter - data) + 1;
+                frame->in_frame = false;
+                frame->cobs_remaining = 0;
+                continue;
+            }
+            frame_append(frame, data + index, run);
+            index += run;
+            frame->cobs_remaining -= run;
+            continue;
+        }
+
+        code = data[index++];
+        if (code == UART_FRAME_COBS_DELIMITER)
+        {
+            /** The zero after the last block is not part of the data */
+            if (frame->in_frame && !frame->overflow)
+            {
+                frame->in_frame = false;
+                *used = index;
+                return true;
+            }
+            frame->in_frame = false;
+            continue;
+        }
+
+        if (!frame->in_frame)
+        {
+            frame->in_frame = true;
+            frame_restart(frame);
+        }
+        else if (frame->cobs_zero)
+        {
+            frame_append(frame, &zero, 1);
+        }
+        frame->cobs_remaining = code - 1;
+        /** A full block is not followed by a zero */
+        frame->cobs_zero = (code != (UART_FRAME_COBS_BLOCK_LEN + 1));
+    }
+
+    *used = index;
+    return false;
+}
+
+bool uart_frame_deframe(uart_frame_t *frame, const uint8_t *data, size_t len, size_t *used)
+{
+    size_t index = 0;
+    size_t run;
+    uint8_t byte;
+
+    if (frame->mode == UART_FRAME_MODE_COBS)
+    {
+        return cobs_deframe(frame, data, len, used);
+    }
+
+    while (index < len)
+    {
+        if (!frame->in_frame)
+        {
+            /** Skip the bytes received outside a frame */
+            const uint8_t *stx = memchr(data + index, UART_FRAME_STX, len - index);
+            if (stx == NULL)
+            {
+                index = len;
+                break;
+            }
+            index = (size_t) (stx - data) + 1;
+            frame->in_frame = true;
+            frame->escape = false;
+            frame_restart(frame);
+            continue;
+        }
+
+        if (frame->escape)
+        {
+            byte = (uint8_t) ~data[index++];
+            frame->escape = false;
+            frame_append(frame, &byte, 1);
+            continue;
+        }
+
+        /** Copy the run of plain bytes up to the next special character */
+        run = uart_frame_find_special(data + index, len - index);
+        frame_append(frame, data + index, run);
+        index += run;
+        if (index >= len)
+        {
+            break;
+        }
+
+        byte = data[index++];
+        if (byte == UART_FRAME_DLE)
+        {
+            frame->escape = true;
+        }
+        else if (byte == UART_FRAME_STX)
+        {
+            /** The previous frame was not complete, start again */
+            frame_restart(frame);
+        }
+        else
+        {
+            frame->in_frame = false;
+            if (!frame->overflow)
+            {
+                *used = index;
+                return true;
+            }
+        }
+    }
+
+    *used = index;
+    return false;
+}
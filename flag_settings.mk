@@ -22,6 +22,8 @@ CFLAGS += -fno-builtin -fshort-enums
 CFLAGS += -MD
 CFLAGS += -D__HEAP_SIZE=32768
 CFLAGS += -D__STACK_SIZE=32768
+# CONFIG folder in the internal flash, read in place
+CFLAGS += -DSTORAGE_CONFIG_BACKEND=flash_backend_nvmc
 
 # C++ flags common to all targets
 CXXFLAGS += $(OPT)
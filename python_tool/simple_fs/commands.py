@@ -13,6 +13,14 @@ class Command(CommandBase):
     CMD_DEFAULT = 0x0
     CMD_UART_TRANSFER = 0x1
     CMD_DEVICE_RESTART = 0x2
+    """ Negotiate the baud rate and flow control """
+    CMD_UART_CONFIG = 0x3
+    """ Credits of the request window """
+    CMD_UART_WINDOW = 0x4
+    """ Switch between DLE escaping and COBS framing """
+    CMD_UART_FRAMING = 0x5
+    """ Reads, writes and erases executed together, answered in one frame """
+    COMMAND_BATCH = 0x6
 
     """Command to write raw data into ext mem """
     COMMAND_EXT_MEM_WRITE = 0x0010
@@ -22,6 +30,18 @@ class Command(CommandBase):
     COMMAND_EXT_MEM_PAGE_ERASE = 0x0012
     """ External Memory chip erase """
     COMMAND_EXT_MEM_CHIP_ERASE = 0x0013
+    """ External Memory erase plan (dry run) """
+    COMMAND_EXT_MEM_ERASE_PLAN = 0x0014
+    """ External Memory erase counters """
+    COMMAND_EXT_MEM_ERASE_STATS = 0x0015
+    """ External Memory blank check """
+    COMMAND_EXT_MEM_BLANK_CHECK = 0x0016
+    """ External Memory SPI frequencies """
+    COMMAND_EXT_MEM_SPI_FREQUENCY = 0x0017
+    COMMAND_EXT_MEM_STATS = 0x0018
+    COMMAND_EXT_MEM_WAKE_BENCHMARK = 0x0019
+    COMMAND_EXT_MEM_POWER = 0x001A
+    COMMAND_EXT_MEM_WRITE_VERIFY = 0x001B
 
     """ External Memory Write """
     COMMAND_SFS_WRITE = 0x0101
@@ -33,6 +53,14 @@ class Command(CommandBase):
     COMMAND_SFS_WRITE_IN_PARTS = 0x0103
     """ Last written file info """
     COMMAND_SFS_LAST_WRITTEN = 0x0104
+    """ Read latency of a file, copied and memory mapped """
+    COMMAND_SFS_READ_LATENCY = 0x0105
+    """ Stream a file range, and send frames of it again """
+    COMMAND_SFS_STREAM = 0x0106
+    COMMAND_SFS_STREAM_RESEND = 0x0107
+    """ Upload a file with cumulative acknowledges """
+    COMMAND_SFS_UPLOAD = 0x0108
+    COMMAND_SFS_UPLOAD_DATA = 0x0109
 
     """ Measurement File Command  """
     COMMAND_MEAS_WRITE = 0x0201
@@ -2,6 +2,15 @@
 from .transport_layer import Cmd_Data
 from .transport_layer import Transport
 from .transport_layer import data_reader
+from .transport_layer import COMSPEED
+from .transport_layer import RESP_BUSY
+from .transport_layer import RESP_STREAM_DATA
+from .transport_layer import RESP_STREAM_END
+from .transport_layer import FRAMING_DLE
+from .transport_layer import FRAMING_COBS
+from .transport_layer import dle_escape
+from .transport_layer import cobs_encode
+from .transport_layer import MAX_PAYLOAD_LEN
 from .commands import Command
 from subprocess import call
 import random
@@ -13,6 +22,7 @@ import logging
 import zipfile
 import shutil
 import struct
+import math
 from tkinter import *
 from tkinter import scrolledtext
 
@@ -85,6 +95,210 @@ class Simple_FS(object):
             else:
                 print("%d:Test success Round trip: %s seconds" % (i, (stop - start)))
 
+    def uart_link_test(self, test_data_len=1000):
+        """ Echo a packet through COMMAND_UART_TEST, True when it comes back unchanged """
+        self.cmd_data.clear()
+        self.cmd_data.cmd = Command.CMD_UART_TRANSFER
+        payload = [(random.randint(0, 255)) for __ in range (test_data_len)]
+        self.cmd_data.payload = payload
+        msg_id = self.transport.write_cmd(self.cmd_data)
+        read_cmd = self.transport.read_response(msg_id=msg_id, timeout_s=1)
+        if (read_cmd is None or read_cmd.cmd != 0):
+            return False
+        return [read_cmd.payload[j] for j in range (read_cmd.paylen)] == payload
+
+    def uart_config(self, baudrate, hwfc=1, confirm_ms=1000):
+        """ Negotiate the baud rate and flow control, both sides fall back to 115200 when the link test fails """
+        self.cmd_data.clear()
+        self.cmd_data.cmd = Command.CMD_UART_CONFIG
+        self.cmd_data.arg = [baudrate, hwfc, confirm_ms]
+        msg_id = self.transport.write_cmd(self.cmd_data)
+        read_cmd = self.transport.read_response(msg_id=msg_id, timeout_s=2)
+        if (read_cmd is None or read_cmd.cmd != 0):
+            print("Baud rate %d not supported" % baudrate)
+            return False
+        # The device switches once its response is sent
+        time.sleep(0.05)
+        self.transport.set_speed(baudrate, hwfc != 0)
+        if (self.uart_link_test()):
+            return True
+        print("Link test failed at %d baud, back to %d" % (baudrate, COMSPEED))
+        time.sleep(confirm_ms / 1000.0)
+        self.transport.set_speed(COMSPEED, True)
+        return self.uart_link_test()
+
+    def uart_speed_benchmark(self):
+        """ Read 64K of the external memory at each baud rate """
+        read_len = 0x10000
+        chunk = 4096
+        for baudrate in [115200, 460800, 1000000]:
+            if (not self.uart_config(baudrate, hwfc=1)):
+                continue
+            start = time.time()
+            for address in range(0, read_len, chunk):
+                self.cmd_data.clear()
+                self.cmd_data.cmd = Command.COMMAND_EXT_MEM_READ
+                self.cmd_data.arg = [address, chunk]
+                msg_id = self.transport.write_cmd(self.cmd_data)
+                read_cmd = self.transport.read_response(msg_id=msg_id, timeout_s=5)
+                if (read_cmd is None or read_cmd.paylen != chunk):
+                    print("%d baud: read error at 0x%x" % (baudrate, address))
+                    break
+            stop = time.time()
+            print("%d baud: %d bytes in %.2f s, %.1f KB/s" % (baudrate, read_len, stop - start, read_len / 1024 / (stop - start)))
+        self.uart_config(COMSPEED, hwfc=0)
+
+    def uart_framing(self, framing, confirm_ms=1000):
+        """ Negotiate the framing, both sides fall back to DLE framing when the link test fails """
+        self.cmd_data.clear()
+        self.cmd_data.cmd = Command.CMD_UART_FRAMING
+        self.cmd_data.arg = [framing, confirm_ms]
+        msg_id = self.transport.write_cmd(self.cmd_data)
+        read_cmd = self.transport.read_response(msg_id=msg_id, timeout_s=2)
+        if (read_cmd is None or read_cmd.cmd != 0):
+            print("Framing %d not supported" % framing)
+            return False
+        # The device switches once its response is sent
+        time.sleep(0.05)
+        self.transport.set_framing(framing)
+        if (self.uart_link_test()):
+            return True
+        print("Link test failed with framing %d, back to DLE framing" % framing)
+        time.sleep(confirm_ms / 1000.0)
+        self.transport.set_framing(FRAMING_DLE)
+        self.transport.set_speed(COMSPEED, True)
+        return self.uart_link_test()
+
+    def framing_efficiency(self, file_len=4000):
+        """ Wire bytes per payload byte of the measurement file and of sensor samples, DLE and COBS framing """
+        payloads = {}
+        payloads["measurement file"] = bytes(self.meas_read_in_parts(file_len))
+        # 16 bit samples of a slowly changing signal around zero
+        samples = [int(300 * math.sin(i / 50.0)) for i in range(2000)]
+        payloads["int16 samples"] = struct.pack('<%dh' % len(samples), *samples)
+        payloads["ramp 0..255"] = bytes(i & 0xFF for i in range(4000))
+        for name, payload in payloads.items():
+            if (len(payload) == 0):
+                continue
+            dle_len = len(dle_escape(payload))
+            cobs_len = len(cobs_encode(payload))
+            print("%s: %d bytes, DLE %d (%.2f%%), COBS %d (%.2f%%)" %
+                  (name, len(payload), dle_len, 100.0 * (dle_len - len(payload)) / len(payload),
+                   cobs_len, 100.0 * (cobs_len - len(payload)) / len(payload)))
+        # Round trip of the negotiated framing
+        if (self.uart_framing(FRAMING_COBS)):
+            self.uart_framing(FRAMING_DLE)
+
+    def uart_window(self):
+        """ Number of requests and bytes the device accepts ahead of its responses """
+        self.cmd_data.clear()
+        self.cmd_data.cmd = Command.CMD_UART_WINDOW
+        msg_id = self.transport.write_cmd(self.cmd_data)
+        read_cmd = self.transport.read_response(msg_id=msg_id, timeout_s=2)
+        if (read_cmd is None or read_cmd.cmd != 0):
+            """ Older firmware, stop and wait """
+            return 1, 0
+        return read_cmd.arg[0], read_cmd.arg[1]
+
+    def pipeline(self, requests, credits=None, window_bytes=None):
+        """ Send the requests with up to 'credits' of them in flight, return the responses in order """
+        if (credits is None):
+            credits, window_bytes = self.uart_window()
+        pending = list(requests)
+        in_flight = []
+        responses = {}
+        while (pending or in_flight):
+            while (pending and len(in_flight) < credits):
+                # Worst case length of the escaped frame
+                frame_len = 2 * (8 + 4 * len(pending[0].arg) + len(pending[0].payload)) + 2
+                in_flight_bytes = sum(length for (__, __, length) in in_flight)
+                if (window_bytes and in_flight and (in_flight_bytes + frame_len) > window_bytes):
+                    break
+                request = pending.pop(0)
+                msg_id = self.transport.write_cmd(request)
+                in_flight.append((msg_id, request, frame_len))
+            # The device executes the requests in order
+            msg_id, request, frame_len = in_flight.pop(0)
+            read_cmd = self.transport.read_response(msg_id=msg_id, timeout_s=10)
+            if (read_cmd is not None and read_cmd.cmd == RESP_BUSY):
+                pending.insert(0, request)
+                continue
+            responses[id(request)] = read_cmd
+        return [responses[id(request)] for request in requests]
+
+    def window_benchmark(self, nbr_reads=200, read_len=16):
+        """ Small memory reads, stop and wait compared with the request window """
+        credits, window_bytes = self.uart_window()
+        for window in [1, credits]:
+            requests = []
+            for i in range(nbr_reads):
+                request = Cmd_Data()
+                request.clear()
+                request.cmd = Command.COMMAND_EXT_MEM_READ
+                request.arg = [i * read_len, read_len]
+                requests.append(request)
+            start = time.time()
+            responses = self.pipeline(requests, window, window_bytes)
+            stop = time.time()
+            errors = sum(1 for response in responses if (response is None or response.cmd != 0))
+            print("Window %d: %d reads of %d bytes in %.2f s, %.1f reads/s, %d errors" %
+                  (window, nbr_reads, read_len, stop - start, nbr_reads / (stop - start), errors))
+
+    def batch(self, items):
+        """ Execute (cmd, args, payload) items in as few frames as possible, return (status, args, payload) per item """
+        results = []
+        pending = list(items)
+        while (pending):
+            payload = bytearray()
+            for (cmd, args, data) in pending:
+                item = struct.pack('<HHH', cmd, len(args), len(data))
+                item += struct.pack('<%dI' % len(args), *args) + bytes(data)
+                if (payload and (len(payload) + len(item)) > MAX_PAYLOAD_LEN):
+                    break
+                payload += item
+            self.cmd_data.clear()
+            self.cmd_data.cmd = Command.COMMAND_BATCH
+            self.cmd_data.payload = payload
+            msg_id = self.transport.write_cmd(self.cmd_data)
+            read_cmd = self.transport.read_response(msg_id=msg_id, timeout_s=10)
+            if (read_cmd is None or read_cmd.cmd != 0 or read_cmd.arg[0] == 0):
+                print("Batch error %s" % (None if read_cmd is None else read_cmd.cmd))
+                return None
+            offset = 0
+            for __ in range(read_cmd.arg[0]):
+                cmd, status, nbr_arg, paylen = struct.unpack('<HHHH', read_cmd.payload[offset:offset + 8])
+                offset += 8
+                args = list(struct.unpack('<%dI' % nbr_arg, read_cmd.payload[offset:offset + 4 * nbr_arg]))
+                offset += 4 * nbr_arg
+                results.append((status, args, bytes(read_cmd.payload[offset:offset + paylen])))
+                offset += paylen
+            # The items that did not fit are sent in the next frame
+            pending = pending[read_cmd.arg[0]:]
+        return results
+
+    def batch_benchmark(self, nbr_files=50, file_len=64):
+        """ Read small files one per frame and in batches """
+        file_ids = [0x40000 + i for i in range(nbr_files)]
+        files = [bytes([(random.randint(65, 90)) for __ in range (file_len)]) for __ in file_ids]
+        results = self.batch([(Command.COMMAND_SFS_WRITE, [file_id], data) for (file_id, data) in zip(file_ids, files)])
+        if (results is None or any(status != 0 for (status, __, __) in results)):
+            print("Batch write failed")
+            return
+        start = time.time()
+        for file_id in file_ids:
+            self.cmd_data.clear()
+            self.cmd_data.cmd = Command.COMMAND_SFS_READ
+            self.cmd_data.arg = [file_id]
+            msg_id = self.transport.write_cmd(self.cmd_data)
+            self.transport.read_response(msg_id=msg_id, timeout_s=5)
+        stop = time.time()
+        print("One per frame: %d files in %.3f s" % (nbr_files, stop - start))
+        start = time.time()
+        results = self.batch([(Command.COMMAND_SFS_READ, [file_id], b'') for file_id in file_ids])
+        stop = time.time()
+        match = results is not None and [payload for (__, __, payload) in results] == files
+        print("Batch: %d files in %.3f s, match %d" % (nbr_files, stop - start, match))
+
     def test_ext_mem_driver(self):
         mem_address = 0x23000
         test_data_len = 50
@@ -133,6 +347,202 @@ class Simple_FS(object):
         self.transport.read_response(msg_id=msg_id)
         print("Memory chip erased")
 
+    def erase_plan(self):
+        """ Predict the erase of a measurement file allocation (72K) without erasing """
+        self.cmd_data.clear()
+        self.cmd_data.cmd = Command.COMMAND_EXT_MEM_ERASE_PLAN
+        address = 0x92000
+        size = 0x12000
+        self.cmd_data.arg = [address, size]
+        msg_id = self.transport.write_cmd(self.cmd_data)
+        read_cmd = self.transport.read_response(msg_id=msg_id)
+        if (read_cmd.cmd != 0):
+            print("Erase plan error " + str(read_cmd.cmd))
+            return
+        print("0x%x len 0x%x: 4K %d 32K %d 64K %d chip %d, %d ms" % (address, size, read_cmd.arg[2], read_cmd.arg[3],
+                                                                 read_cmd.arg[4], read_cmd.arg[5], read_cmd.arg[6]))
+
+    def erase_stats(self, clear=1):
+        """ Print the erases done and avoided since the last clear, and clear the counters """
+        self.cmd_data.clear()
+        self.cmd_data.cmd = Command.COMMAND_EXT_MEM_ERASE_STATS
+        self.cmd_data.arg = [clear]
+        msg_id = self.transport.write_cmd(self.cmd_data)
+        read_cmd = self.transport.read_response(msg_id=msg_id)
+        requested, erased, blank_checks, planned_ms, erase_ms = read_cmd.arg[1:6]
+        print("Erase pages requested %d erased %d avoided %d (blank checks %d), time %d ms of %d ms" %
+              (requested, erased, requested - erased, blank_checks, erase_ms, planned_ms))
+        if (len(read_cmd.arg) >= 8):
+            busy_ms, polls = read_cmd.arg[6:8]
+            print("Busy wait %d ms (CPU asleep), %d status reads" % (busy_ms, polls))
+
+    def blank_check_benchmark(self):
+        """ Compare the blank check with a read of the region checked byte by byte """
+        regions = [(0xF0000, 0x1000), (0xF0000, 0x10000), (0x0, 0x10000)]
+        methods = ["memory_is_blank", "memory_read + loop"]
+        for address, length in regions:
+            for method in range(len(methods)):
+                self.cmd_data.clear()
+                self.cmd_data.cmd = Command.COMMAND_EXT_MEM_BLANK_CHECK
+                self.cmd_data.arg = [address, length, method]
+                msg_id = self.transport.write_cmd(self.cmd_data)
+                read_cmd = self.transport.read_response(msg_id=msg_id)
+                print("0x%x len 0x%x %-18s blank %d %d ms" % (address, length, methods[method], read_cmd.arg[3], read_cmd.arg[4]))
+
+    def spi_frequency(self, cmd_mhz, data_mhz):
+        """ Set the SPI frequencies of the commands and of the data, 0 keeps the frequency """
+        self.cmd_data.clear()
+        self.cmd_data.cmd = Command.COMMAND_EXT_MEM_SPI_FREQUENCY
+        self.cmd_data.arg = [cmd_mhz, data_mhz]
+        msg_id = self.transport.write_cmd(self.cmd_data)
+        read_cmd = self.transport.read_response(msg_id=msg_id)
+        return read_cmd.cmd, read_cmd.arg[2], read_cmd.arg[3]
+
+    def spi_frequency_benchmark(self):
+        """ Write and read a file at each SPI frequency setting, timed by the SFS commands """
+        settings = [(8, 8), (8, 16), (8, 32), (16, 16), (32, 32)]
+        file_id = 0x30001
+        file_len = 4000
+        for cmd_mhz, data_mhz in settings:
+            status, cmd_mhz, data_mhz = self.spi_frequency(cmd_mhz, data_mhz)
+            if (status != 0):
+                print("Frequency %d/%d MHz not supported" % (cmd_mhz, data_mhz))
+                continue
+            self.cmd_data.clear()
+            self.cmd_data.cmd = Command.COMMAND_SFS_WRITE
+            self.cmd_data.payload = [(random.randint(65, 90)) for __ in range (file_len)]
+            self.cmd_data.arg = [file_id]
+            msg_id = self.transport.write_cmd(self.cmd_data)
+            write_cmd = self.transport.read_response(msg_id=msg_id)
+            self.cmd_data.clear()
+            self.cmd_data.cmd = Command.COMMAND_SFS_READ
+            self.cmd_data.arg = [file_id]
+            msg_id = self.transport.write_cmd(self.cmd_data)
+            read_cmd = self.transport.read_response(msg_id=msg_id)
+            if (write_cmd.cmd != 0 or read_cmd.cmd != 0 or len(write_cmd.arg) < 7 or len(read_cmd.arg) < 7):
+                print("Command %d MHz data %d MHz: error %d %d" % (cmd_mhz, data_mhz, write_cmd.cmd, read_cmd.cmd))
+                continue
+            write_ms = write_cmd.arg[6]
+            read_ms = read_cmd.arg[6]
+            print("Command %2d MHz data %2d MHz: write %d ms (%d kB/s) read %d ms (%d kB/s)" %
+                  (cmd_mhz, data_mhz, write_ms, file_len // max(write_ms, 1), read_ms, file_len // max(read_ms, 1)))
+        self.spi_frequency(8, 32)
+
+    def driver_stats(self, clear=1):
+        """ Print the SPI counters and the program and erase latencies, and clear them """
+        pages = []
+        for page in range(3):
+            self.cmd_data.clear()
+            self.cmd_data.cmd = Command.COMMAND_EXT_MEM_STATS
+            # Clear with the last page only, all pages come from the same workload
+            self.cmd_data.arg = [clear if page == 2 else 0, page]
+            msg_id = self.transport.write_cmd(self.cmd_data)
+            pages.append(self.transport.read_response(msg_id=msg_id))
+        transfers, nbr_bytes, timeouts, polls, busy_us = pages[0].arg[2:7]
+        print("SPI transfers %d, %d bytes, %d timeouts, %d status polls, busy wait %d us" %
+              (transfers, nbr_bytes, timeouts, polls, busy_us))
+        prog_count, prog_mean, prog_max, erase_count, erase_mean, erase_max = pages[1].arg[2:8]
+        print("Program %d, mean %d us, max %d us" % (prog_count, prog_mean, prog_max))
+        print("Erase %d, mean %d us, max %d us" % (erase_count, erase_mean, erase_max))
+        requested, programmed, skipped, failures = pages[2].arg[2:6]
+        print("Write %d bytes, %d bytes programmed, %d programs skipped, %d verify failures" %
+              (requested, programmed, skipped, failures))
+
+    def write_verify(self, enable):
+        """ Enable or disable the read back of the programmed data """
+        self.cmd_data.clear()
+        self.cmd_data.cmd = Command.COMMAND_EXT_MEM_WRITE_VERIFY
+        self.cmd_data.arg = [enable]
+        msg_id = self.transport.write_cmd(self.cmd_data)
+        return self.transport.read_response(msg_id=msg_id).arg[1]
+
+    def write_verify_benchmark(self):
+        """ Write a file with mostly 0xFF data with and without the write verify """
+        file_id = 0x30003
+        payload = [0xFF] * 3000 + [(random.randint(65, 90)) for __ in range (1000)]
+        for enable in [0, 1]:
+            self.write_verify(enable)
+            self.driver_stats(clear=1)
+            self.cmd_data.clear()
+            self.cmd_data.cmd = Command.COMMAND_SFS_WRITE
+            self.cmd_data.payload = payload
+            self.cmd_data.arg = [file_id]
+            msg_id = self.transport.write_cmd(self.cmd_data)
+            read_cmd = self.transport.read_response(msg_id=msg_id)
+            print("Write verify %d: status %d, %d ms" % (enable, read_cmd.cmd, read_cmd.arg[6] if len(read_cmd.arg) > 6 else 0))
+            self.driver_stats(clear=1)
+        self.write_verify(0)
+
+    def wake_benchmark(self, cycles=20):
+        """ Print the boot time and the deep power down wake to first read time of each wake mode """
+        for fast, name in [(0, "full (reset)"), (1, "fast")]:
+            self.cmd_data.clear()
+            self.cmd_data.cmd = Command.COMMAND_EXT_MEM_WAKE_BENCHMARK
+            self.cmd_data.arg = [fast, cycles]
+            msg_id = self.transport.write_cmd(self.cmd_data)
+            read_cmd = self.transport.read_response(msg_id=msg_id)
+            if (read_cmd.cmd != 0):
+                print("Wake %s: error %d" % (name, read_cmd.cmd))
+                continue
+            print("Wake %-12s to first read: mean %d us, max %d us" % (name, read_cmd.arg[2], read_cmd.arg[3]))
+        wake_us, detect_us, first_read_us = read_cmd.arg[4:7]
+        print("Boot: wake %d us, detection %d us, first read %d us" % (wake_us, detect_us, first_read_us))
+
+    def power_stats(self, clear=0, timeout_ms=None):
+        """ Read the deep power down counters, set the idle timeout when given """
+        self.cmd_data.clear()
+        self.cmd_data.cmd = Command.COMMAND_EXT_MEM_POWER
+        self.cmd_data.arg = [clear, 0 if timeout_ms is None else 1, 0 if timeout_ms is None else timeout_ms]
+        msg_id = self.transport.write_cmd(self.cmd_data)
+        return self.transport.read_response(msg_id=msg_id).arg[3:10]
+
+    def idle_timeout_benchmark(self, reads=20):
+        """ Read a file with pauses at each idle timeout, print the read time and the time asleep """
+        file_id = 0x30002
+        pauses = [0.01, 0.05, 0.2]
+        self.cmd_data.clear()
+        self.cmd_data.cmd = Command.COMMAND_SFS_WRITE
+        self.cmd_data.payload = [(random.randint(65, 90)) for __ in range (1000)]
+        self.cmd_data.arg = [file_id]
+        msg_id = self.transport.write_cmd(self.cmd_data)
+        self.transport.read_response(msg_id=msg_id)
+        for timeout_ms in [0, 20, 100, 500]:
+            self.power_stats(clear=1, timeout_ms=timeout_ms)
+            read_ms = 0
+            for i in range(reads):
+                time.sleep(pauses[i % len(pauses)])
+                self.cmd_data.clear()
+                self.cmd_data.cmd = Command.COMMAND_SFS_READ
+                self.cmd_data.arg = [file_id]
+                msg_id = self.transport.write_cmd(self.cmd_data)
+                read_ms += self.transport.read_response(msg_id=msg_id).arg[6]
+            __, sleeps, wakes, wake_mean, wake_max, sleep_ms, awake_ms = self.power_stats()
+            print("Idle %3d ms: read %d ms total, %d sleeps, wake mean %d us max %d us, asleep %d%% of %d ms" %
+                  (timeout_ms, read_ms, sleeps, wake_mean, wake_max, (100 * sleep_ms) // max(sleep_ms + awake_ms, 1),
+                   sleep_ms + awake_ms))
+        self.power_stats(clear=1, timeout_ms=100)
+
+    def read_latency(self):
+        """ Compare the read latency of a CONFIG and a LOG file, copied and memory mapped """
+        nbr_reads = 100
+        file_len = 200
+        for file_id in [0x10001, 0x20001]:
+            self.file_write(file_id, file_len)
+            self.cmd_data.clear()
+            self.cmd_data.cmd = Command.COMMAND_SFS_READ_LATENCY
+            self.cmd_data.arg = [file_id, nbr_reads]
+            msg_id = self.transport.write_cmd(self.cmd_data)
+            read_cmd = self.transport.read_response(msg_id=msg_id)
+            if (read_cmd.cmd != 0):
+                print("File %x read error %d" % (file_id, read_cmd.cmd))
+                continue
+            copy_ms, map_ms, map_status = read_cmd.arg[2:5]
+            print("File %x copy %d us per read" % (file_id, copy_ms * 1000 // nbr_reads))
+            if (map_status == 0):
+                print("File %x sfs_map_file %d us per read" % (file_id, map_ms * 1000 // nbr_reads))
+            else:
+                print("File %x sfs_map_file error %d" % (file_id, map_status))
+
     def address_check(self):
         self.cmd_data.clear()
         self.cmd_data.cmd = Command.COMMAND_EXT_MEM_READ
@@ -146,9 +556,11 @@ class Simple_FS(object):
         print(read_cmd.payload)
 
     def test_file_system(self):
+        self.erase_stats()
         #self.file_test()
         #self.file_test_in_parts()
         self.test_long_folder()
+        self.erase_stats()
 
     def file_test(self):
         for i in range (300):
@@ -261,6 +673,129 @@ class Simple_FS(object):
         resp = self.transport.read_response(msg_id=msg_id)
         return file, resp.arg[1], resp.arg[5]
 
+    def file_stream(self, file_id, offset=0, length=0, chunk_len=0, retries=5):
+        """ Download a file range pushed by the device, the lost frames are requested again """
+        self.cmd_data.clear()
+        self.cmd_data.cmd = Command.COMMAND_SFS_STREAM
+        self.cmd_data.arg = [file_id, offset, length, chunk_len]
+        msg_id = self.transport.write_cmd(self.cmd_data)
+        read_cmd = self.transport.read_response(msg_id=msg_id, timeout_s=5)
+        if (read_cmd is None or read_cmd.cmd != 0):
+            print("Stream error " + str(None if read_cmd is None else read_cmd.cmd))
+            return None
+        length, nbr_frames = read_cmd.arg[4:6]
+
+        chunks = {}
+        end = None
+        while (end is None or len(chunks) < nbr_frames):
+            frame = self.transport.read_response(msg_id=msg_id, timeout_s=1)
+            if (frame is None):
+                missing = [seq for seq in range(nbr_frames) if seq not in chunks]
+                if (end is None):
+                    missing.append(nbr_frames)
+                if (retries == 0):
+                    print("Stream: %d frames lost" % len(missing))
+                    return None
+                retries -= 1
+                # One argument of the resend request is used by its response
+                self.cmd_data.clear()
+                self.cmd_data.cmd = Command.COMMAND_SFS_STREAM_RESEND
+                self.cmd_data.arg = missing[:9]
+                resend_id = self.transport.write_cmd(self.cmd_data)
+                self.transport.read_response(msg_id=resend_id, timeout_s=5)
+                continue
+            if (not frame.crc_ok):
+                continue
+            if (frame.cmd == RESP_STREAM_DATA):
+                chunks[frame.arg[0]] = bytes(frame.payload[:frame.paylen])
+            elif (frame.cmd == RESP_STREAM_END):
+                end = frame
+            else:
+                print("Stream read error %d at frame %d" % (frame.cmd, frame.arg[0]))
+                return None
+
+        data = b''.join(chunks[seq] for seq in range(nbr_frames))
+        if (len(data) != length or self.transport.crc16(data) != end.arg[2]):
+            print("Stream CRC mismatch")
+            return None
+        return data
+
+    def stream_benchmark(self):
+        """ Download a file in parts and as a stream """
+        file_id = 0x30004
+        file_len = 4000
+        payload, __, __ = self.file_write(file_id, file_len)
+        start = time.time()
+        data, __, __ = self.file_read_in_parts(file_id, file_len)
+        stop = time.time()
+        print("Read in parts: %d bytes in %.3f s, match %d" % (len(data), stop - start, data == payload))
+        start = time.time()
+        data = self.file_stream(file_id)
+        stop = time.time()
+        print("Stream: %d bytes in %.3f s, match %d" % (len(data) if data else 0, stop - start, data is not None and list(data) == payload))
+
+    def file_upload(self, file_id, data, retries=5):
+        """ Upload a file with several data frames in flight, go back to the acknowledged offset on a loss """
+        self.cmd_data.clear()
+        self.cmd_data.cmd = Command.COMMAND_SFS_UPLOAD
+        self.cmd_data.arg = [file_id, len(data)]
+        msg_id = self.transport.write_cmd(self.cmd_data)
+        read_cmd = self.transport.read_response(msg_id=msg_id, timeout_s=5)
+        if (read_cmd is None or read_cmd.cmd != 0):
+            print("Upload error " + str(None if read_cmd is None else read_cmd.cmd))
+            return False
+        credits, window_bytes, max_len = read_cmd.arg[2:5]
+        # Two frames fit in the receive buffers while the device programs
+        chunk_len = min(max_len, max(256, (window_bytes // 2 - 16) // 2))
+
+        acked = 0
+        next_offset = 0
+        in_flight = {}
+        while (acked < len(data)):
+            while (next_offset < len(data) and len(in_flight) < credits):
+                request = Cmd_Data()
+                request.clear()
+                request.cmd = Command.COMMAND_SFS_UPLOAD_DATA
+                request.arg = [next_offset]
+                request.payload = list(data[next_offset:next_offset + chunk_len])
+                in_flight[self.transport.write_cmd(request)] = next_offset + len(request.payload)
+                next_offset += len(request.payload)
+
+            response = self.transport.read_any_response(list(in_flight.keys()), timeout_s=2)
+            if (response is not None and response.crc_ok and response.cmd not in [0, RESP_BUSY]):
+                print("Upload write error %d" % response.cmd)
+                return False
+            if (response is None or not response.crc_ok or response.cmd == RESP_BUSY or response.arg[1] < in_flight[response.msg_id]):
+                # A frame was lost, send again from the acknowledged offset
+                if (retries == 0):
+                    print("Upload failed at %d" % acked)
+                    return False
+                retries -= 1
+                if (response is not None and response.crc_ok and response.cmd == 0):
+                    acked = max(acked, response.arg[1])
+                next_offset = acked
+                in_flight = {}
+                continue
+            acked = max(acked, response.arg[1])
+            in_flight = {msg_id: end for (msg_id, end) in in_flight.items() if end > acked}
+        return True
+
+    def upload_benchmark(self):
+        """ Write a file in parts (stop and wait) and as an upload """
+        file_id = 0x30005
+        file_len = 32000
+        start = time.time()
+        self.file_write_in_parts(file_id, file_len)
+        stop = time.time()
+        print("Write in parts: %d bytes in %.2f s, %.1f KB/s" % (file_len, stop - start, file_len / 1024 / (stop - start)))
+        data = bytes([(random.randint(65, 90)) for __ in range (file_len)])
+        start = time.time()
+        done = self.file_upload(file_id, data)
+        stop = time.time()
+        print("Upload: %d bytes in %.2f s, %.1f KB/s" % (file_len, stop - start, file_len / 1024 / (stop - start)))
+        read = self.file_stream(file_id) if done else None
+        print("Upload read back match %d" % (read == data))
+
     def file_write_in_parts(self, file_id, file_len):
 
         file = [(random.randint(65, 90)) for __ in range (file_len)]
@@ -384,6 +919,7 @@ class Simple_FS(object):
 
         nbr_write_files = 20
         nbr_read_files = 6
+        self.erase_stats()
         for _ in range (nbr_write_files):
             w_file = self.meas_write_in_parts(file_len)
             write_buffer.append(w_file)
@@ -396,6 +932,7 @@ class Simple_FS(object):
                 print("Match")
             else:
                 print("Mismatch")
+        self.erase_stats()
 
     def GUI_app(self):
         window = Tk()
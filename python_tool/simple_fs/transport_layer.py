@@ -12,21 +12,36 @@ DEBUG = 1
 """ None: for infinite wait """
 TIMEOUT = None
 
-""" Do not change the comport speed (115200) """
+""" Comport speed at start up, a higher one is negotiated with CMD_UART_CONFIG """
 COMSPEED = 115200
 
 """ Wait time between responses in seconds """
-TIME_BTN_RESP = 0.25
+TIME_BTN_RESP = 0.01
 
 STX = 0x2
 ETX = 0x3
 DLE = 0x4
 
+""" Framing of the packets, negotiated with CMD_UART_FRAMING """
+FRAMING_DLE = 0
+FRAMING_COBS = 1
+COBS_DELIMITER = 0x0
+COBS_BLOCK_LEN = 254
+
 "Concat value of STX and ETX according to little endian"
 STX_ETX = 0x0302
 
 MESSAGE_ID = 0
 
+""" Response of a request sent beyond the window credits, it is sent again """
+RESP_BUSY = 8
+""" Data and end frames pushed by a stream """
+RESP_STREAM_DATA = 9
+RESP_STREAM_END = 10
+
+""" Largest payload of a frame (MAX_PAYLOAD_LEN of the device) """
+MAX_PAYLOAD_LEN = 4096
+
 MESSAGE_MASK = 0xFFFF
 
 MEAS_FLAG_LEN = 4
@@ -44,6 +59,7 @@ class Cmd_Data:
     arg: list = []
     paylen: int = 0
     payload: list = []
+    crc_ok: bool = True
     
     def clear(self):
         self.crc = 0
@@ -53,16 +69,68 @@ class Cmd_Data:
         self.arg = []
         self.paylen = 0
         self.payload = []
+        self.crc_ok = True
 
 
 def tohex(val, nbits):
     return ((val + (1 << nbits)) % (1 << nbits))
 
 
+def dle_escape(data):
+    """ STX, data with STX, ETX and DLE escaped by DLE, ETX """
+    msg = bytearray([STX])
+    for i in data:
+        if ((i == STX) or (i == ETX) or (i == DLE)):
+            msg.append(DLE)
+            msg.append(tohex(~i, 8))
+        else:
+            msg.append(i)
+    msg.append(ETX)
+    return msg
+
+
+def cobs_encode(data):
+    """ COBS blocks of up to 254 bytes found with bytes.find, followed by the delimiter """
+    data = bytes(data)
+    msg = bytearray()
+    start = 0
+    while (1):
+        end = min(start + COBS_BLOCK_LEN, len(data))
+        zero = data.find(COBS_DELIMITER, start, end)
+        if (zero >= 0):
+            end = zero
+        msg.append(end - start + 1)
+        msg += data[start:end]
+        if (zero >= 0):
+            start = zero + 1
+        elif ((end - start) == COBS_BLOCK_LEN):
+            # A full block is not followed by a zero, the frame may go on
+            start = end
+        else:
+            break
+    msg.append(COBS_DELIMITER)
+    return msg
+
+
+def cobs_decode(msg):
+    """ Decode a COBS frame without its delimiter, None when it is corrupted """
+    data = bytearray()
+    index = 0
+    while (index < len(msg)):
+        code = msg[index]
+        if (code == COBS_DELIMITER or (index + code) > len(msg)):
+            return None
+        data += msg[index + 1:index + code]
+        index += code
+        if (code != COBS_BLOCK_LEN + 1 and index < len(msg)):
+            data.append(0)
+    return data
+
+
 def data_reader(transport):
+    """ The serial read blocks until the next packet """
     while (1):
         transport.read_response_data()
-        time.sleep(0.1)
 
 
 class Transport(object):
@@ -76,6 +144,8 @@ class Transport(object):
         '''
         self.ack_list = []
         self.resp_list = []
+        self.last_frame_len = 0
+        self.framing = FRAMING_DLE
         self.logger = logger
         self.serial = None
         self.port = port
@@ -105,6 +175,15 @@ class Transport(object):
         except:
             None
 
+    def set_speed(self, baudrate, rtscts):
+        """ Switch the open port to another baud rate and flow control """
+        self.serial.baudrate = baudrate
+        self.serial.rtscts = rtscts
+
+    def set_framing(self, framing):
+        """ Switch the framing of both directions """
+        self.framing = framing
+
     def get_port(self):
         return self.port
 
@@ -143,6 +222,15 @@ class Transport(object):
 
         return crc
 
+    def read_cobs_frame(self):
+        """ Read up to the delimiter and decode in bulk, None for a corrupted frame """
+        try:
+            msg = self.serial.read_until(bytes([COBS_DELIMITER]))
+        except:
+            "Close application and RX thread """
+            exit()
+        return cobs_decode(msg[:-1])
+
     def read_response_data(self):
 
         cmd_data = Cmd_Data()
@@ -150,8 +238,15 @@ class Transport(object):
         data = bytes()
         
         negate_byte = 0
-        
-        while(1):
+
+        if (self.framing == FRAMING_COBS):
+            data = self.read_cobs_frame()
+            if (data is None):
+                print("COBS error in received packet")
+                self.logger.info("COBS error in received packet")
+                return
+
+        while(self.framing == FRAMING_DLE):
             try:
                 temp = self.serial.read(1)
                 temp_b = bytes(temp)[0]
@@ -184,6 +279,7 @@ class Transport(object):
             computed_crc = self.crc16(data[offset:])
             
             if (computed_crc != cmd_data.crc):
+                cmd_data.crc_ok = False
                 print("CRC MISMATCH in received packet")
                 self.logger.info("CRC MISMATCH in received packet")
 
@@ -225,7 +321,7 @@ class Transport(object):
                     cmd_data = response
                     self.resp_list.remove(response)
                     return cmd_data
-                elif (response.cmd == cmd_id):
+                elif (msg_id == 0 and response.cmd == cmd_id):
                     cmd_data = response
                     self.resp_list.remove(response)
                     return cmd_data
@@ -235,6 +331,21 @@ class Transport(object):
             if ((timeout_s != 0) and ((time.time() - start_time) > timeout_s)) :
                 return None
 
+    def read_any_response(self, msg_ids, timeout_s=0):
+        """ First response to one of the messages, None on timeout """
+        start_time = time.time()
+
+        while (1):
+            for response in self.resp_list:
+                if (response.msg_id in msg_ids):
+                    self.resp_list.remove(response)
+                    return response
+
+            time.sleep(TIME_BTN_RESP)
+
+            if ((timeout_s != 0) and ((time.time() - start_time) > timeout_s)) :
+                return None
+
     def write_cmd(self, cmd):
 
         global MESSAGE_ID
@@ -263,23 +374,12 @@ class Transport(object):
         if (DEBUG == 1):
             self.display_cmd(cmd, "TX")
 
-        msg = struct.pack('<B', STX)
-        self.serial.write(msg)
-
-        for i in data:
-
-            if ((i == STX) or (i == ETX) or (i == DLE)):
-                msg = struct.pack('<B', DLE)
-                self.serial.write(msg)
-                temp = ~i
-                temp = tohex(temp, 8)
-                msg = struct.pack('<B', temp)
-                self.serial.write(msg)
-            else:
-                msg = struct.pack('<B', i)
-                self.serial.write(msg)
-
-        msg = struct.pack('<B', ETX)
+        if (self.framing == FRAMING_COBS):
+            msg = cobs_encode(data)
+        else:
+            msg = dle_escape(data)
+        """ One write per frame, the frames of a window follow each other """
         self.serial.write(msg)
+        self.last_frame_len = len(msg)
 
         return MESSAGE_ID
@@ -30,6 +30,20 @@ def main():
         'c': ['test_file_system', "Test file system"],
         'd': ['test_meas_file', "Test measurement file system"],
         'e': ['address_check', "address_check"],
+        'f': ['erase_plan', "Erase plan (dry run)"],
+        'g': ['blank_check_benchmark', "Blank check benchmark"],
+        'h': ['read_latency', "File read latency (copied and mapped)"],
+        'i': ['spi_frequency_benchmark', "SPI frequency benchmark"],
+        'j': ['driver_stats', "Driver statistics"],
+        'k': ['wake_benchmark', "Memory wake and boot time"],
+        'l': ['idle_timeout_benchmark', "Deep power down idle timeout benchmark"],
+        'm': ['write_verify_benchmark', "Write verify and 0xFF trimming benchmark"],
+        'n': ['uart_speed_benchmark', "UART baud rate negotiation and read throughput"],
+        'o': ['window_benchmark', "Request window benchmark (small reads)"],
+        'p': ['stream_benchmark', "File download in parts and as a stream"],
+        'q': ['upload_benchmark', "File upload in parts and with cumulative acknowledges"],
+        'r': ['framing_efficiency', "DLE and COBS framing wire efficiency"],
+        's': ['batch_benchmark', "Small file reads one per frame and in batches"],
         '1': ['exit', "Exit"]
     }
 
@@ -3,7 +3,14 @@ C_SRC := \
     $(APP_DIR)/src/main.c \
     $(APP_DIR)/src/spi.c \
     $(APP_DIR)/src/ext_mem_driver.c \
+    $(APP_DIR)/src/sfdp.c \
+    $(APP_DIR)/src/mem_array.c \
+    $(APP_DIR)/src/flash_backend_nor.c \
+    $(APP_DIR)/src/flash_backend_nvmc.c \
+    $(APP_DIR)/src/flash_backend_qspi.c \
     $(APP_DIR)/src/uart_command.c \
+    $(APP_DIR)/src/uart_dma.c \
+    $(APP_DIR)/src/uart_frame.c \
     $(APP_DIR)/src/led.c \
     $(APP_DIR)/src/storage_mngr.c \
     $(APP_DIR)/src/simple_fs.c \
@@ -49,9 +56,9 @@ C_SRC += \
     $(SDK_DIR)/drivers/src/nrfx_uart.c \
     $(SDK_DIR)/drivers/src/nrfx_uarte.c \
     $(SDK_DIR)/drivers/src/nrfx_clock.c \
-    $(SDK_DIR)/uart/app_uart_fifo.c \
+    $(SDK_DIR)/drivers/src/nrfx_nvmc.c \
+    $(SDK_DIR)/drivers/src/nrfx_qspi.c \
     $(SDK_DIR)/crc16/crc16.c \
-    $(SDK_DIR)/fifo/app_fifo.c \
     $(SDK_DIR)/bsp/bsp.c \
     $(SDK_DIR)/segger_rtt/SEGGER_RTT.c \
     $(SDK_DIR)/segger_rtt/SEGGER_RTT_Syscalls_GCC.c \
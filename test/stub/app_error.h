@@ -0,0 +1,11 @@
+#ifndef HOST_APP_ERROR_H
+#define HOST_APP_ERROR_H
+
+#include <assert.h>
+
+#include "sdk_errors.h"
+
+#define APP_ERROR_CHECK(err_code)       assert((err_code) == NRF_SUCCESS)
+#define APP_ERROR_CHECK_BOOL(boolean)   assert(boolean)
+
+#endif // HOST_APP_ERROR_H
@@ -0,0 +1,6 @@
+#ifndef HOST_APP_TIMER_H
+#define HOST_APP_TIMER_H
+
+/** Host build: included by the storage sources, nothing of it is used */
+
+#endif // HOST_APP_TIMER_H
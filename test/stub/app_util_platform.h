@@ -0,0 +1,9 @@
+#ifndef HOST_APP_UTIL_PLATFORM_H
+#define HOST_APP_UTIL_PLATFORM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define STATIC_ASSERT(expr)     _Static_assert(expr, #expr)
+
+#endif // HOST_APP_UTIL_PLATFORM_H
@@ -0,0 +1,6 @@
+#ifndef HOST_BOARDS_H
+#define HOST_BOARDS_H
+
+/** Host build: included by the storage sources, nothing of it is used */
+
+#endif // HOST_BOARDS_H
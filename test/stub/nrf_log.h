@@ -0,0 +1,14 @@
+#ifndef HOST_NRF_LOG_H
+#define HOST_NRF_LOG_H
+
+#include <stdio.h>
+
+/** Host build: the errors and warnings are printed, the info is dropped */
+#define NRF_LOG_ERROR(...)      do { printf(__VA_ARGS__); printf("\n"); } while (0)
+#define NRF_LOG_WARNING(...)    do { printf(__VA_ARGS__); printf("\n"); } while (0)
+#define NRF_LOG_INFO(...)       do { } while (0)
+#define NRF_LOG_DEBUG(...)      do { } while (0)
+#define NRF_LOG_FLUSH()         do { } while (0)
+#define NRF_LOG_PROCESS()       false
+
+#endif // HOST_NRF_LOG_H
@@ -0,0 +1,6 @@
+#ifndef HOST_NRF_LOG_CTRL_H
+#define HOST_NRF_LOG_CTRL_H
+
+/** Host build: included by the storage sources, nothing of it is used */
+
+#endif // HOST_NRF_LOG_CTRL_H
@@ -0,0 +1,14 @@
+#ifndef HOST_SDK_COMMON_H
+#define HOST_SDK_COMMON_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "sdk_config.h"
+#include "sdk_errors.h"
+
+#define NRF_MODULE_ENABLED(module) \
+    ((defined(module ## _ENABLED) && (module ## _ENABLED)) ? 1 : 0)
+
+#endif // HOST_SDK_COMMON_H
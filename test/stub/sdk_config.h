@@ -0,0 +1,8 @@
+#ifndef HOST_SDK_CONFIG_H
+#define HOST_SDK_CONFIG_H
+
+/** Host build: the modules use their default configuration */
+
+#define CRC16_ENABLED 1
+
+#endif // HOST_SDK_CONFIG_H
@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "sfdp.h"
+
+/** Host test of the SFDP parser on the SFDP space of three Winbond memories */
+
+#define CHECK(cond)                                                         \
+    do                                                                      \
+    {                                                                       \
+        if (!(cond))                                                        \
+        {                                                                   \
+            printf("%s:%d: %s: %s failed\n", __FILE__, __LINE__, m_name, #cond); \
+            m_nbr_failures++;                                               \
+        }                                                                   \
+    } while (0)
+
+typedef struct
+{
+    const char *name;
+    const uint8_t *dump;
+    uint32_t len;
+    sfdp_info_t info;
+} sfdp_test_t;
+
+/** W25Q80DV, 1 Mbyte: JESD216 without the DWORDs 10 to 16 */
+static const uint8_t m_w25q80dv[] = {
+    0x53, 0x46, 0x44, 0x50, 0x00, 0x01, 0x00, 0xFF, 0x00, 0x00, 0x01, 0x09, 0x80, 0x00, 0x00, 0xFF,
+    [0x80] =
+    0xE5, 0x20, 0xF1, 0xFF, 0xFF, 0xFF, 0x7F, 0x00, 0x44, 0xEB, 0x08, 0x6B, 0x08, 0x3B, 0x42, 0xBB,
+    0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0xFF, 0xFF, 0x21, 0xEB, 0x0C, 0x20, 0x0F, 0x52,
+    0x10, 0xD8, 0x00, 0xFF
+};
+
+/** W25Q128JV, 16 Mbyte: 3 byte address, JESD216B with 16 DWORDs */
+static const uint8_t m_w25q128jv[] = {
+    0x53, 0x46, 0x44, 0x50, 0x05, 0x01, 0x00, 0xFF, 0x00, 0x05, 0x01, 0x10, 0x80, 0x00, 0x00, 0xFF,
+    [0x80] =
+    0xE5, 0x20, 0xF9, 0xFF, 0xFF, 0xFF, 0xFF, 0x07, 0x44, 0xEB, 0x08, 0x6B, 0x08, 0x3B, 0x42, 0xBB,
+    0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0xFF, 0xFF, 0x40, 0xEB, 0x0C, 0x20, 0x0F, 0x52,
+    0x10, 0xD8, 0x00, 0x00, 0x36, 0x02, 0xA6, 0x00, 0x82, 0xEA, 0x14, 0xC9, 0xE9, 0x63, 0x76, 0x33,
+    0x7A, 0x75, 0x7A, 0x75, 0xF7, 0xA2, 0xD5, 0x5C, 0x19, 0xF7, 0x4D, 0xFF, 0xE9, 0x30, 0xF8, 0x80
+};
+
+/** W25Q256JV, 32 Mbyte: 3 or 4 byte address, 4 byte address instruction table */
+static const uint8_t m_w25q256jv[] = {
+    0x53, 0x46, 0x44, 0x50, 0x06, 0x01, 0x01, 0xFF, 0x00, 0x06, 0x01, 0x10, 0x80, 0x00, 0x00, 0xFF,
+    0x84, 0x00, 0x01, 0x02, 0xD0, 0x00, 0x00, 0xFF,
+    [0x80] =
+    0xE5, 0x20, 0xFB, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x44, 0xEB, 0x08, 0x6B, 0x08, 0x3B, 0x42, 0xBB,
+    0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0xFF, 0xFF, 0x40, 0xEB, 0x0C, 0x20, 0x0F, 0x52,
+    0x10, 0xD8, 0x00, 0x00, 0x36, 0x02, 0xA6, 0x00, 0x82, 0xEA, 0x14, 0xE2, 0xE9, 0x63, 0x76, 0x33,
+    0x7A, 0x75, 0x7A, 0x75, 0xF7, 0xA2, 0xD5, 0x5C, 0x19, 0xF7, 0x4D, 0xFF, 0xE9, 0x70, 0xF9, 0xA5,
+    [0xD0] =
+    0xFF, 0x0A, 0x00, 0x00, 0x21, 0xFF, 0xDC, 0xFF
+};
+
+#define SFDP_FAST_READ_ALL  (SFDP_FAST_READ_112 | SFDP_FAST_READ_122 | SFDP_FAST_READ_114 | SFDP_FAST_READ_144)
+
+static const sfdp_test_t m_tests[] = {
+    {
+        .name = "W25Q80DV",
+        .dump = m_w25q80dv,
+        .len = sizeof(m_w25q80dv),
+        .info = {
+            .major_rev = 1,
+            .minor_rev = 0,
+            .density = 0x100000,
+            .page_size = 256,
+            .address_mode = SFDP_ADDRESS_3_BYTE,
+            .fast_read_modes = SFDP_FAST_READ_ALL,
+            .erase_type = {
+                { .size = 0x1000, .opcode = 0x20 },
+                { .size = 0x8000, .opcode = 0x52 },
+                { .size = 0x10000, .opcode = 0xD8 },
+            },
+        },
+    },
+    {
+        .name = "W25Q128JV",
+        .dump = m_w25q128jv,
+        .len = sizeof(m_w25q128jv),
+        .info = {
+            .major_rev = 1,
+            .minor_rev = 5,
+            .density = 0x1000000,
+            .page_size = 256,
+            .address_mode = SFDP_ADDRESS_3_BYTE,
+            .fast_read_modes = SFDP_FAST_READ_ALL,
+            .erase_type = {
+                { .size = 0x1000, .opcode = 0x20, .typ_time_ms = 64 },
+                { .size = 0x8000, .opcode = 0x52, .typ_time_ms = 128 },
+                { .size = 0x10000, .opcode = 0xD8, .typ_time_ms = 160 },
+            },
+            .page_program_typ_us = 704,
+            .chip_erase_typ_ms = 40000,
+        },
+    },
+    {
+        .name = "W25Q256JV",
+        .dump = m_w25q256jv,
+        .len = sizeof(m_w25q256jv),
+        .info = {
+            .major_rev = 1,
+            .minor_rev = 6,
+            .density = 0x2000000,
+            .page_size = 256,
+            .address_mode = SFDP_ADDRESS_3_OR_4_BYTE,
+            .fast_read_modes = SFDP_FAST_READ_ALL,
+            .erase_type = {
+                { .size = 0x1000, .opcode = 0x20, .opcode_4b = 0x21, .typ_time_ms = 64 },
+                { .size = 0x8000, .opcode = 0x52, .typ_time_ms = 128 },
+                { .size = 0x10000, .opcode = 0xD8, .opcode_4b = 0xDC, .typ_time_ms = 160 },
+            },
+            .page_program_typ_us = 704,
+            .chip_erase_typ_ms = 192000,
+            .enter_4b_methods = SFDP_ENTER_4B_B7,
+            .read_4b = true,
+            .program_4b = true,
+        },
+    },
+};
+
+static const char *m_name;
+static const sfdp_test_t *m_test;
+static uint32_t m_nbr_failures;
+
+/** Read of the SFDP space of the memory under test, the space after the dump is erased */
+static uint32_t dump_read(uint32_t address, uint8_t *data, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++)
+    {
+        data[i] = ((address + i) < m_test->len) ? m_test->dump[address + i] : 0xFF;
+    }
+    return 0;
+}
+
+static void check_info(const sfdp_info_t *expected, const sfdp_info_t *info)
+{
+    CHECK(info->major_rev == expected->major_rev);
+    CHECK(info->minor_rev == expected->minor_rev);
+    CHECK(info->density == expected->density);
+    CHECK(info->page_size == expected->page_size);
+    CHECK(info->address_mode == expected->address_mode);
+    CHECK(info->fast_read_modes == expected->fast_read_modes);
+    for (uint32_t i = 0; i < SFDP_NBR_ERASE_TYPES; i++)
+    {
+        CHECK(info->erase_type[i].size == expected->erase_type[i].size);
+        CHECK(info->erase_type[i].opcode == expected->erase_type[i].opcode);
+        CHECK(info->erase_type[i].opcode_4b == expected->erase_type[i].opcode_4b);
+        CHECK(info->erase_type[i].typ_time_ms == expected->erase_type[i].typ_time_ms);
+    }
+    CHECK(info->page_program_typ_us == expected->page_program_typ_us);
+    CHECK(info->chip_erase_typ_ms == expected->chip_erase_typ_ms);
+    CHECK(info->enter_4b_methods == expected->enter_4b_methods);
+    CHECK(info->read_4b == expected->read_4b);
+    CHECK(info->program_4b == expected->program_4b);
+}
+
+int main(void)
+{
+    sfdp_info_t info;
+
+    for (uint32_t i = 0; i < (sizeof(m_tests) / sizeof(m_tests[0])); i++)
+    {
+        m_test = &m_tests[i];
+        m_name = m_test->name;
+        CHECK(sfdp_parse(dump_read, &info) == SFDP_STATUS_SUCCESS);
+        check_info(&m_test->info, &info);
+    }
+
+    printf("sfdp: %u failures\n", m_nbr_failures);
+    return (m_nbr_failures == 0) ? 0 : 1;
+}
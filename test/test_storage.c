@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "nrf_error.h"
+#include "flash_backend.h"
+#include "simple_fs.h"
+#include "large_file_storage.h"
+#include "storage_mngr.h"
+
+/** Host test of simple_fs and large_file_storage on the backend selected by STORAGE_BACKEND */
+
+#define TEST_FILE_LEN           900
+#define TEST_NBR_WRITES         200
+/** The DATA folder has a single page, the write needing its garbage collection
+ *  reports SFS_STATUS_NO_SPACE. It is written without filling the page. */
+#define TEST_NBR_DATA_WRITES    40
+#define TEST_LARGE_FILE_LEN     (FILE_ALLOC_SIZE - 1024)
+#define TEST_LARGE_PART_LEN     4096
+#define TEST_SMALL_SIZE         (0x10000)
+
+#define CHECK(cond)                                                         \
+    do                                                                      \
+    {                                                                       \
+        if (!(cond))                                                        \
+        {                                                                   \
+            printf("%s:%d: %s failed\n", __FILE__, __LINE__, #cond);        \
+            m_nbr_failures++;                                               \
+        }                                                                   \
+    } while (0)
+
+static uint32_t m_nbr_failures;
+
+static uint8_t m_data[TEST_LARGE_PART_LEN];
+static uint8_t m_read[TEST_LARGE_PART_LEN];
+
+static uint32_t nbr_writes(uint32_t folder)
+{
+    return (folder == DATA_FOLDER) ? TEST_NBR_DATA_WRITES : TEST_NBR_WRITES;
+}
+
+static void fill(uint8_t *data, uint32_t len, uint32_t seed)
+{
+    for (uint32_t i = 0; i < len; i++)
+    {
+        data[i] = (uint8_t) ((i * 31) + seed);
+    }
+}
+
+/** The files of each folder are rewritten till the pages are garbage collected */
+static void test_simple_fs(void)
+{
+    for (uint32_t folder = CONFIG_FOLDER; folder < TOTAL_NBR_FOLDER; folder++)
+    {
+        for (uint32_t i = 0; i < nbr_writes(folder); i++)
+        {
+            uint32_t file_id = FILE_ID(folder + 1, (i % 3) + 1);
+            uint32_t len = TEST_FILE_LEN - (i % 100);
+
+            fill(m_data, len, i + folder);
+            CHECK(sfs_write_file(file_id, m_data, len) == SFS_STATUS_SUCCESS);
+            memset(m_read, 0, len);
+            CHECK(sfs_read_file(file_id, m_read, len) == SFS_STATUS_SUCCESS);
+            CHECK(memcmp(m_read, m_data, len) == 0);
+        }
+    }
+}
+
+#if TEST_BACKEND_PERSISTENT
+/** The last version of each file is found after an init */
+static void test_simple_fs_reinit(void)
+{
+    for (uint32_t folder = CONFIG_FOLDER; folder < TOTAL_NBR_FOLDER; folder++)
+    {
+        for (uint32_t i = nbr_writes(folder) - 3; i < nbr_writes(folder); i++)
+        {
+            uint32_t len = TEST_FILE_LEN - (i % 100);
+
+            fill(m_data, len, i + folder);
+            memset(m_read, 0, len);
+            CHECK(sfs_read_file(FILE_ID(folder + 1, (i % 3) + 1), m_read, len) == SFS_STATUS_SUCCESS);
+            CHECK(memcmp(m_read, m_data, len) == 0);
+        }
+    }
+}
+#endif
+
+static void write_large_file(uint32_t seed)
+{
+    for (uint32_t rem_len = TEST_LARGE_FILE_LEN; rem_len > 0;)
+    {
+        uint32_t len = SFS_SMALL(rem_len, TEST_LARGE_PART_LEN);
+
+        fill(m_data, len, seed + rem_len);
+        CHECK(write_measurement_in_parts(rem_len, m_data, len) == MEAS_STORE_STATUS_SUCCESS);
+        rem_len -= len;
+    }
+}
+
+static void read_large_file(uint32_t seed)
+{
+    uint32_t address = first_written_file_address();
+
+    CHECK(address >= DATA_START_ADDRESS);
+    for (uint32_t rem_len = TEST_LARGE_FILE_LEN; rem_len > 0;)
+    {
+        uint32_t len = SFS_SMALL(rem_len, TEST_LARGE_PART_LEN);
+
+        fill(m_data, len, seed + rem_len);
+        CHECK(read_measurement_in_parts(address, rem_len, m_read, len) == MEAS_STORE_STATUS_SUCCESS);
+        CHECK(memcmp(m_read, m_data, len) == 0);
+        rem_len -= len;
+    }
+}
+
+/** More files than allocations are written, the oldest ones are overwritten */
+static void test_large_files(void)
+{
+    flash_backend_caps_t caps;
+    uint32_t nbr_files;
+
+    STORAGE_BACKEND.get_caps(&caps);
+    nbr_files = ((caps.size - DATA_START_ADDRESS) / FILE_ALLOC_SIZE) + 2;
+
+    for (uint32_t i = 0; i < nbr_files; i++)
+    {
+        write_large_file(i);
+        read_large_file(i);
+        CHECK(first_written_file_address() == 0);
+    }
+}
+
+static void small_get_caps(flash_backend_caps_t *caps)
+{
+    STORAGE_BACKEND.get_caps(caps);
+    caps->size = TEST_SMALL_SIZE;
+}
+
+/** A memory smaller than the layout is refused */
+static void test_small_backend(void)
+{
+    flash_backend_t small = STORAGE_BACKEND;
+
+    small.get_caps = small_get_caps;
+    CHECK(large_file_storage_init(&small) == MEAS_STORE_STATUS_INTERNAL_ERROR);
+}
+
+int main(void)
+{
+    CHECK(init_storage() == SFS_STATUS_SUCCESS);
+    test_simple_fs();
+    test_large_files();
+    test_small_backend();
+
+#if TEST_BACKEND_PERSISTENT
+    /** The backend keeps its content over an init, as after a reset */
+    CHECK(init_storage() == SFS_STATUS_SUCCESS);
+    test_simple_fs_reinit();
+#endif
+
+#ifdef STORAGE_CONFIG_BACKEND
+    printf("%s backend, config folder on %s backend: %u failures\n", STORAGE_BACKEND.name, STORAGE_CONFIG_BACKEND.name, m_nbr_failures);
+#else
+    printf("%s backend: %u failures\n", STORAGE_BACKEND.name, m_nbr_failures);
+#endif
+    return (m_nbr_failures == 0) ? 0 : 1;
+}